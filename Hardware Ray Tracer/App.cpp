@@ -17,17 +17,6 @@
  * ALPHA-RELASE: Eingeschrnkte Funktionen (Denoiser etc.)
  */
 
-namespace std {
-	template<>
-	struct hash<Core::Vertex> {
-		size_t operator()(Core::Vertex const& vert) const {
-			size_t seed = 0;
-			hashCombine(seed, vert.pos[0], vert.pos[1], vert.pos[2], 0);
-			return seed;
-		}
-	};
-}
-
 Core::App::App() : window({800, 600, "Ray Tracing | DLSS 3.5", false}), device(&window), swapChain(std::make_unique<SwapChain>(device, window.getExtent())) {
 
 	createLight();
@@ -228,7 +217,7 @@ void Core::App::createRayTracingPipeline() {
 	rtPipelineInfo.maxPipelineRayRecursionDepth = std::max(3U, device.getRTProperties()->maxRayRecursionDepth);
 	rtPipelineInfo.layout = graphicsPipelineLayout;
 
-	vkCreateRayTracingPipelinesKHR(device.getDevice(), {}, {}, 1, & rtPipelineInfo, nullptr, & graphicsPipeline);
+	device.dispatch().vkCreateRayTracingPipelinesKHR(device.getDevice(), {}, {}, 1, & rtPipelineInfo, nullptr, & graphicsPipeline);
 
 	std::cout << "Creating Shader Binding Table..." << std::endl;
 	createShaderBindingTable(rtPipelineInfo);
@@ -244,7 +233,7 @@ void Core::App::createShaderBindingTable(const VkRayTracingPipelineCreateInfoKHR
 
 	size_t dataSize = handleSize * groupCount;
 	shaderHandles.resize(dataSize);
-	VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device.getDevice(), graphicsPipeline, 0, groupCount, dataSize, shaderHandles.data()), "failed to get shader shader handles!");
+	VK_CHECK_RESULT(device.dispatch().vkGetRayTracingShaderGroupHandlesKHR(device.getDevice(), graphicsPipeline, 0, groupCount, dataSize, shaderHandles.data()), "failed to get shader shader handles!");
 
 	auto     alignUp = [](uint32_t size, uint32_t alignment) { return (size + alignment - 1) & ~(alignment - 1); };
 	uint32_t raygenSize = alignUp(handleSize, handleAlignment);
@@ -435,7 +424,7 @@ void Core::App::createAccelerationStructure(VkAccelerationStructureTypeKHR asTyp
 	maxPrimCount[0] = asBuildRangeInfo.primitiveCount;
 
 	VkAccelerationStructureBuildSizesInfoKHR asBuildSize{ .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR };
-	vkGetAccelerationStructureBuildSizesKHR(device.getDevice(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &asBuildInfo, maxPrimCount.data(), &asBuildSize);
+	device.dispatch().vkGetAccelerationStructureBuildSizesKHR(device.getDevice(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &asBuildInfo, maxPrimCount.data(), &asBuildSize);
 
 	VkDeviceSize scratchSize = alignUp(asBuildSize.buildScratchSize, device.getAccelProperties()->minAccelerationStructureScratchOffsetAlignment);
 
@@ -456,18 +445,18 @@ void Core::App::createAccelerationStructure(VkAccelerationStructureTypeKHR asTyp
 		.type = asType,
 	};
 
-	vkCreateAccelerationStructureKHR(device.getDevice(), &createInfo, nullptr, &accelStructure.handle);
+	device.dispatch().vkCreateAccelerationStructureKHR(device.getDevice(), &createInfo, nullptr, &accelStructure.handle);
 
 	VkCommandBuffer cmd = device.beginSingleTimeCommands();
 	asBuildInfo.dstAccelerationStructure = accelStructure.handle;
 	asBuildInfo.scratchData = { .deviceAddress = scratchBuffer.getAddress() };
 
 	VkAccelerationStructureBuildRangeInfoKHR* pBuildRangeInfo = &asBuildRangeInfo;
-	vkCmdBuildAccelerationStructuresKHR(cmd, 1, &asBuildInfo, &pBuildRangeInfo);
+	device.dispatch().vkCmdBuildAccelerationStructuresKHR(cmd, 1, &asBuildInfo, &pBuildRangeInfo);
 
 	VkAccelerationStructureDeviceAddressInfoKHR info{ .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
 													.accelerationStructure = accelStructure.handle };
-	accelStructure.address = vkGetAccelerationStructureDeviceAddressKHR(device.getDevice(), &info);
+	accelStructure.address = device.dispatch().vkGetAccelerationStructureDeviceAddressKHR(device.getDevice(), &info);
 
 	device.endSingleTimeCommands(cmd);
 
@@ -754,7 +743,7 @@ void Core::App::rayTraceScene() {
 
 		//Call the ray tracing command
 		VkExtent2D size = swapChain->getSwapChainExtent();
-		vkCmdTraceRaysKHR(buffer, &raygenRegion, &missRegion, &hitRegion, &callableRegion, size.width, size.height, 1);
+		device.dispatch().vkCmdTraceRaysKHR(buffer, &raygenRegion, &missRegion, &hitRegion, &callableRegion, size.width, size.height, 1);
 
 		//The image will later be denoised by DLSS Ray Reconstruction and then upscaled by DLSS Super Resolution
 
@@ -777,12 +766,12 @@ void Core::App::destroyStorageImage() {
 
 void Core::App::destroyAccelerationStructures() {
 	
-	vkDestroyAccelerationStructureKHR(device.getDevice(), tlasAccel.handle, nullptr);
+	device.dispatch().vkDestroyAccelerationStructureKHR(device.getDevice(), tlasAccel.handle, nullptr);
 	vkDestroyBuffer(device.getDevice(), tlasAccel.buffer, nullptr);
 	vkFreeMemory(device.getDevice(), tlasAccel.memory, nullptr);
 
 	for (uint32_t i = 0; i < blasAccel.size(); i++) {
-		vkDestroyAccelerationStructureKHR(device.getDevice(), blasAccel[i].handle, nullptr);
+		device.dispatch().vkDestroyAccelerationStructureKHR(device.getDevice(), blasAccel[i].handle, nullptr);
 		vkDestroyBuffer(device.getDevice(), blasAccel[i].buffer, nullptr);
 		vkFreeMemory(device.getDevice(), blasAccel[i].memory, nullptr);
 	}
@@ -805,7 +794,11 @@ void Core::App::loadModel(std::string path) {
 	if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &err, path.c_str()))
 		throw std::runtime_error(err);
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	size_t indexCount = 0;
+	for (const auto& shape : shapes)
+		indexCount += shape.mesh.indices.size();
+
+	Core::VertexDeduplicator<Vertex> deduplicator(vertices, indices, indexCount);
 	for (const auto& shape : shapes) {
 		for (const auto& index : shape.mesh.indices) {
 			Vertex vertex{};
@@ -826,12 +819,7 @@ void Core::App::loadModel(std::string path) {
 				vertex.uv[1] = attributes.texcoords[2 * index.texcoord_index + 1];
 			}
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
-
-			indices.push_back(uniqueVertices[vertex]);
+			deduplicator.add(vertex);
 		}
 	}
 
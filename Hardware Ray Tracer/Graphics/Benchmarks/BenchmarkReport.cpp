@@ -0,0 +1,245 @@
+#include "BenchmarkReport.h"
+#include "../RayTracing/Debugging.h"
+
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cstdio>
+
+#define TRACE_PASS_NAME "Trace Rays" //profiler scope used for the rays per second metric
+
+Benchmarks::Statistics Benchmarks::Statistics::of(std::vector<double> samples) {
+	Statistics statistics;
+	if (samples.empty()) return statistics;
+
+	std::sort(samples.begin(), samples.end());
+	statistics.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	statistics.min = samples.front();
+	statistics.max = samples.back();
+	statistics.p50 = percentile(samples, 50.0);
+	statistics.p95 = percentile(samples, 95.0);
+	statistics.p99 = percentile(samples, 99.0);
+	return statistics;
+}
+
+/*
+ * Linear interpolation between the closest ranks, the same definition numpy uses by default
+ */
+double Benchmarks::Statistics::percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty()) return 0.0;
+
+	double rank = p / 100.0 * (sorted.size() - 1);
+	size_t lower = static_cast<size_t>(rank);
+	size_t upper = std::min(lower + 1, sorted.size() - 1);
+	return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - lower);
+}
+
+void Benchmarks::RenderReport::addBuildTime(const std::string& phase, double milliseconds) {
+	buildTimes.emplace_back(phase, milliseconds);
+}
+
+void Benchmarks::RenderReport::addCpuFrame(uint64_t frame, double milliseconds) {
+	getFrame(frame).cpu = milliseconds;
+}
+
+void Benchmarks::RenderReport::addGpuFrame(const Core::GpuProfiler::FrameTiming& timing) {
+	Frame& frame = getFrame(timing.frame);
+	frame.gpu = timing.milliseconds;
+
+	for (const auto& scope : timing.scopes) {
+		size_t pass = std::find(passNames.begin(), passNames.end(), scope.name) - passNames.begin();
+		if (pass == passNames.size())
+			passNames.push_back(scope.name);
+
+		if (frame.passes.size() <= pass)
+			frame.passes.resize(pass + 1, -1.0);
+
+		//scopes with the same name are summed
+		if (frame.passes[pass] < 0.0)
+			frame.passes[pass] = 0.0;
+		frame.passes[pass] += scope.milliseconds;
+	}
+}
+
+void Benchmarks::RenderReport::addRayCount(uint64_t frame, const std::string& type, uint64_t rays) {
+	size_t index = std::find(rayTypes.begin(), rayTypes.end(), type) - rayTypes.begin();
+	if (index == rayTypes.size())
+		rayTypes.push_back(type);
+
+	Frame& f = getFrame(frame);
+	if (f.rays.size() <= index)
+		f.rays.resize(index + 1, -1.0);
+	f.rays[index] = static_cast<double>(rays);
+}
+
+Benchmarks::RenderReport::Frame& Benchmarks::RenderReport::getFrame(uint64_t frame) {
+	auto it = std::lower_bound(frames.begin(), frames.end(), frame, [](const Frame& f, uint64_t n) { return f.frame < n; });
+	if (it == frames.end() || it->frame != frame)
+		it = frames.insert(it, Frame{ .frame = frame });
+	return *it;
+}
+
+std::vector<Benchmarks::RenderReport::Metric> Benchmarks::RenderReport::summarize() const {
+	std::vector<Metric> metrics;
+
+	auto collect = [&](auto value) {
+		std::vector<double> samples;
+		for (const Frame& frame : frames) {
+			double sample = value(frame);
+			if (sample >= 0.0)
+				samples.push_back(sample);
+		}
+		return samples;
+	};
+
+	metrics.push_back(Metric{ "cpu.frame", "ms", Statistics::of(collect([](const Frame& f) { return f.cpu; })) });
+	metrics.push_back(Metric{ "gpu.frame", "ms", Statistics::of(collect([](const Frame& f) { return f.gpu; })) });
+
+	for (size_t pass = 0; pass < passNames.size(); pass++)
+		metrics.push_back(Metric{ "gpu." + passNames[pass], "ms", Statistics::of(collect([pass](const Frame& f) { return pass < f.passes.size() ? f.passes[pass] : -1.0; })) });
+
+	//rays per second from the trace pass, the whole GPU frame is the fallback when the pass was not measured
+	size_t tracePass = std::find(passNames.begin(), passNames.end(), TRACE_PASS_NAME) - passNames.begin();
+	auto megaRays = [&](const Frame& f, double rays) {
+		double milliseconds = tracePass < f.passes.size() ? f.passes[tracePass] : f.gpu;
+		return milliseconds > 0.0 && rays >= 0.0 ? rays / (milliseconds * 1e3) : -1.0;
+	};
+
+	//counted rays per type, the primary ray estimate when the shader was not instrumented
+	if (rayTypes.empty()) {
+		double rays = static_cast<double>(raysPerFrame);
+		metrics.push_back(Metric{ "rays.primary", "Mrays/s", Statistics::of(collect([&](const Frame& f) { return megaRays(f, rays); })) });
+	}
+	for (size_t type = 0; type < rayTypes.size(); type++)
+		metrics.push_back(Metric{ "rays." + rayTypes[type], "Mrays/s", Statistics::of(collect([&](const Frame& f) { return megaRays(f, type < f.rays.size() ? f.rays[type] : -1.0); })) });
+
+	for (const auto& [phase, milliseconds] : buildTimes)
+		metrics.push_back(Metric{ "build." + phase, "ms", Statistics{ milliseconds, milliseconds, milliseconds, milliseconds, milliseconds, milliseconds } });
+
+	return metrics;
+}
+
+void Benchmarks::RenderReport::print() const {
+	BENCHMARK("Render", scene << " along " << cameraPath << " at " << width << "x" << height << ", " << warmupFrames << " warm up and " << measuredFrames << " measured frames on " << device);
+
+	for (const Metric& metric : summarize()) {
+		const Statistics& s = metric.statistics;
+		if (metric.name.starts_with("build."))
+			BENCHMARK("Render", metric.name << ": " << s.mean << " " << metric.unit);
+		else
+			BENCHMARK("Render", metric.name << ": mean " << s.mean << ", p50 " << s.p50 << ", p95 " << s.p95 << ", p99 " << s.p99 << ", min " << s.min << ", max " << s.max << " " << metric.unit);
+	}
+}
+
+bool Benchmarks::RenderReport::write(const std::string& path) const {
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0)
+		return writeCSV(path);
+	return writeJSON(path);
+}
+
+static std::string escapeJSON(const std::string& string) {
+	std::string escaped;
+	for (char c : string) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+			escaped += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20) {
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", c);
+			escaped += code;
+		}
+		else escaped += c;
+	}
+	return escaped;
+}
+
+bool Benchmarks::RenderReport::writeJSON(const std::string& path) const {
+	std::ofstream out(path, std::ios::trunc);
+	if (!out) return false;
+
+	out << std::setprecision(9);
+	out << "{\n";
+	out << "\t\"scene\": \"" << escapeJSON(scene) << "\",\n";
+	out << "\t\"cameraPath\": \"" << escapeJSON(cameraPath) << "\",\n";
+	out << "\t\"device\": \"" << escapeJSON(device) << "\",\n";
+	out << "\t\"width\": " << width << ",\n";
+	out << "\t\"height\": " << height << ",\n";
+	out << "\t\"warmupFrames\": " << warmupFrames << ",\n";
+	out << "\t\"measuredFrames\": " << measuredFrames << ",\n";
+	out << "\t\"timestep\": " << timestep << ",\n";
+	out << "\t\"raysPerFrame\": " << raysPerFrame << ",\n";
+
+	out << "\t\"metrics\": {\n";
+	std::vector<Metric> metrics = summarize();
+	for (size_t i = 0; i < metrics.size(); i++) {
+		const Statistics& s = metrics[i].statistics;
+		out << "\t\t\"" << escapeJSON(metrics[i].name) << "\": { \"unit\": \"" << metrics[i].unit << "\", \"mean\": " << s.mean << ", \"min\": " << s.min << ", \"max\": " << s.max
+			<< ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << " }" << (i + 1 < metrics.size() ? "," : "") << "\n";
+	}
+	out << "\t},\n";
+
+	//frames without a measurement hold null
+	auto value = [](double v) { std::ostringstream stream; stream << std::setprecision(9) << v; return v >= 0.0 ? stream.str() : std::string("null"); };
+	auto count = [](double v) { return v >= 0.0 ? std::to_string(static_cast<uint64_t>(v)) : std::string("null"); };
+
+	out << "\t\"frames\": [\n";
+	for (size_t i = 0; i < frames.size(); i++) {
+		const Frame& frame = frames[i];
+		out << "\t\t{ \"frame\": " << frame.frame << ", \"cpu\": " << value(frame.cpu) << ", \"gpu\": " << value(frame.gpu) << ", \"passes\": {";
+		for (size_t pass = 0; pass < frame.passes.size(); pass++)
+			out << (pass > 0 ? ", " : " ") << "\"" << escapeJSON(passNames[pass]) << "\": " << value(frame.passes[pass]);
+		out << " }";
+		if (!rayTypes.empty()) {
+			out << ", \"rays\": {";
+			for (size_t type = 0; type < frame.rays.size(); type++)
+				out << (type > 0 ? ", " : " ") << "\"" << escapeJSON(rayTypes[type]) << "\": " << count(frame.rays[type]);
+			out << " }";
+		}
+		out << " }" << (i + 1 < frames.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n";
+	out << "}\n";
+
+	return static_cast<bool>(out);
+}
+
+bool Benchmarks::RenderReport::writeCSV(const std::string& path) const {
+	std::ofstream out(path, std::ios::trunc);
+	if (!out) return false;
+
+	out << std::setprecision(9);
+	out << "metric,unit,mean,min,max,p50,p95,p99\n";
+	for (const Metric& metric : summarize()) {
+		const Statistics& s = metric.statistics;
+		out << metric.name << "," << metric.unit << "," << s.mean << "," << s.min << "," << s.max << "," << s.p50 << "," << s.p95 << "," << s.p99 << "\n";
+	}
+	if (!out) return false;
+
+	//one row per frame, missing values stay empty
+	std::ofstream frameOut(path.substr(0, path.size() - 4) + ".frames.csv", std::ios::trunc);
+	if (!frameOut) return false;
+
+	frameOut << std::setprecision(9);
+	frameOut << "frame,cpu_ms,gpu_ms";
+	for (const std::string& name : passNames)
+		frameOut << "," << name << "_ms";
+	for (const std::string& type : rayTypes)
+		frameOut << "," << type << "_rays";
+	frameOut << "\n";
+
+	auto value = [](double v) { return v >= 0.0 ? std::to_string(v) : std::string(); };
+	auto count = [](double v) { return v >= 0.0 ? std::to_string(static_cast<uint64_t>(v)) : std::string(); };
+	for (const Frame& frame : frames) {
+		frameOut << frame.frame << "," << value(frame.cpu) << "," << value(frame.gpu);
+		for (size_t pass = 0; pass < passNames.size(); pass++)
+			frameOut << "," << (pass < frame.passes.size() ? value(frame.passes[pass]) : std::string());
+		for (size_t type = 0; type < rayTypes.size(); type++)
+			frameOut << "," << (type < frame.rays.size() ? count(frame.rays[type]) : std::string());
+		frameOut << "\n";
+	}
+
+	return static_cast<bool>(frameOut);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../vulkan_core/GpuProfiler.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Benchmarks {
+	struct Statistics {
+		double mean = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+
+		static Statistics of(std::vector<double> samples);
+		static double percentile(const std::vector<double>& sorted, double p);
+	};
+
+	/*
+	 * Results of a scripted render benchmark. Frames are added as they complete, the GPU times and ray counts arrive
+	 * a few frames late from the profiler and the instrumented shader. write() chooses JSON or CSV from the extension, the CSV summary gets a .frames.csv file next to it.
+	 */
+	class RenderReport {
+	public:
+		std::string scene;
+		std::string cameraPath;
+		std::string device;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t warmupFrames = 0;
+		uint32_t measuredFrames = 0;
+		float timestep = 0.f;
+		uint64_t raysPerFrame = 0; //estimated primary rays, only used when no frame has counted rays
+	public:
+		void addBuildTime(const std::string& phase, double milliseconds);
+		void addCpuFrame(uint64_t frame, double milliseconds);
+		void addGpuFrame(const Core::GpuProfiler::FrameTiming& timing);
+		void addRayCount(uint64_t frame, const std::string& type, uint64_t rays);
+
+		void print() const;
+		bool write(const std::string& path) const;
+	private:
+		struct Metric {
+			std::string name;
+			std::string unit;
+			Statistics statistics;
+		};
+
+		struct Frame {
+			uint64_t frame;
+			double cpu = -1.0;
+			double gpu = -1.0;
+			std::vector<double> passes{}; //indexed like passNames, negative if the pass did not run
+			std::vector<double> rays{}; //indexed like rayTypes, negative if the rays were not counted
+		};
+
+		Frame& getFrame(uint64_t frame);
+		std::vector<Metric> summarize() const;
+		bool writeJSON(const std::string& path) const;
+		bool writeCSV(const std::string& path) const;
+	private:
+		std::vector<std::pair<std::string, double>> buildTimes;
+		std::vector<std::string> passNames;
+		std::vector<std::string> rayTypes;
+		std::vector<Frame> frames; //sorted by frame number
+	};
+}
@@ -0,0 +1,800 @@
+#include "Benchmarks.h"
+#include "../RayTracing/MeshCache.h"
+#include "../RayTracing/ObjImporter.h"
+#include "../RayTracing/LightSampling.h"
+#include "../RayTracing/SobolSampler.h"
+#include "../RayTracing/Debugging.h"
+#include "../RayTracing/SceneGenerator.h"
+#include "../Denoiser/Denoiser.h"
+#include "../vulkan_core/Buffer.h"
+#include "../Upscaler/TemporalUpscale.h"
+#include "../Upscaler/ResolutionController.h"
+#include "../VertexDeduplicator.h"
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <random>
+#include <glm/gtc/packing.hpp>
+
+using BenchmarkClock = std::chrono::high_resolution_clock;
+
+static float elapsedMs(BenchmarkClock::time_point start) {
+	return std::chrono::duration<float, std::chrono::milliseconds::period>(BenchmarkClock::now() - start).count();
+}
+
+//the single threaded tinyobj import the renderer used before the ObjImporter
+static void importWithTinyObj(const std::string& path, std::vector<RayTracing::Vertex>& vertices, std::vector<uint32_t>& indices) {
+	tinyobj::attrib_t attributes;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string err;
+
+	if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &err, path.c_str()))
+		throw std::runtime_error(err);
+
+	size_t indexCount = 0;
+	for (const auto& shape : shapes)
+		indexCount += shape.mesh.indices.size();
+
+	Core::VertexDeduplicator<RayTracing::Vertex> deduplicator(vertices, indices, indexCount);
+	for (const auto& shape : shapes) {
+		for (const auto& index : shape.mesh.indices) {
+			RayTracing::Vertex vertex{};
+			if (index.vertex_index >= 0) {
+				vertex.pos[0] = attributes.vertices[3 * index.vertex_index + 0];
+				vertex.pos[1] = -attributes.vertices[3 * index.vertex_index + 1];
+				vertex.pos[2] = attributes.vertices[3 * index.vertex_index + 2];
+			}
+
+			if (index.normal_index >= 0) {
+				vertex.normal[0] = attributes.normals[3 * index.normal_index + 0];
+				vertex.normal[1] = -attributes.normals[3 * index.normal_index + 1];
+				vertex.normal[2] = attributes.normals[3 * index.normal_index + 2];
+			}
+
+			if (index.texcoord_index >= 0) {
+				vertex.uv[0] = attributes.texcoords[2 * index.texcoord_index + 0];
+				vertex.uv[1] = attributes.texcoords[2 * index.texcoord_index + 1];
+			}
+
+			deduplicator.add(vertex);
+		}
+	}
+}
+
+//the vertex hash the importer used before, it only covers the position
+struct PositionHash {
+	size_t operator()(const RayTracing::Vertex& vertex) const {
+		size_t seed = 0;
+		for (float f : vertex.pos)
+			seed ^= std::hash<float>{}(f) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		return seed;
+	}
+};
+
+//all eight floats, but still a node based map
+struct VertexHash {
+	size_t operator()(const RayTracing::Vertex& vertex) const {
+		size_t seed = 0;
+		for (float f : vertex.pos)
+			seed ^= std::hash<float>{}(f) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		for (float f : vertex.normal)
+			seed ^= std::hash<float>{}(f) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		for (float f : vertex.uv)
+			seed ^= std::hash<float>{}(f) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		return seed;
+	}
+};
+
+template<typename Hash>
+static void dedupWithMap(const std::vector<RayTracing::Vertex>& stream, std::vector<RayTracing::Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::unordered_map<RayTracing::Vertex, uint32_t, Hash> uniqueVertices{};
+	for (const auto& vertex : stream) {
+		if (uniqueVertices.count(vertex) == 0) {
+			uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(vertex);
+		}
+
+		indices.push_back(uniqueVertices[vertex]);
+	}
+}
+
+/*
+ * Builds the unindexed vertex stream of a flat shaded height field, every triangle has its own normal
+ * and uvs are split per quad, so up to six vertices share one position like on a hard edged CAD mesh
+ */
+static std::vector<RayTracing::Vertex> createHardEdgedStream(uint32_t indexCount) {
+	uint32_t size = static_cast<uint32_t>(std::ceil(std::sqrt(indexCount / 6.0)));
+	std::vector<RayTracing::Vertex> stream;
+	stream.reserve(static_cast<size_t>(size) * size * 6);
+
+	auto height = [](uint32_t x, uint32_t z) { return std::sin(x * 0.37f) * std::cos(z * 0.23f); };
+	for (uint32_t z = 0; z < size && stream.size() < indexCount; z++) {
+		for (uint32_t x = 0; x < size && stream.size() < indexCount; x++) {
+			glm::vec3 corners[4] = {
+				{ float(x), height(x, z), float(z) },
+				{ float(x + 1), height(x + 1, z), float(z) },
+				{ float(x + 1), height(x + 1, z + 1), float(z + 1) },
+				{ float(x), height(x, z + 1), float(z + 1) }
+			};
+			const float uvs[4][2] = { {0.f, 0.f}, {1.f, 0.f}, {1.f, 1.f}, {0.f, 1.f} };
+			const uint32_t triangles[2][3] = { {0, 1, 2}, {0, 2, 3} };
+
+			for (const auto& triangle : triangles) {
+				glm::vec3 normal = glm::normalize(glm::cross(corners[triangle[1]] - corners[triangle[0]], corners[triangle[2]] - corners[triangle[0]]));
+				for (uint32_t corner : triangle) {
+					stream.push_back(RayTracing::Vertex{
+						.pos = { corners[corner].x, corners[corner].y, corners[corner].z },
+						.normal = { normal.x, normal.y, normal.z },
+						.uv = { uvs[corner][0], uvs[corner][1] }
+					});
+				}
+			}
+		}
+	}
+
+	return stream;
+}
+
+/*
+ * Builds the bottom level acceleration structures of scenes with a growing number of sphere meshes on a headless device.
+ * Every count gets its own scene, so every line includes the allocation of its acceleration structures and scratch arena.
+ */
+void Benchmarks::blasBuild(uint32_t maxMeshes, uint64_t trianglesPerMesh) {
+	Core::Device device(nullptr);
+
+	std::vector<RayTracing::Vertex> vertices;
+	std::vector<uint32_t> indices;
+	RayTracing::SceneGenerator::sphere(trianglesPerMesh, vertices, indices);
+
+	BENCHMARK("BLAS Build", "meshes of " << indices.size() / 3 << " triangles, host time of the batched build including the wait");
+	for (uint32_t meshCount = 1; meshCount <= maxMeshes; meshCount *= 4) {
+		RayTracing::Scene scene(device);
+		scene.createMaterial(glm::vec3(0.8f));
+		scene.createLight(glm::vec3(0.f, -4.f, 0.f), glm::vec3(1.f), 1.f);
+		for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+			scene.createMesh(vertices, indices);
+			scene.createInstance(mesh, 0, glm::vec3(static_cast<float>(mesh % 64), 0.f, static_cast<float>(mesh / 64)) * 2.f);
+		}
+		scene.build();
+
+		float time = scene.getBuildTimings().bottomAS;
+		BENCHMARK("BLAS Build", meshCount << " mesh(es), " << static_cast<uint64_t>(meshCount) * indices.size() / 3 << " triangles: " << time << " ms ("
+			<< time * 1000.f / meshCount << " us per mesh)");
+	}
+}
+
+/*
+ * Compares importing an OBJ with loading its .bmesh cache. Both paths end with the mesh data in one
+ * contiguous buffer, which stands in for the staging ring the renderer copies into.
+ */
+void Benchmarks::meshCache(const std::string& path, uint32_t iterations) {
+	std::vector<RayTracing::Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint8_t> staging;
+
+	float parseTime = 0.f;
+	for (uint32_t i = 0; i < iterations; i++) {
+		vertices.clear();
+		indices.clear();
+
+		auto start = BenchmarkClock::now();
+		RayTracing::Scene::parseModel(path, vertices, indices);
+
+		staging.resize(vertices.size() * sizeof(RayTracing::Vertex) + indices.size() * sizeof(uint32_t));
+		memcpy(staging.data(), vertices.data(), vertices.size() * sizeof(RayTracing::Vertex));
+		memcpy(staging.data() + vertices.size() * sizeof(RayTracing::Vertex), indices.data(), indices.size() * sizeof(uint32_t));
+		parseTime += elapsedMs(start);
+	}
+
+	if (!RayTracing::MeshCache::write(path, vertices, indices))
+		throw std::runtime_error("failed to write mesh cache!");
+
+	float cacheTime = 0.f;
+	for (uint32_t i = 0; i < iterations; i++) {
+		auto start = BenchmarkClock::now();
+
+		RayTracing::MeshCache cache;
+		if (!cache.open(path))
+			throw std::runtime_error("failed to open mesh cache!");
+
+		auto cachedVertices = cache.getVertices();
+		auto cachedIndices = cache.getIndices();
+
+		staging.resize(cachedVertices.size_bytes() + cachedIndices.size_bytes());
+		memcpy(staging.data(), cachedVertices.data(), cachedVertices.size_bytes());
+		memcpy(staging.data() + cachedVertices.size_bytes(), cachedIndices.data(), cachedIndices.size_bytes());
+		cacheTime += elapsedMs(start);
+	}
+
+	parseTime /= iterations;
+	cacheTime /= iterations;
+
+	BENCHMARK("Mesh Cache", path << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles");
+	BENCHMARK("Mesh Cache", "OBJ import: " << parseTime << " ms, cache hit: " << cacheTime << " ms (" << parseTime / std::max(cacheTime, 0.001f) << "x)");
+}
+
+/*
+ * Compares the tinyobj import with the ObjImporter on 1 to hardware_concurrency threads and checks that
+ * every thread count produces exactly the same vertices and indices
+ */
+void Benchmarks::objImport(const std::string& path, uint32_t iterations) {
+	std::vector<RayTracing::Vertex> referenceVertices;
+	std::vector<uint32_t> referenceIndices;
+
+	float referenceTime = 0.f;
+	for (uint32_t i = 0; i < iterations; i++) {
+		referenceVertices.clear();
+		referenceIndices.clear();
+
+		auto start = BenchmarkClock::now();
+		importWithTinyObj(path, referenceVertices, referenceIndices);
+		referenceTime += elapsedMs(start);
+	}
+
+	referenceTime /= iterations;
+	BENCHMARK("OBJ Import", path << ": " << referenceVertices.size() << " vertices, " << referenceIndices.size() / 3 << " triangles");
+	BENCHMARK("OBJ Import", "tinyobj: " << referenceTime << " ms");
+
+	uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+	for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+		std::vector<RayTracing::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		RayTracing::ObjImporter importer(threads);
+
+		float time = 0.f;
+		for (uint32_t i = 0; i < iterations; i++) {
+			vertices.clear();
+			indices.clear();
+
+			auto start = BenchmarkClock::now();
+			importer.load(path, vertices, indices);
+			time += elapsedMs(start);
+		}
+
+		if (vertices.size() != referenceVertices.size() || indices != referenceIndices ||
+			memcmp(vertices.data(), referenceVertices.data(), vertices.size() * sizeof(RayTracing::Vertex)) != 0)
+			throw std::runtime_error("OBJ import differs from tinyobj!");
+
+		time /= iterations;
+		BENCHMARK("OBJ Import", "ObjImporter, " << threads << " thread(s): " << time << " ms (" << referenceTime / std::max(time, 0.001f) << "x)");
+	}
+}
+
+/*
+ * Times the vertex dedup of the importer on a synthetic hard edged mesh: the old position only hash,
+ * a full hash in std::unordered_map and the flat open addressing table
+ */
+void Benchmarks::vertexDedup(uint32_t indexCount, uint32_t iterations) {
+	std::vector<RayTracing::Vertex> stream = createHardEdgedStream(indexCount);
+
+	std::vector<RayTracing::Vertex> vertices;
+	std::vector<uint32_t> indices;
+	size_t uniqueCounts[3]{};
+	float times[3]{};
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		for (uint32_t method = 0; method < 3; method++) {
+			vertices.clear();
+			vertices.shrink_to_fit();
+			indices.clear();
+			indices.shrink_to_fit();
+
+			auto start = BenchmarkClock::now();
+			if (method == 0)
+				dedupWithMap<PositionHash>(stream, vertices, indices);
+			else if (method == 1)
+				dedupWithMap<VertexHash>(stream, vertices, indices);
+			else {
+				Core::VertexDeduplicator<RayTracing::Vertex> deduplicator(vertices, indices, stream.size());
+				for (const auto& vertex : stream)
+					deduplicator.add(vertex);
+			}
+			times[method] += elapsedMs(start);
+			uniqueCounts[method] = vertices.size();
+		}
+	}
+
+	if (uniqueCounts[0] != uniqueCounts[2] || uniqueCounts[1] != uniqueCounts[2])
+		throw std::runtime_error("vertex dedup results differ!");
+
+	for (float& time : times)
+		time /= iterations;
+
+	BENCHMARK("Vertex Dedup", stream.size() << " indices, " << uniqueCounts[2] << " unique vertices");
+	BENCHMARK("Vertex Dedup", "unordered_map, position hash: " << times[0] << " ms");
+	BENCHMARK("Vertex Dedup", "unordered_map, vertex hash: " << times[1] << " ms");
+	BENCHMARK("Vertex Dedup", "flat table: " << times[2] << " ms (" << times[0] / std::max(times[2], 0.001f) << "x)");
+}
+
+/*
+ * Times the light alias table and the light BVH on a random light field and compares the relative variance
+ * of a one light estimate of the unshadowed direct light for uniform, power and BVH sampling at the same
+ * number of samples. The exact value at every shading point is summed over all lights.
+ */
+void Benchmarks::lightSampling(uint32_t lightCount, uint32_t shadingPoints, uint32_t samples) {
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+	//a wide flat field with intensities spread over two orders of magnitude, like a city at night
+	std::vector<RayTracing::Light> lights(lightCount);
+	for (RayTracing::Light& light : lights) {
+		light = RayTracing::Light{
+			{ uniform(random) * 100.f, uniform(random) * 5.f, uniform(random) * 100.f },
+			{ uniform(random), uniform(random), uniform(random) },
+			std::exp(uniform(random) * 4.6f),
+			RayTracing::LightType::POINT
+		};
+	}
+
+	auto start = BenchmarkClock::now();
+	std::vector<RayTracing::LightAliasEntry> table = RayTracing::buildLightAliasTable(lights);
+	float aliasTime = elapsedMs(start);
+
+	std::vector<RayTracing::LightBounds> emitters;
+	emitters.reserve(lights.size());
+	for (const RayTracing::Light& light : lights)
+		emitters.push_back(RayTracing::lightBounds(light));
+
+	std::vector<RayTracing::LightBVHNode> nodes;
+	uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+	BENCHMARK("Light Sampling", lightCount << " lights");
+	double aliasError = RayTracing::aliasTableError(table);
+	BENCHMARK("Light Sampling", "alias table: " << aliasTime << " ms, pdf error " << aliasError << " (" << LIGHT_ALIAS_TOLERANCE << ")"
+		<< (aliasError <= LIGHT_ALIAS_TOLERANCE ? "" : " FAILED"));
+	for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+		start = BenchmarkClock::now();
+		nodes = RayTracing::buildLightBVH(emitters, threads);
+		BENCHMARK("Light Sampling", "BVH, " << threads << " thread(s): " << elapsedMs(start) << " ms, " << nodes.size() << " nodes");
+	}
+
+	double errors[3]{}, squaredTotal = 0.0;
+	for (uint32_t point = 0; point < shadingPoints; point++) {
+		glm::vec3 position(uniform(random) * 100.f, 0.f, uniform(random) * 100.f);
+		glm::vec3 normal = glm::normalize(glm::vec3(uniform(random) - 0.5f, 1.f, uniform(random) - 0.5f));
+
+		auto contribution = [&](uint32_t index) {
+			glm::vec3 toLight = glm::vec3(lights[index].pos[0], lights[index].pos[1], lights[index].pos[2]) - position;
+			float distance2 = glm::dot(toLight, toLight);
+			return RayTracing::lightPower(lights[index]) * std::max(glm::dot(normal, toLight), 0.f) / (distance2 * std::sqrt(distance2));
+		};
+
+		double total = 0.0;
+		for (uint32_t i = 0; i < lightCount; i++)
+			total += contribution(i);
+		squaredTotal += total * total;
+
+		for (uint32_t sample = 0; sample < samples; sample++) {
+			float pdf = 0.f;
+			double estimates[3]{};
+
+			uint32_t index = std::min(static_cast<uint32_t>(uniform(random) * lightCount), lightCount - 1);
+			estimates[0] = contribution(index) * lightCount;
+
+			index = RayTracing::sampleLightAliasTable(table, uniform(random), pdf);
+			estimates[1] = pdf > 0.f ? contribution(index) / pdf : 0.0;
+
+			int32_t emitter = RayTracing::sampleLightBVH(nodes, position, normal, uniform(random), pdf);
+			estimates[2] = emitter >= 0 ? contribution(static_cast<uint32_t>(emitter)) / pdf : 0.0;
+
+			for (int method = 0; method < 3; method++)
+				errors[method] += (estimates[method] - total) * (estimates[method] - total) / samples;
+		}
+	}
+
+	const char* names[3] = { "uniform", "power", "BVH" };
+	for (int method = 0; method < 3; method++)
+		BENCHMARK("Light Sampling", names[method] << ": relative variance " << errors[method] / squaredTotal << " (" << errors[0] / std::max(errors[method], 1e-30) << "x less than uniform)");
+}
+
+//the PCG hash of shaders/random.slang, the per pixel seeds only need to differ
+static uint32_t pcg(uint32_t& state) {
+	uint32_t previous = state * 747796405U + 2891336453U;
+	uint32_t word = ((previous >> ((previous >> 28U) + 4U)) ^ previous) * 277803737U;
+	state = previous;
+	return (word >> 22U) ^ word;
+}
+
+/*
+ * Integrates a smooth 4D integrand inside one draw and an integrand cut by edges that spans two draws, like the lens
+ * and BSDF draws of a path, with both samplers of the path tracer. Every pixel gets its own seeds like in the shader,
+ * the error is the mean over the pixels. The sequence pays for its scrambling, so the cost per draw is printed to
+ * turn the errors into equal time errors. Both samplers run as their host versions, the cost in the shader is not
+ * measured, so the equal time comparison only holds on the CPU.
+ */
+void Benchmarks::sampler(uint32_t pixels, uint32_t maxSamples) {
+	const double PI = 3.14159265358979323846;
+	std::vector<uint32_t> matrices = RayTracing::createSobolMatrices(SOBOL_DIMENSIONS);
+
+	auto smooth = [&](const float* lens, const float*) {
+		double value = 1.0;
+		for (uint32_t i = 0; i < 4; i++)
+			value *= PI / 2.0 * std::sin(PI * lens[i]);
+		return value;
+	};
+	//the two draws have their own scramble like two groups of one path
+	auto edge = [&](const float* lens, const float* bsdf) {
+		return (lens[0] * lens[0] + lens[1] * lens[1] < 0.6f ? 1.0 : 0.0) * (bsdf[0] + bsdf[1] < 1.2f ? 1.0 : 0.0);
+	};
+	//0.6 pi / 4 for the quarter disk, 1 - 0.8^2 / 2 below the diagonal
+	const double edgeIntegral = 0.6 * PI / 4.0 * (1.0 - 0.32);
+
+	BENCHMARK("Sampler", pixels << " pixels, MSE of the pixel estimates, host versions of both samplers");
+	for (uint32_t samples = 1; samples <= maxSamples; samples *= 4) {
+		double errors[2][2]{};
+		for (uint32_t pixel = 0; pixel < pixels; pixel++) {
+			uint32_t state = pixel * 9781U + 1U;
+			uint32_t seed = pixel * 0x9E3779B9U;
+			double sums[2][2]{};
+
+			for (uint32_t sample = 0; sample < samples; sample++) {
+				float lens[4], bsdf[4];
+				for (float& u : lens) u = static_cast<float>(pcg(state)) * (1.f / 4294967296.f);
+				for (float& u : bsdf) u = static_cast<float>(pcg(state)) * (1.f / 4294967296.f);
+				sums[0][0] += smooth(lens, bsdf);
+				sums[0][1] += edge(lens, bsdf);
+
+				RayTracing::sobolSample(matrices, sample, seed, lens);
+				RayTracing::sobolSample(matrices, sample, seed ^ 0x68E31DA4U, bsdf);
+				sums[1][0] += smooth(lens, bsdf);
+				sums[1][1] += edge(lens, bsdf);
+			}
+
+			for (uint32_t method = 0; method < 2; method++) {
+				errors[method][0] += std::pow(sums[method][0] / samples - 1.0, 2.0) / pixels;
+				errors[method][1] += std::pow(sums[method][1] / samples - edgeIntegral, 2.0) / pixels;
+			}
+		}
+
+		BENCHMARK("Sampler", samples << " spp: smooth pcg " << errors[0][0] << ", sobol " << errors[1][0] << " (" << errors[0][0] / std::max(errors[1][0], 1e-30)
+			<< "x), edge pcg " << errors[0][1] << ", sobol " << errors[1][1] << " (" << errors[0][1] / std::max(errors[1][1], 1e-30) << "x)");
+	}
+
+	const uint32_t draws = 1U << 22;
+	uint32_t state = 1;
+	float u[4], sink = 0.f;
+	auto start = BenchmarkClock::now();
+	for (uint32_t i = 0; i < draws; i++) {
+		for (float& value : u) value = static_cast<float>(pcg(state)) * (1.f / 4294967296.f);
+		sink += u[0] + u[3];
+	}
+	float pcgTime = elapsedMs(start);
+
+	start = BenchmarkClock::now();
+	for (uint32_t i = 0; i < draws; i++) {
+		RayTracing::sobolSample(matrices, i & 1023U, i >> 10, u);
+		sink += u[0] + u[3];
+	}
+	float sobolTime = elapsedMs(start);
+
+	BENCHMARK("Sampler", "4D draw on the CPU: pcg " << pcgTime * 1e6f / draws << " ns, sobol " << sobolTime * 1e6f / draws << " ns (checksum " << sink << "), equal time comparisons are CPU only");
+}
+
+/*
+ * A floor plane with a box on it, a checker albedo and a smooth light, seen by a still camera. Half of the 1 spp
+ * samples are at twice the radiance and the rest are black. truth is the noise free color.
+ */
+static void createDenoiserFrame(uint32_t size, std::mt19937& random, Extensions::SVGFFrame& frame, std::vector<glm::vec3>& truth) {
+	std::uniform_real_distribution<float> uniform(0.f, 1.f);
+	frame.width = size;
+	frame.height = size;
+	frame.color.resize(size * size);
+	frame.depth.resize(size * size);
+	frame.normal.resize(size * size);
+	frame.albedo.resize(size * size);
+	truth.resize(size * size);
+
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint32_t i = y * size + x;
+			bool box = x > size * 3 / 8 && x < size * 5 / 8 && y > size * 3 / 8 && y < size * 5 / 8;
+
+			frame.depth[i] = box ? 5.f : 10.f + y * 0.02f;
+			frame.normal[i] = Extensions::encodeNormal(box ? glm::vec3(0.f, 0.f, -1.f) : glm::normalize(glm::vec3(0.f, -1.f, -0.3f)));
+			frame.albedo[i] = Extensions::packAlbedo(((x / 16 + y / 16) & 1) ? glm::vec3(0.8f, 0.3f, 0.2f) : glm::vec3(0.2f, 0.6f, 0.9f));
+
+			//the error is measured against the albedo the G-buffer can store
+			glm::vec3 albedo = Extensions::unpackAlbedo(frame.albedo[i]);
+			float irradiance = 1.f + 0.5f * std::sin(x * 0.03f) * std::cos(y * 0.02f) + (box ? 1.f : 0.f);
+			truth[i] = albedo * irradiance;
+			frame.color[i] = glm::vec4(truth[i] * (uniform(random) < 0.5f ? 2.f : 0.f), 1.f);
+		}
+	}
+}
+
+//the still camera of createDenoiserFrame, shifted by pixelShift output pixels to the right since the last frame
+static glm::mat4 denoiserReprojection(const Extensions::SVGFConstants& constants, uint32_t size, float pixelShift) {
+	glm::mat4 projection(0.f);
+	projection[0][0] = 1.f / constants.viewScale.x;
+	projection[1][1] = 1.f / constants.viewScale.y;
+	projection[2][0] = pixelShift * 2.f / size;
+	projection[2][2] = 1.f;
+	projection[2][3] = 1.f;
+	projection[3][2] = -0.001f;
+	return projection;
+}
+
+void Benchmarks::denoiser(uint32_t size, uint32_t frames) {
+	Extensions::SVGFConstants constants;
+	constants.viewScale = glm::vec2(0.577f);
+	constants.reprojection = denoiserReprojection(constants, size, 0.f);
+
+	Extensions::SVGFFrame frame;
+	std::vector<glm::vec3> truth;
+	std::mt19937 random(1);
+	Extensions::SVGFReference reference;
+	std::vector<glm::vec4> output;
+
+	BENCHMARK("Denoiser", size << "x" << size << ", 1 spp with half of the samples at twice the radiance and the rest black");
+	for (uint32_t index = 0; index < frames; index++) {
+		createDenoiserFrame(size, random, frame, truth);
+
+		auto start = BenchmarkClock::now();
+		reference.denoise(frame, constants, output);
+		float time = elapsedMs(start);
+
+		double noisy = 0.0, denoised = 0.0;
+		for (uint32_t i = 0; i < size * size; i++) {
+			glm::vec3 noisyError = glm::vec3(frame.color[i]) - truth[i];
+			glm::vec3 denoisedError = glm::vec3(output[i]) - truth[i];
+			noisy += glm::dot(noisyError, noisyError) / (3.0 * size * size);
+			denoised += glm::dot(denoisedError, denoisedError) / (3.0 * size * size);
+		}
+
+		BENCHMARK("Denoiser", "frame " << index << ": noisy MSE " << noisy << ", denoised " << denoised << " (" << noisy / std::max(denoised, 1e-30)
+			<< "x), reference " << time << " ms");
+	}
+}
+
+//largest difference of the first channels of a and b, relative to |b| or SVGF_TOLERANCE_FLOOR
+static float relativeError(const std::vector<glm::vec4>& a, const std::vector<glm::vec4>& b, int channels) {
+	float error = 0.f;
+	for (size_t i = 0; i < b.size(); i++)
+		for (int channel = 0; channel < channels; channel++)
+			error = std::max(error, std::abs(a[i][channel] - b[i][channel]) / std::max(std::abs(b[i][channel]), SVGF_TOLERANCE_FLOOR));
+	return error;
+}
+
+/*
+ * Runs the Denoiser and SVGFReference on the same frames and compares the moments after the temporal pass, the
+ * illumination history after the variance pass and the first a-trous iteration and the output after modulation.
+ * The camera moves by a fraction of a pixel every frame so the reprojection filters the history. Returns false as
+ * soon as a pass is further from the reference than its SVGF_TOLERANCE_*.
+ */
+bool Benchmarks::denoiserCheck(uint32_t size, uint32_t frames) {
+	Core::Device device(nullptr);
+	Extensions::Denoiser denoiser(device, VK_NULL_HANDLE);
+	VkExtent2D extent{ size, size };
+	size_t pixels = static_cast<size_t>(size) * size;
+
+	const VkImageUsageFlags inputUsage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	std::array<Core::StorageImage, 4> inputs; //color, depth, normal, albedo
+	inputs[0].create(device, VK_FORMAT_R32G32B32A32_SFLOAT, extent, inputUsage);
+	inputs[1].create(device, VK_FORMAT_R32_SFLOAT, extent, inputUsage);
+	inputs[2].create(device, VK_FORMAT_R32_UINT, extent, inputUsage);
+	inputs[3].create(device, VK_FORMAT_R8G8B8A8_UNORM, extent, inputUsage);
+	denoiser.setImages(extent, Extensions::DenoiserInputs{ .color = inputs[0].imageView, .depth = inputs[1].imageView, .normal = inputs[2].imageView, .albedo = inputs[3].imageView });
+
+	//one buffer holds the inputs in front and the read back pass outputs behind them
+	const VkDeviceSize inputSizes[4] = { pixels * sizeof(glm::vec4), pixels * sizeof(float), pixels * sizeof(uint32_t), pixels * sizeof(uint32_t) };
+	const VkDeviceSize inputBytes = inputSizes[0] + inputSizes[1] + inputSizes[2] + inputSizes[3];
+	const VkImage outputs[3] = { denoiser.getMomentsHistory(), denoiser.getIlluminationHistory(), denoiser.getOutput() };
+	const VkDeviceSize outputSizes[3] = { pixels * sizeof(glm::vec4), pixels * 4 * sizeof(uint16_t), pixels * sizeof(glm::vec4) };
+	Core::Buffer staging(device, inputBytes + outputSizes[0] + outputSizes[1] + outputSizes[2], VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VK_CHECK_RESULT(staging.map(), "failed to map denoiser check buffer!");
+	uint8_t* mapped = static_cast<uint8_t*>(staging.getMappedMemory());
+
+	Extensions::SVGFConstants constants;
+	constants.viewScale = glm::vec2(0.577f);
+	constants.reprojection = denoiserReprojection(constants, size, 0.3f);
+
+	Extensions::SVGFFrame frame;
+	std::vector<glm::vec3> truth;
+	std::mt19937 random(1);
+	Extensions::SVGFReference reference;
+	std::vector<glm::vec4> expected, moments(pixels), illumination(pixels), output(pixels);
+
+	auto region = [&](VkDeviceSize offset) {
+		return VkBufferImageCopy{ .bufferOffset = offset, .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }, .imageExtent = { size, size, 1 } };
+	};
+
+	bool passed = true;
+	BENCHMARK("Denoiser Check", size << "x" << size << ", " << frames << " frames, GPU passes against SVGFReference");
+	for (uint32_t index = 0; index < frames && passed; index++) {
+		createDenoiserFrame(size, random, frame, truth);
+		const void* data[4] = { frame.color.data(), frame.depth.data(), frame.normal.data(), frame.albedo.data() };
+		VkDeviceSize offset = 0;
+		for (uint32_t input = 0; input < inputs.size(); input++) {
+			memcpy(mapped + offset, data[input], inputSizes[input]);
+			offset += inputSizes[input];
+		}
+
+		VkCommandBuffer buffer = device.beginSingleTimeCommands();
+
+		//the images stay in the general layout, the first frame only defines it
+		std::array<VkImageMemoryBarrier, 4> uploadBarriers;
+		for (uint32_t input = 0; input < inputs.size(); input++) {
+			uploadBarriers[input] = VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.oldLayout = index == 0 ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.image = inputs[input].image,
+				.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+			};
+		}
+		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, static_cast<uint32_t>(uploadBarriers.size()), uploadBarriers.data());
+
+		offset = 0;
+		for (uint32_t input = 0; input < inputs.size(); input++) {
+			VkBufferImageCopy copy = region(offset);
+			vkCmdCopyBufferToImage(buffer, staging.getBuffer(), inputs[input].image, VK_IMAGE_LAYOUT_GENERAL, 1, &copy);
+			offset += inputSizes[input];
+		}
+
+		VkMemoryBarrier uploaded{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER, .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT, .dstAccessMask = VK_ACCESS_SHADER_READ_BIT };
+		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &uploaded, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+		denoiser.denoise(buffer, constants);
+
+		VkMemoryBarrier denoised{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER, .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT, .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT };
+		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &denoised, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+		offset = inputBytes;
+		for (uint32_t pass = 0; pass < 3; pass++) {
+			VkBufferImageCopy copy = region(offset);
+			vkCmdCopyImageToBuffer(buffer, outputs[pass], VK_IMAGE_LAYOUT_GENERAL, staging.getBuffer(), 1, &copy);
+			offset += outputSizes[pass];
+		}
+
+		VkMemoryBarrier readback{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER, .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT, .dstAccessMask = VK_ACCESS_HOST_READ_BIT };
+		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readback, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+		device.endSingleTimeCommands(buffer);
+
+		reference.denoise(frame, constants, expected);
+
+		const uint8_t* results = mapped + inputBytes;
+		memcpy(moments.data(), results, outputSizes[0]);
+		const uint16_t* halves = reinterpret_cast<const uint16_t*>(results + outputSizes[0]);
+		for (size_t i = 0; i < pixels; i++)
+			for (int channel = 0; channel < 4; channel++)
+				illumination[i][channel] = glm::unpackHalf1x16(halves[i * 4 + channel]);
+		memcpy(output.data(), results + outputSizes[0] + outputSizes[1], outputSizes[2]);
+
+		float errors[3] = {
+			relativeError(moments, reference.getMomentsHistory(), 3),
+			relativeError(illumination, reference.getIlluminationHistory(), 4),
+			relativeError(output, expected, 3)
+		};
+		passed = errors[0] <= SVGF_TOLERANCE_TEMPORAL && errors[1] <= SVGF_TOLERANCE_ATROUS && errors[2] <= SVGF_TOLERANCE_MODULATE;
+
+		BENCHMARK("Denoiser Check", "frame " << index << ": temporal " << errors[0] << " (" << SVGF_TOLERANCE_TEMPORAL << "), a-trous " << errors[1]
+			<< " (" << SVGF_TOLERANCE_ATROUS << "), modulate " << errors[2] << " (" << SVGF_TOLERANCE_MODULATE << ")" << (passed ? "" : " FAILED"));
+	}
+
+	staging.unmap();
+	for (Core::StorageImage& image : inputs)
+		image.destroy(device);
+	return passed;
+}
+
+void Benchmarks::upscaler(uint32_t width, uint32_t height, uint32_t frames) {
+	//a checker with a smooth gradient and a bright spot, panning under the camera, measured in tonemapped radiance
+	auto scene = [](glm::vec2 position) {
+		float checker = ((static_cast<int>(std::floor(position.x / 6.3f)) + static_cast<int>(std::floor(position.y / 6.3f))) & 1) ? 0.9f : 0.1f;
+		float gradient = 0.25f * std::sin(position.x * 0.45f) * std::sin(position.y * 0.33f);
+		float spot = glm::dot(position - glm::vec2(150.f, 100.f), position - glm::vec2(150.f, 100.f)) < 64.f ? 8.f : 0.f;
+		return std::max(checker + gradient + spot, 0.f);
+	};
+	auto tonemap = [](float value) { return value / (1.f + value); };
+	const uint32_t measured = std::min(frames, 8U);
+
+	BENCHMARK("Upscaler", width << "x" << height << " output, 10% radiance noise, MSE of the last " << measured << " of " << frames << " frames against 4x4 supersampling");
+	for (float scale : { 0.5f, 0.67f, 1.f }) {
+		for (float pan : { 0.f, 0.37f, 2.3f }) {
+			glm::uvec2 renderSize = Extensions::scaledExtent(glm::uvec2(width, height), scale);
+			glm::vec2 ratio = glm::vec2(renderSize) / glm::vec2(width, height);
+
+			Extensions::UpscaleFrame frame{ .width = renderSize.x, .height = renderSize.y };
+			frame.color.resize(renderSize.x * renderSize.y);
+			frame.depth.assign(renderSize.x * renderSize.y, 1.f);
+			frame.motion.assign(renderSize.x * renderSize.y, glm::vec2(pan * ratio.x, 0.f));
+			std::vector<float> centered(renderSize.x * renderSize.y);
+
+			std::mt19937 random(1);
+			std::normal_distribution<float> noise(1.f, 0.1f);
+			Extensions::TemporalUpscaleReference reference;
+			std::vector<glm::vec4> output;
+			double upscaled = 0.0, bilinear = 0.0, native = 0.0;
+			float time = 0.f;
+			uint32_t count = 0;
+
+			for (uint32_t index = 0; index < frames; index++) {
+				Extensions::UpscaleConstants constants;
+				constants.jitter = Extensions::upscaleJitter(index, scale);
+				glm::vec2 offset(pan * index, 0.f);
+				for (uint32_t y = 0; y < renderSize.y; y++) {
+					for (uint32_t x = 0; x < renderSize.x; x++) {
+						uint32_t i = y * renderSize.x + x;
+						frame.color[i] = glm::vec4(scene((glm::vec2(x, y) + 0.5f + constants.jitter) / ratio + offset) * std::max(noise(random), 0.f));
+						centered[i] = scene((glm::vec2(x, y) + 0.5f) / ratio + offset);
+					}
+				}
+
+				auto start = BenchmarkClock::now();
+				reference.upscale(frame, constants, glm::uvec2(width, height), output);
+				time += elapsedMs(start);
+				if (index + measured < frames)
+					continue;
+
+				//the clamped border is left out, neither filter has neighbours there
+				for (uint32_t y = 4; y + 4 < height; y++) {
+					for (uint32_t x = 4; x + 4 < width; x++) {
+						float truth = 0.f;
+						for (uint32_t j = 0; j < 4; j++)
+							for (uint32_t i = 0; i < 4; i++)
+								truth += scene(glm::vec2(x + (i + 0.5f) / 4.f, y + (j + 0.5f) / 4.f) + offset) / 16.f;
+
+						glm::vec2 position = (glm::vec2(x, y) + 0.5f) * ratio - 0.5f;
+						glm::ivec2 base = glm::ivec2(glm::floor(position));
+						glm::vec2 f = position - glm::vec2(base);
+						auto at = [&](int sx, int sy) {
+							return centered[std::clamp(sy, 0, static_cast<int>(renderSize.y) - 1) * renderSize.x + std::clamp(sx, 0, static_cast<int>(renderSize.x) - 1)];
+						};
+						float filtered = glm::mix(glm::mix(at(base.x, base.y), at(base.x + 1, base.y), f.x), glm::mix(at(base.x, base.y + 1), at(base.x + 1, base.y + 1), f.x), f.y);
+
+						upscaled += std::pow(tonemap(output[y * width + x].r) - tonemap(truth), 2.0);
+						bilinear += std::pow(tonemap(filtered) - tonemap(truth), 2.0);
+						native += std::pow(tonemap(scene(glm::vec2(x, y) + 0.5f + offset)) - tonemap(truth), 2.0);
+						count++;
+					}
+				}
+			}
+
+			BENCHMARK("Upscaler", "scale " << scale << ", pan " << pan << " px: upscaled " << upscaled / count << ", bilinear " << bilinear / count << " ("
+				<< bilinear / std::max(upscaled, 1e-30) << "x), native without noise or AA " << native / count << ", reference " << time / frames << " ms");
+		}
+	}
+}
+
+void Benchmarks::dynamicResolution(uint32_t frames, float targetMs) {
+	//a full resolution trace swinging between 8 and 24 ms as the camera moves, a cut to an expensive view in the middle,
+	//0.5 ms of it independent of the pixel count and 2.3 ms of other passes, read back two frames late like the profiler
+	const uint32_t latency = 2;
+	auto traceCost = [&](uint32_t frame, float scale, std::normal_distribution<float>& noise, std::mt19937& random) {
+		float full = 8.f + 8.f * (1.f - std::cos(frame * 2.f * 3.14159265f / 300.f)) + (frame >= frames / 2 && frame < frames / 2 + 100 ? 6.f : 0.f);
+		return (0.5f + (full - 0.5f) * scale * scale) * noise(random);
+	};
+
+	BENCHMARK("Dynamic Resolution", frames << " frames, target " << targetMs << " ms, full resolution trace 8 - 30 ms");
+	for (int method = 0; method < 3; method++) {
+		std::mt19937 random(1);
+		std::normal_distribution<float> noise(1.f, 0.04f);
+		Extensions::ResolutionController controller(targetMs, UPSCALE_MIN_SCALE, UPSCALE_MAX_SCALE);
+		std::vector<double> frameTimes(frames), traceTimes(frames);
+		double scaleSum = 0.0, worst = 0.0;
+		uint32_t over = 0;
+
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			if (method == 2 && frame >= latency + 1)
+				controller.update(frame, frame - latency - 1, frameTimes[frame - latency - 1], traceTimes[frame - latency - 1]);
+
+			float scale = method == 0 ? UPSCALE_MAX_SCALE : method == 1 ? UPSCALE_MIN_SCALE : controller.getScale();
+			traceTimes[frame] = traceCost(frame, scale, noise, random);
+			frameTimes[frame] = traceTimes[frame] + 2.3;
+
+			scaleSum += scale;
+			worst = std::max(worst, frameTimes[frame]);
+			over += frameTimes[frame] > targetMs ? 1 : 0;
+		}
+
+		const char* names[] = { "fixed full scale", "fixed minimum scale", "controller" };
+		BENCHMARK("Dynamic Resolution", names[method] << ": " << 100.f * over / frames << "% of frames over the target, worst " << worst << " ms, mean scale " << scaleSum / frames
+			<< (method == 2 ? ", " + std::to_string(controller.getChangeCount()) + " scale changes" : ""));
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/*
+ * Stand-alone benchmarks, started from the command line instead of the renderer. All but blasBuild run on the CPU only.
+ * denoiserCheck compares the GPU denoiser with its CPU reference and returns false when they diverge.
+ */
+namespace Benchmarks {
+	void blasBuild(uint32_t maxMeshes = 4096, uint64_t trianglesPerMesh = 1024);
+	void meshCache(const std::string& path, uint32_t iterations = 5);
+	void objImport(const std::string& path, uint32_t iterations = 3);
+	void vertexDedup(uint32_t indexCount = 5000000, uint32_t iterations = 5);
+	void lightSampling(uint32_t lightCount = 100000, uint32_t shadingPoints = 64, uint32_t samples = 256);
+	void sampler(uint32_t pixels = 4096, uint32_t maxSamples = 1024);
+	void denoiser(uint32_t size = 256, uint32_t frames = 16);
+	bool denoiserCheck(uint32_t size = 64, uint32_t frames = 8);
+	void upscaler(uint32_t width = 256, uint32_t height = 192, uint32_t frames = 48);
+	void dynamicResolution(uint32_t frames = 1200, float targetMs = 16.6f);
+}
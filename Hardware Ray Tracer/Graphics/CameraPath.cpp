@@ -0,0 +1,64 @@
+#include "CameraPath.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+Core::CameraPath::CameraPath(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open camera path " + path);
+
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+
+		std::istringstream stream(line);
+		std::string first;
+		if (!(stream >> first) || first[0] == '#')
+			continue;
+
+		Keyframe keyframe;
+		stream.str(line);
+		stream.clear();
+		if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z))
+			throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected \"time px py pz rx ry rz\"");
+
+		addKeyframe(keyframe.time, keyframe.position, keyframe.rotation);
+	}
+
+	if (keyframes.empty())
+		throw std::runtime_error("camera path " + path + " has no keyframes");
+}
+
+void Core::CameraPath::addKeyframe(float time, glm::vec3 position, glm::vec3 rotation) {
+	Keyframe keyframe{ time, position, rotation };
+	auto it = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& k) { return t < k.time; });
+	keyframes.insert(it, keyframe);
+}
+
+void Core::CameraPath::sample(float time, glm::vec3& position, glm::vec3& rotation) const {
+	if (keyframes.empty()) return;
+
+	float duration = getDuration();
+	if (duration > 0.f)
+		time = std::fmod(std::max(time, 0.f), duration);
+
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& k) { return t < k.time; });
+	if (next == keyframes.begin() || next == keyframes.end()) {
+		const Keyframe& keyframe = next == keyframes.end() ? keyframes.back() : keyframes.front();
+		position = keyframe.position;
+		rotation = keyframe.rotation;
+		return;
+	}
+
+	const Keyframe& a = *(next - 1);
+	const Keyframe& b = *next;
+	float t = (time - a.time) / (b.time - a.time);
+
+	position = glm::mix(a.position, b.position, t);
+	rotation = glm::mix(a.rotation, b.rotation, t);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Core {
+	/*
+	 * Recorded camera path for benchmarks. Every line of the file is a keyframe "time px py pz rx ry rz"
+	 * with the time in seconds and the rotation in radians like Camera::setView, lines starting with # are comments.
+	 * Keyframes are interpolated linearly and the path loops once its last keyframe is reached.
+	 */
+	class CameraPath {
+	public:
+		struct Keyframe {
+			float time;
+			glm::vec3 position;
+			glm::vec3 rotation;
+		};
+
+		CameraPath() = default;
+		CameraPath(const std::string& path);
+
+		void addKeyframe(float time, glm::vec3 position, glm::vec3 rotation);
+		void sample(float time, glm::vec3& position, glm::vec3& rotation) const;
+
+		inline float getDuration() const { return keyframes.empty() ? 0.f : keyframes.back().time; }
+		inline bool isEmpty() const { return keyframes.empty(); }
+	private:
+		std::vector<Keyframe> keyframes;
+	};
+}
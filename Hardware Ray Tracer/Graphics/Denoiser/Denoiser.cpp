@@ -0,0 +1,201 @@
+#include "Denoiser.h"
+#include "../vulkan_core/Shader.h"
+#include <algorithm>
+
+#define SVGF_BINDINGS 12U //storage images of shaders/svgf.slang
+#define SVGF_SETS (3U + SVGF_ATROUS_ITERATIONS) //temporal, variance, the a-trous iterations and modulate
+
+Extensions::Denoiser::Denoiser(Core::Device& device, VkPipelineCache cache) : device(device) {
+	createDescriptorSets();
+	createPipelines(cache);
+}
+Extensions::Denoiser::~Denoiser() {
+	destroyImages();
+	for (VkPipeline pipeline : pipelines)
+		vkDestroyPipeline(device.getDevice(), pipeline, nullptr);
+	vkDestroyPipelineLayout(device.getDevice(), pipelineLayout, nullptr);
+}
+
+/*
+ * Recreates the history for the new extent and points the passes at the inputs. The history starts over,
+ * only call this while the descriptor sets are not used by a pending command buffer.
+ */
+void Extensions::Denoiser::setImages(VkExtent2D extent, const DenoiserInputs& inputs) {
+	destroyImages();
+	this->extent = extent;
+	viewport = extent;
+
+	//transfer sources so the pass outputs can be read back and compared with SVGFReference
+	const VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	for (Core::StorageImage& image : illumination)
+		image.create(device, VK_FORMAT_R16G16B16A16_SFLOAT, extent, usage);
+	moments.create(device, VK_FORMAT_R32G32B32A32_SFLOAT, extent, usage);
+	momentsHistory.create(device, VK_FORMAT_R32G32B32A32_SFLOAT, extent, usage);
+	depthHistory.create(device, VK_FORMAT_R32_SFLOAT, extent, usage);
+	normalHistory.create(device, VK_FORMAT_R32_UINT, extent, usage);
+	output.create(device, VK_FORMAT_R32G32B32A32_SFLOAT, extent, usage);
+	imagesDefined = false;
+	historyValid = false;
+
+	bool allocate = descriptorSets.empty();
+	descriptorSets.resize(SVGF_SETS);
+
+	//every pass sees the same images, only the illumination it reads and writes differs
+	auto writeSet = [&](uint32_t set, uint32_t source, uint32_t target) {
+		VkImageView views[SVGF_BINDINGS] = {
+			inputs.color, inputs.depth, inputs.normal, inputs.albedo,
+			depthHistory.imageView, normalHistory.imageView,
+			illumination[source].imageView, illumination[target].imageView,
+			moments.imageView, momentsHistory.imageView,
+			illumination[eHistoryIllumination].imageView, output.imageView
+		};
+		std::array<VkDescriptorImageInfo, SVGF_BINDINGS> infos;
+		Core::DescriptorWriter writer(*setLayout, *pool);
+		for (uint32_t binding = 0; binding < SVGF_BINDINGS; binding++) {
+			infos[binding] = VkDescriptorImageInfo{ .imageView = views[binding], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+			writer.writeImage(binding, &infos[binding]);
+		}
+
+		if (allocate) {
+			if (!writer.build(descriptorSets[set]))
+				throw std::runtime_error("failed to allocate denoiser descriptor set!");
+		}
+		else writer.overwrite(descriptorSets[set]);
+	};
+
+	writeSet(0, ePongIllumination, ePingIllumination);
+	writeSet(1, ePingIllumination, ePongIllumination);
+
+	//the first iteration becomes the history of the next frame like in the paper
+	uint32_t source = ePongIllumination;
+	for (uint32_t iteration = 0; iteration < SVGF_ATROUS_ITERATIONS; iteration++) {
+		uint32_t target = iteration == 0 ? eHistoryIllumination : (source == ePingIllumination ? ePongIllumination : ePingIllumination);
+		writeSet(2 + iteration, source, target);
+		source = target;
+	}
+	writeSet(SVGF_SETS - 1, source, source);
+}
+
+/*
+ * Shrinks the denoised area inside the images without recreating them. The history was laid out for the old size
+ * and starts over.
+ */
+void Extensions::Denoiser::setViewport(VkExtent2D viewport) {
+	if (viewport.width == this->viewport.width && viewport.height == this->viewport.height)
+		return;
+
+	this->viewport = VkExtent2D{ std::min(viewport.width, extent.width), std::min(viewport.height, extent.height) };
+	historyValid = false;
+}
+
+/*
+ * Records all passes. The inputs have to be written by the ray tracing pass before, the output is
+ * visible to compute shaders afterwards.
+ */
+void Extensions::Denoiser::denoise(VkCommandBuffer buffer, SVGFConstants constants) {
+	std::vector<VkImageMemoryBarrier> layoutBarriers;
+	if (!imagesDefined) {
+		for (Core::StorageImage* image : { &illumination[0], &illumination[1], &illumination[2], &moments, &momentsHistory, &depthHistory, &normalHistory, &output }) {
+			layoutBarriers.push_back(VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.image = image->image,
+				.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+			});
+		}
+		imagesDefined = true;
+	}
+
+	VkMemoryBarrier inputBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &inputBarrier, 0, VK_NULL_HANDLE, static_cast<uint32_t>(layoutBarriers.size()), layoutBarriers.data());
+
+	constants.width = viewport.width;
+	constants.height = viewport.height;
+	if (!historyValid)
+		constants.flags |= eSVGFReset;
+
+	dispatch(buffer, eTemporalPass, 0, constants);
+	dispatch(buffer, eVariancePass, 1, constants);
+	for (uint32_t iteration = 0; iteration < SVGF_ATROUS_ITERATIONS; iteration++) {
+		constants.step = 1U << iteration;
+		dispatch(buffer, eAtrousPass, 2 + iteration, constants);
+	}
+	dispatch(buffer, eModulatePass, SVGF_SETS - 1, constants);
+
+	historyValid = true;
+}
+
+void Extensions::Denoiser::dispatch(VkCommandBuffer buffer, Pass pass, uint32_t set, const SVGFConstants& constants) {
+	vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[pass]);
+	vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[set], 0, VK_NULL_HANDLE);
+	vkCmdPushConstants(buffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SVGFConstants), &constants);
+	vkCmdDispatch(buffer, (viewport.width + SVGF_GROUP_SIZE - 1) / SVGF_GROUP_SIZE, (viewport.height + SVGF_GROUP_SIZE - 1) / SVGF_GROUP_SIZE, 1);
+
+	VkMemoryBarrier barrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+}
+
+void Extensions::Denoiser::createDescriptorSets() {
+	pool = Core::DescriptorPool::Builder(device)
+		.setMaxSets(SVGF_SETS)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, SVGF_BINDINGS * SVGF_SETS)
+		.build();
+
+	Core::DescriptorSetLayout::Builder builder(device);
+	for (uint32_t binding = 0; binding < SVGF_BINDINGS; binding++)
+		builder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+	setLayout = builder.build();
+}
+
+void Extensions::Denoiser::createPipelines(VkPipelineCache cache) {
+	VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+	VkPushConstantRange pushConstants{ .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(SVGFConstants) };
+
+	VkPipelineLayoutCreateInfo layoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstants
+	};
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device.getDevice(), &layoutInfo, nullptr, &pipelineLayout), "failed to create denoiser pipeline layout!");
+
+	const char* entryPoints[ePassCount] = { "temporalMain", "varianceMain", "atrousMain", "modulateMain" };
+	std::vector<char> code = Core::Shader::readFile(SVGF_SHADER_PATH);
+	Core::ShaderInterface shaderInterface(code, SVGF_SHADER_PATH);
+	for (const char* entryPoint : entryPoints)
+		shaderInterface.requireEntryPoint(entryPoint);
+	VkShaderModule module = Core::Shader::createModule(device, code);
+	std::array<VkComputePipelineCreateInfo, ePassCount> pipelineInfos;
+	for (uint32_t pass = 0; pass < ePassCount; pass++) {
+		pipelineInfos[pass] = VkComputePipelineCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage = {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = module,
+				.pName = entryPoints[pass]
+			},
+			.layout = pipelineLayout
+		};
+	}
+	VkResult result = vkCreateComputePipelines(device.getDevice(), cache, ePassCount, pipelineInfos.data(), nullptr, pipelines.data());
+	vkDestroyShaderModule(device.getDevice(), module, nullptr);
+	VK_CHECK_RESULT(result, "failed to create denoiser pipelines!");
+}
+
+void Extensions::Denoiser::destroyImages() {
+	for (Core::StorageImage* image : { &illumination[0], &illumination[1], &illumination[2], &moments, &momentsHistory, &depthHistory, &normalHistory, &output })
+		image->destroy(device);
+}
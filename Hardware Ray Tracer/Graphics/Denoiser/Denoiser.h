@@ -1,22 +1,77 @@
 #pragma once
 
+#include "../vulkan_core/Device.h"
+#include "../vulkan_core/Descriptors.h"
+#include "../vulkan_core/StorageImage.h"
+#include "SVGF.h"
+#include <array>
+#include <vector>
+
 namespace Extensions {
+	/*
+	 * Views of the ray tracing outputs the denoiser reads, all in the general layout and sized like the render output
+	 */
+	struct DenoiserInputs {
+		VkImageView color; //RGBA32F radiance of this frame
+		VkImageView depth; //R32F
+		VkImageView normal; //R32UI
+		VkImageView albedo; //RGBA8, packAlbedo
+	};
 
 	/*
-	 * Denoiser includes
+	 * Spatiotemporal variance-guided filtering (Schied et al. 2017) as compute passes:
 	 * Temporal Accumulation (with reprojection)
 	 * History Clamping (to prevent ghosting)
 	 * Variance Estimation
 	 * Atrous Wavelet Denoiser
-	 * Bilateral Pass
+	 * Bilateral Pass (the depth, normal and luminance edge stops of every a-trous iteration)
+	 * The history images are sized to the render output and dropped with it. SVGFReference runs the same passes on the CPU.
 	 */
-
 	class Denoiser {
 	public:
-		Denoiser();
+		Denoiser(Core::Device& device, VkPipelineCache cache);
 		~Denoiser();
 
-		void denoise();
-	};
+		Denoiser(const Denoiser&) = delete;
+		Denoiser operator=(const Denoiser&) = delete;
 
-}
\ No newline at end of file
+		void setImages(VkExtent2D extent, const DenoiserInputs& inputs);
+		void setViewport(VkExtent2D viewport);
+		void denoise(VkCommandBuffer buffer, SVGFConstants constants);
+		inline void resetHistory() { historyValid = false; }
+
+		inline VkImage getOutput() { return output.image; }
+		inline VkImageView getOutputView() { return output.imageView; }
+		//pass outputs Benchmarks::denoiserCheck reads back, all can be copied from in the general layout
+		inline VkImage getMomentsHistory() { return momentsHistory.image; }
+		inline VkImage getIlluminationHistory() { return illumination[eHistoryIllumination].image; }
+	private:
+		enum Pass { eTemporalPass, eVariancePass, eAtrousPass, eModulatePass, ePassCount };
+		enum Illumination { ePingIllumination, ePongIllumination, eHistoryIllumination };
+
+		void createDescriptorSets();
+		void createPipelines(VkPipelineCache cache);
+		void destroyImages();
+		void dispatch(VkCommandBuffer buffer, Pass pass, uint32_t set, const SVGFConstants& constants);
+	private:
+		Core::Device& device;
+		VkExtent2D extent{};
+		VkExtent2D viewport{}; //denoised top left part of the images, the traced size
+
+		std::array<Core::StorageImage, 3> illumination; //RGBA16F, demodulated color and variance
+		Core::StorageImage moments; //RGBA32F, luminance moments and history length
+		Core::StorageImage momentsHistory;
+		Core::StorageImage depthHistory;
+		Core::StorageImage normalHistory;
+		Core::StorageImage output; //RGBA32F, read by the resolve pass
+		bool imagesDefined = false;
+		bool historyValid = false;
+
+		std::unique_ptr<Core::DescriptorPool> pool;
+		std::unique_ptr<Core::DescriptorSetLayout> setLayout;
+		std::vector<VkDescriptorSet> descriptorSets; //temporal, variance, one per a-trous iteration, modulate
+
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::array<VkPipeline, ePassCount> pipelines{};
+	};
+}
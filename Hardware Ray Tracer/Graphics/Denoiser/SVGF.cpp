@@ -0,0 +1,356 @@
+#include "SVGF.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+//constants of shaders/svgf.slang that are not tuning parameters
+#define SVGF_VARIANCE_FRAMES 4.f
+#define SVGF_HISTORY_MAX 64.f
+#define SVGF_DEPTH_TOLERANCE 0.1f
+#define SVGF_NORMAL_TOLERANCE 0.9f
+#define SVGF_NORMAL_SQUARINGS 7
+#define SVGF_ALBEDO_MIN 0.001f
+#define SVGF_EPSILON 1e-6f
+
+namespace {
+	const float KERNEL[3] = { 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+	const float GAUSSIAN[2] = { 1.f / 2.f, 1.f / 4.f };
+
+	//round to nearest even like a store into an RGBA16F image
+	float roundHalf(float value) {
+		uint32_t bits = std::bit_cast<uint32_t>(value);
+		uint32_t exponent = (bits >> 23) & 0xFFU;
+		if (exponent == 0xFFU)
+			return value;
+		if (exponent < 113U) //below the smallest normal half the spacing is a constant 2^-24
+			return std::nearbyint(value * 16777216.f) / 16777216.f;
+
+		bits += 0x0FFFU + ((bits >> 13) & 1U);
+		bits &= ~0x1FFFU;
+		if (((bits >> 23) & 0xFFU) > 142U)
+			return std::copysign(INFINITY, value);
+		return std::bit_cast<float>(bits);
+	}
+
+	glm::vec4 roundHalf(glm::vec4 value) {
+		return glm::vec4(roundHalf(value.x), roundHalf(value.y), roundHalf(value.z), roundHalf(value.w));
+	}
+
+	float luminance(glm::vec3 color) {
+		return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+	}
+
+	template<typename T>
+	T lerp(T x, T y, float a) {
+		return x * (1.f - a) + y * a;
+	}
+
+	float normalWeight(glm::vec3 n, glm::vec3 m) {
+		float weight = std::max(glm::dot(n, m), 0.f);
+		for (int i = 0; i < SVGF_NORMAL_SQUARINGS; i++)
+			weight *= weight;
+		return weight;
+	}
+
+	bool inside(const Extensions::SVGFFrame& frame, glm::ivec2 p) {
+		return p.x >= 0 && p.y >= 0 && p.x < static_cast<int>(frame.width) && p.y < static_cast<int>(frame.height);
+	}
+
+	size_t pixel(const Extensions::SVGFFrame& frame, glm::ivec2 p) {
+		return static_cast<size_t>(p.y) * frame.width + p.x;
+	}
+
+	glm::ivec2 clampPixel(const Extensions::SVGFFrame& frame, glm::ivec2 p) {
+		return glm::clamp(p, glm::ivec2(0), glm::ivec2(frame.width, frame.height) - 1);
+	}
+
+	glm::vec3 demodulate(const Extensions::SVGFFrame& frame, glm::ivec2 p, float depth) {
+		glm::vec3 color = glm::vec3(frame.color[pixel(frame, p)]);
+		return depth > 0.f ? color / glm::max(Extensions::unpackAlbedo(frame.albedo[pixel(frame, p)]), SVGF_ALBEDO_MIN) : color;
+	}
+
+	float depthGradient(const Extensions::SVGFFrame& frame, glm::ivec2 p, float depth) {
+		glm::ivec2 last = glm::ivec2(frame.width, frame.height) - 1;
+		float right = frame.depth[pixel(frame, glm::min(p + glm::ivec2(1, 0), last))];
+		float down = frame.depth[pixel(frame, glm::min(p + glm::ivec2(0, 1), last))];
+		return std::max(right > 0.f ? std::abs(right - depth) : 0.f, down > 0.f ? std::abs(down - depth) : 0.f);
+	}
+}
+
+uint32_t Extensions::encodeNormal(glm::vec3 n) {
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.f)
+		e = (1.f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+
+	glm::ivec2 q = glm::ivec2(glm::round(glm::clamp(e, -1.f, 1.f) * 32767.f));
+	return (static_cast<uint32_t>(q.x) & 0xFFFFU) | (static_cast<uint32_t>(q.y) << 16);
+}
+
+glm::vec3 Extensions::decodeNormal(uint32_t packed) {
+	glm::vec2 e = glm::max(glm::vec2(static_cast<int16_t>(packed & 0xFFFFU), static_cast<int16_t>(packed >> 16)) / 32767.f, -1.f);
+	glm::vec3 n(e, 1.f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.f) {
+		glm::vec2 folded = (1.f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+		n.x = folded.x;
+		n.y = folded.y;
+	}
+	return glm::normalize(n);
+}
+
+uint32_t Extensions::packAlbedo(glm::vec3 albedo) {
+	return glm::packUnorm4x8(glm::vec4(albedo, 1.f));
+}
+
+glm::vec3 Extensions::unpackAlbedo(uint32_t packed) {
+	return glm::vec3(glm::unpackUnorm4x8(packed));
+}
+
+void Extensions::SVGFReference::reset() {
+	historyValid = false;
+}
+
+void Extensions::SVGFReference::resize(uint32_t width, uint32_t height) {
+	if (this->width == width && this->height == height)
+		return;
+
+	this->width = width;
+	this->height = height;
+	size_t pixels = static_cast<size_t>(width) * height;
+	for (std::vector<glm::vec4>& image : illumination)
+		image.assign(pixels, glm::vec4(0.f));
+	moments.assign(pixels, glm::vec4(0.f));
+	momentsHistory.assign(pixels, glm::vec4(0.f));
+	depthHistory.assign(pixels, 0.f);
+	normalHistory.assign(pixels, 0U);
+	historyValid = false;
+}
+
+/*
+ * All passes of one frame, in the order Denoiser::denoise records them
+ */
+void Extensions::SVGFReference::denoise(const SVGFFrame& frame, SVGFConstants constants, std::vector<glm::vec4>& output) {
+	resize(frame.width, frame.height);
+	constants.width = frame.width;
+	constants.height = frame.height;
+	if (!historyValid)
+		constants.flags |= eSVGFReset;
+
+	temporal(frame, constants);
+	variance(frame, constants);
+	for (uint32_t iteration = 0; iteration < SVGF_ATROUS_ITERATIONS; iteration++) {
+		constants.step = 1U << iteration;
+		atrous(frame, constants, iteration);
+	}
+	modulate(frame, output);
+	historyValid = true;
+}
+
+bool Extensions::SVGFReference::reproject(const SVGFFrame& frame, const SVGFConstants& constants, glm::ivec2 p, float depth, glm::vec3 normal, glm::vec4& history, glm::vec3& historyMoments) const {
+	history = glm::vec4(0.f);
+	historyMoments = glm::vec3(0.f);
+
+	glm::vec2 size(frame.width, frame.height);
+	glm::vec2 ndc = (glm::vec2(p) + 0.5f) / size * 2.f - 1.f;
+	glm::vec3 view = glm::vec3(ndc * constants.viewScale, 1.f) * depth;
+	glm::vec4 clip = constants.reprojection * glm::vec4(view, 1.f);
+	if (clip.w <= 0.f)
+		return false;
+
+	glm::vec2 position = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * size - 0.5f;
+	glm::ivec2 base = glm::ivec2(glm::floor(position));
+	glm::vec2 f = position - glm::vec2(base);
+	float weights[4] = { (1.f - f.x) * (1.f - f.y), f.x * (1.f - f.y), (1.f - f.x) * f.y, f.x * f.y };
+
+	float sum = 0.f;
+	for (int i = 0; i < 4; i++) {
+		glm::ivec2 q = base + glm::ivec2(i & 1, i >> 1);
+		if (!inside(frame, q))
+			continue;
+		float previousDepth = depthHistory[pixel(frame, q)];
+		if (previousDepth <= 0.f || std::abs(previousDepth - clip.w) > SVGF_DEPTH_TOLERANCE * clip.w)
+			continue;
+		if (glm::dot(decodeNormal(normalHistory[pixel(frame, q)]), normal) < SVGF_NORMAL_TOLERANCE)
+			continue;
+
+		history += illumination[eHistoryIllumination][pixel(frame, q)] * weights[i];
+		historyMoments += glm::vec3(momentsHistory[pixel(frame, q)]) * weights[i];
+		sum += weights[i];
+	}
+
+	if (sum < 0.01f)
+		return false;
+	history /= sum;
+	historyMoments /= sum;
+	return true;
+}
+
+void Extensions::SVGFReference::temporal(const SVGFFrame& frame, const SVGFConstants& constants) {
+	resize(frame.width, frame.height);
+
+	for (int y = 0; y < static_cast<int>(frame.height); y++) {
+		for (int x = 0; x < static_cast<int>(frame.width); x++) {
+			glm::ivec2 p(x, y);
+			float depth = frame.depth[pixel(frame, p)];
+			glm::vec3 current = demodulate(frame, p, depth);
+			float l = luminance(current);
+
+			glm::vec4 history;
+			glm::vec3 historyMoments;
+			float historyLength = 0.f;
+			if ((constants.flags & eSVGFReset) == 0 && depth > 0.f && reproject(frame, constants, p, depth, decodeNormal(frame.normal[pixel(frame, p)]), history, historyMoments))
+				historyLength = historyMoments.z;
+
+			if (historyLength > 0.f && constants.clampGamma > 0.f) {
+				glm::vec3 mean(0.f), meanSquared(0.f);
+				for (int j = -1; j <= 1; j++) {
+					for (int i = -1; i <= 1; i++) {
+						glm::ivec2 q = clampPixel(frame, p + glm::ivec2(i, j));
+						glm::vec3 c = demodulate(frame, q, frame.depth[pixel(frame, q)]);
+						mean += c;
+						meanSquared += c * c;
+					}
+				}
+				mean /= 9.f;
+				meanSquared /= 9.f;
+				glm::vec3 deviation = glm::sqrt(glm::max(meanSquared - mean * mean, 0.f)) * constants.clampGamma;
+				glm::vec3 clamped = glm::clamp(glm::vec3(history), mean - deviation, mean + deviation);
+				history = glm::vec4(clamped, history.w);
+			}
+
+			historyLength = std::min(historyLength + 1.f, SVGF_HISTORY_MAX);
+			float alpha = std::max(constants.alpha, 1.f / historyLength);
+			float momentsAlpha = std::max(constants.momentsAlpha, 1.f / historyLength);
+
+			glm::vec3 integrated = lerp(glm::vec3(history), current, alpha);
+			glm::vec2 integratedMoments = lerp(glm::vec2(historyMoments), glm::vec2(l, l * l), momentsAlpha);
+			float variance = std::max(integratedMoments.y - integratedMoments.x * integratedMoments.x, 0.f);
+
+			illumination[ePingIllumination][pixel(frame, p)] = roundHalf(glm::vec4(integrated, variance));
+			moments[pixel(frame, p)] = glm::vec4(integratedMoments, historyLength, 0.f);
+		}
+	}
+	source = ePingIllumination;
+}
+
+void Extensions::SVGFReference::variance(const SVGFFrame& frame, const SVGFConstants& constants) {
+	const std::vector<glm::vec4>& input = illumination[ePingIllumination];
+	std::vector<glm::vec4>& output = illumination[ePongIllumination];
+
+	for (int y = 0; y < static_cast<int>(frame.height); y++) {
+		for (int x = 0; x < static_cast<int>(frame.width); x++) {
+			glm::ivec2 p(x, y);
+			glm::vec4 center = input[pixel(frame, p)];
+			glm::vec4 pixelMoments = moments[pixel(frame, p)];
+			float depth = frame.depth[pixel(frame, p)];
+			momentsHistory[pixel(frame, p)] = pixelMoments;
+
+			if (pixelMoments.z >= SVGF_VARIANCE_FRAMES || depth <= 0.f) {
+				output[pixel(frame, p)] = center;
+				continue;
+			}
+
+			glm::vec3 normal = decodeNormal(frame.normal[pixel(frame, p)]);
+			float phiDepth = constants.phiDepth * depthGradient(frame, p, depth);
+
+			glm::vec3 sumIllumination(0.f);
+			glm::vec2 sumMoments(0.f);
+			float sumWeight = 0.f;
+			for (int j = -3; j <= 3; j++) {
+				for (int i = -3; i <= 3; i++) {
+					glm::ivec2 q = p + glm::ivec2(i, j);
+					if (!inside(frame, q))
+						continue;
+					float neighbourDepth = frame.depth[pixel(frame, q)];
+					if (neighbourDepth <= 0.f)
+						continue;
+
+					float weight = std::exp(-std::abs(depth - neighbourDepth) / (phiDepth * std::sqrt(static_cast<float>(i * i + j * j)) + SVGF_EPSILON)) * normalWeight(normal, decodeNormal(frame.normal[pixel(frame, q)]));
+					sumIllumination += glm::vec3(input[pixel(frame, q)]) * weight;
+					sumMoments += glm::vec2(moments[pixel(frame, q)]) * weight;
+					sumWeight += weight;
+				}
+			}
+
+			sumIllumination /= sumWeight;
+			sumMoments /= sumWeight;
+			float variance = std::max(sumMoments.y - sumMoments.x * sumMoments.x, 0.f) * (SVGF_VARIANCE_FRAMES / pixelMoments.z);
+			output[pixel(frame, p)] = roundHalf(glm::vec4(sumIllumination, variance));
+		}
+	}
+	source = ePongIllumination;
+}
+
+/*
+ * The first iteration writes the history of the next frame, the others ping-pong between the remaining images
+ */
+void Extensions::SVGFReference::atrous(const SVGFFrame& frame, const SVGFConstants& constants, uint32_t iteration) {
+	uint32_t target = iteration == 0 ? eHistoryIllumination : (source == ePingIllumination ? ePongIllumination : ePingIllumination);
+	const std::vector<glm::vec4>& input = illumination[source];
+	std::vector<glm::vec4>& output = illumination[target];
+	int step = static_cast<int>(constants.step);
+
+	for (int y = 0; y < static_cast<int>(frame.height); y++) {
+		for (int x = 0; x < static_cast<int>(frame.width); x++) {
+			glm::ivec2 p(x, y);
+			glm::vec4 center = input[pixel(frame, p)];
+			float depth = frame.depth[pixel(frame, p)];
+			if (depth <= 0.f) {
+				output[pixel(frame, p)] = center;
+				continue;
+			}
+
+			float blurredVariance = 0.f;
+			for (int j = -1; j <= 1; j++)
+				for (int i = -1; i <= 1; i++)
+					blurredVariance += input[pixel(frame, clampPixel(frame, p + glm::ivec2(i, j)))].w * GAUSSIAN[std::abs(i)] * GAUSSIAN[std::abs(j)];
+
+			glm::vec3 normal = decodeNormal(frame.normal[pixel(frame, p)]);
+			float l = luminance(glm::vec3(center));
+			float phiColor = constants.phiColor * std::sqrt(std::max(blurredVariance, 0.f));
+			float phiDepth = constants.phiDepth * depthGradient(frame, p, depth);
+
+			float sumWeight = KERNEL[0] * KERNEL[0];
+			glm::vec3 sumIllumination = glm::vec3(center) * sumWeight;
+			float sumVariance = center.w * sumWeight * sumWeight;
+			for (int j = -2; j <= 2; j++) {
+				for (int i = -2; i <= 2; i++) {
+					glm::ivec2 q = p + glm::ivec2(i, j) * step;
+					if ((i == 0 && j == 0) || !inside(frame, q))
+						continue;
+					float neighbourDepth = frame.depth[pixel(frame, q)];
+					if (neighbourDepth <= 0.f)
+						continue;
+
+					glm::vec4 neighbour = input[pixel(frame, q)];
+					float distance = std::sqrt(static_cast<float>(i * i + j * j)) * static_cast<float>(step);
+					float edges = std::abs(depth - neighbourDepth) / (phiDepth * distance + SVGF_EPSILON) + std::abs(l - luminance(glm::vec3(neighbour))) / (phiColor + SVGF_EPSILON);
+					float weight = KERNEL[std::abs(i)] * KERNEL[std::abs(j)] * std::exp(-edges) * normalWeight(normal, decodeNormal(frame.normal[pixel(frame, q)]));
+
+					sumIllumination += glm::vec3(neighbour) * weight;
+					sumVariance += neighbour.w * weight * weight;
+					sumWeight += weight;
+				}
+			}
+
+			output[pixel(frame, p)] = roundHalf(glm::vec4(sumIllumination / sumWeight, sumVariance / (sumWeight * sumWeight)));
+		}
+	}
+	source = target;
+}
+
+void Extensions::SVGFReference::modulate(const SVGFFrame& frame, std::vector<glm::vec4>& output) {
+	output.resize(static_cast<size_t>(frame.width) * frame.height);
+	const std::vector<glm::vec4>& input = illumination[source];
+
+	for (size_t i = 0; i < output.size(); i++) {
+		float depth = frame.depth[i];
+		glm::vec3 color = glm::vec3(input[i]);
+		output[i] = glm::vec4(depth > 0.f ? color * glm::max(Extensions::unpackAlbedo(frame.albedo[i]), SVGF_ALBEDO_MIN) : color, 1.f);
+
+		depthHistory[i] = depth;
+		normalHistory[i] = frame.normal[i];
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define SVGF_SHADER_PATH "shaders/svgf.slang.spv"
+#define SVGF_GROUP_SIZE 8U //numthreads of the passes in shaders/svgf.slang
+#define SVGF_ATROUS_ITERATIONS 5U //tap spacing doubles every iteration, 5 reach 61 pixels
+#define SVGF_ALPHA 0.2f //minimum weight of the new frame once the history is long enough
+#define SVGF_MOMENTS_ALPHA 0.2f
+#define SVGF_PHI_COLOR 4.f //luminance edge stop in standard deviations
+#define SVGF_PHI_DEPTH 1.f //depth edge stop in multiples of the local depth gradient
+#define SVGF_CLAMP_GAMMA 2.f //history clamping box in standard deviations of the neighbourhood, 0 disables it
+
+//largest difference between Denoiser and SVGFReference, relative to the reference value or SVGF_TOLERANCE_FLOOR if that is larger
+#define SVGF_TOLERANCE_TEMPORAL 1e-4f //moments and history length of temporalMain, 32 bit floats
+#define SVGF_TOLERANCE_ATROUS (8.f / 1024.f) //illumination history after varianceMain and the first atrousMain, 8 half ulps
+#define SVGF_TOLERANCE_MODULATE (16.f / 1024.f) //output of modulateMain after all a-trous iterations
+#define SVGF_TOLERANCE_FLOOR 1e-2f
+
+namespace Extensions {
+	enum SVGFFlags : uint32_t {
+		eSVGFReset = 1 //SVGF_RESET
+	};
+
+	/*
+	 * Push constants of every pass in shaders/svgf.slang
+	 */
+	struct SVGFConstants {
+		glm::mat4 reprojection{ 1.f }; //view space of this frame to clip space of the previous frame
+		glm::vec2 viewScale{ 1.f }; //view space x and y per unit of depth at the edge of the screen
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t step = 1; //a-trous tap spacing
+		uint32_t flags = 0;
+		float alpha = SVGF_ALPHA;
+		float momentsAlpha = SVGF_MOMENTS_ALPHA;
+		float phiColor = SVGF_PHI_COLOR;
+		float phiDepth = SVGF_PHI_DEPTH;
+		float clampGamma = SVGF_CLAMP_GAMMA;
+	};
+
+	/*
+	 * Inputs of one frame in the formats the ray tracing pass writes them, rows from the top
+	 */
+	struct SVGFFrame {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<glm::vec4> color; //RGBA32F noisy radiance
+		std::vector<float> depth; //R32F view space depth of the primary hit, 0 for misses
+		std::vector<uint32_t> normal; //R32UI octahedral world normal, encodeNormal
+		std::vector<uint32_t> albedo; //RGBA8 with red in the low byte, packAlbedo
+	};
+
+	uint32_t encodeNormal(glm::vec3 normal);
+	glm::vec3 decodeNormal(uint32_t packed);
+	uint32_t packAlbedo(glm::vec3 albedo);
+	glm::vec3 unpackAlbedo(uint32_t packed);
+
+	/*
+	 * CPU version of the SVGF passes in shaders/svgf.slang for testing the kernels without a GPU. It runs the same
+	 * operations in the same order and rounds to nearest even wherever the shader stores into an RGBA16F image.
+	 * It is not bit exact: Vulkan allows exp, sqrt and division a few ulps of error and RGBA16F stores may round
+	 * toward zero. Instead every pass output has a tolerance, SVGF_TOLERANCE_TEMPORAL for the moments,
+	 * SVGF_TOLERANCE_ATROUS for the history written by the variance pass and the first a-trous iteration and
+	 * SVGF_TOLERANCE_MODULATE for the output. The half stores dominate, later passes add up the error of earlier ones.
+	 * Benchmarks::denoiserCheck runs both on the same frames and fails beyond these tolerances.
+	 */
+	class SVGFReference {
+	public:
+		void denoise(const SVGFFrame& frame, SVGFConstants constants, std::vector<glm::vec4>& output);
+		void reset();
+
+		void temporal(const SVGFFrame& frame, const SVGFConstants& constants);
+		void variance(const SVGFFrame& frame, const SVGFConstants& constants);
+		void atrous(const SVGFFrame& frame, const SVGFConstants& constants, uint32_t iteration);
+		void modulate(const SVGFFrame& frame, std::vector<glm::vec4>& output);
+
+		inline const std::vector<glm::vec4>& getMomentsHistory() const { return momentsHistory; }
+		inline const std::vector<glm::vec4>& getIlluminationHistory() const { return illumination[eHistoryIllumination]; }
+	private:
+		enum Illumination { ePingIllumination, ePongIllumination, eHistoryIllumination };
+
+		void resize(uint32_t width, uint32_t height);
+		bool reproject(const SVGFFrame& frame, const SVGFConstants& constants, glm::ivec2 p, float depth, glm::vec3 normal, glm::vec4& history, glm::vec3& historyMoments) const;
+	private:
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool historyValid = false;
+
+		std::array<std::vector<glm::vec4>, 3> illumination; //RGBA16F, demodulated color and variance
+		std::vector<glm::vec4> moments; //RGBA32F, luminance moments and history length
+		std::vector<glm::vec4> momentsHistory;
+		std::vector<float> depthHistory;
+		std::vector<uint32_t> normalHistory;
+		uint32_t source = ePingIllumination; //image the last pass wrote
+	};
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Core {
+	/*
+	 * 64 bit FNV-1a, used to tell whether cached files still belong to their source (meshes, shaders, pipeline caches)
+	 */
+	inline uint64_t fnv1a(const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		uint64_t value = 0xcbf29ce484222325ULL;
+
+		for (size_t i = 0; i < size; i++) {
+			value ^= bytes[i];
+			value *= 0x100000001b3ULL;
+		}
+
+		return value;
+	}
+}
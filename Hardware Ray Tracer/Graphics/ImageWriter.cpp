@@ -0,0 +1,199 @@
+#include "ImageWriter.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+template<typename T>
+static void putLittleEndian(std::vector<uint8_t>& out, T value) {
+	uint8_t bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T)); //every platform the renderer runs on is little endian
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void putString(std::vector<uint8_t>& out, const char* string) {
+	out.insert(out.end(), string, string + strlen(string) + 1);
+}
+
+//IEC 61966-2-1 transfer function for a linear value in [0, 1]
+static float encodeSRGB(float linear) {
+	return linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f;
+}
+
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+
+	out.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return static_cast<bool>(out);
+}
+
+/*
+ * Chooses the format from the file extension, everything that is not .exr is written as PNG
+ */
+bool Core::ImageWriter::write(const std::string& path, uint32_t width, uint32_t height, const float* rgba) {
+	std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (extension == ".exr")
+		return writeEXR(path, width, height, rgba);
+	return writePNG(path, width, height, rgba);
+}
+
+/*
+ * 8 bit RGBA PNG tagged as sRGB, the colors are clamped to [0, 1] and sRGB encoded before they are quantized like
+ * the window output. Alpha stays linear.
+ */
+bool Core::ImageWriter::writePNG(const std::string& path, uint32_t width, uint32_t height, const float* rgba) {
+	//filter type 0 in front of every row
+	size_t rowSize = static_cast<size_t>(width) * 4 + 1;
+	std::vector<uint8_t> raw(rowSize * height);
+	for (uint32_t y = 0; y < height; y++) {
+		uint8_t* row = raw.data() + rowSize * y;
+		row[0] = 0;
+		for (uint32_t x = 0; x < width * 4; x++) {
+			float value = std::clamp(rgba[static_cast<size_t>(y) * width * 4 + x], 0.f, 1.f);
+			row[1 + x] = static_cast<uint8_t>((x % 4 == 3 ? value : encodeSRGB(value)) * 255.f + .5f);
+		}
+	}
+
+	//zlib stream made of stored deflate blocks
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	size_t offset = 0;
+	do {
+		uint16_t blockSize = static_cast<uint16_t>(std::min<size_t>(raw.size() - offset, 65535));
+		bool last = offset + blockSize == raw.size();
+
+		zlib.push_back(last ? 1 : 0);
+		putLittleEndian<uint16_t>(zlib, blockSize);
+		putLittleEndian<uint16_t>(zlib, static_cast<uint16_t>(~blockSize));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < raw.size());
+	putBigEndian(zlib, adler32(raw.data(), raw.size()));
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	auto putChunk = [&png](const char* type, const std::vector<uint8_t>& data) {
+		putBigEndian(png, static_cast<uint32_t>(data.size()));
+		size_t start = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+		putBigEndian(png, crc32(png.data() + start, png.size() - start));
+	};
+
+	std::vector<uint8_t> header;
+	putBigEndian(header, width);
+	putBigEndian(header, height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 }); //8 bit, RGBA, deflate, adaptive filtering, no interlace
+
+	putChunk("IHDR", header);
+	putChunk("sRGB", { 0 }); //perceptual rendering intent
+	putChunk("IDAT", zlib);
+	putChunk("IEND", {});
+
+	return writeFile(path, png);
+}
+
+/*
+ * Single part scanline EXR with one line per block, the channels are stored as 32 bit floats in alphabetical order
+ */
+bool Core::ImageWriter::writeEXR(const std::string& path, uint32_t width, uint32_t height, const float* rgba) {
+	std::vector<uint8_t> exr;
+	putLittleEndian<uint32_t>(exr, 20000630); //magic number
+	putLittleEndian<uint32_t>(exr, 2); //version 2, scanline image
+
+	auto putAttribute = [&exr](const char* name, const char* type, const std::vector<uint8_t>& value) {
+		putString(exr, name);
+		putString(exr, type);
+		putLittleEndian<int32_t>(exr, static_cast<int32_t>(value.size()));
+		exr.insert(exr.end(), value.begin(), value.end());
+	};
+
+	const char* channelNames[4] = { "A", "B", "G", "R" };
+	const uint32_t channelIndices[4] = { 3, 2, 1, 0 };
+
+	std::vector<uint8_t> channels;
+	for (const char* name : channelNames) {
+		putString(channels, name);
+		putLittleEndian<int32_t>(channels, 2); //FLOAT
+		putLittleEndian<uint32_t>(channels, 0); //pLinear and reserved
+		putLittleEndian<int32_t>(channels, 1); //x sampling
+		putLittleEndian<int32_t>(channels, 1); //y sampling
+	}
+	channels.push_back(0);
+
+	std::vector<uint8_t> window;
+	putLittleEndian<int32_t>(window, 0);
+	putLittleEndian<int32_t>(window, 0);
+	putLittleEndian<int32_t>(window, static_cast<int32_t>(width) - 1);
+	putLittleEndian<int32_t>(window, static_cast<int32_t>(height) - 1);
+
+	std::vector<uint8_t> one, center;
+	putLittleEndian<float>(one, 1.f);
+	putLittleEndian<float>(center, 0.f);
+	putLittleEndian<float>(center, 0.f);
+
+	putAttribute("channels", "chlist", channels);
+	putAttribute("compression", "compression", { 0 }); //no compression
+	putAttribute("dataWindow", "box2i", window);
+	putAttribute("displayWindow", "box2i", window);
+	putAttribute("lineOrder", "lineOrder", { 0 }); //increasing y
+	putAttribute("pixelAspectRatio", "float", one);
+	putAttribute("screenWindowCenter", "v2f", center);
+	putAttribute("screenWindowWidth", "float", one);
+	exr.push_back(0);
+
+	//line offset table, every block holds one scanline
+	uint32_t lineSize = width * 4 * sizeof(float);
+	uint64_t blockStart = exr.size() + static_cast<uint64_t>(height) * sizeof(uint64_t);
+	for (uint32_t y = 0; y < height; y++)
+		putLittleEndian<uint64_t>(exr, blockStart + static_cast<uint64_t>(y) * (8 + lineSize));
+
+	exr.reserve(exr.size() + static_cast<size_t>(height) * (8 + lineSize));
+	for (uint32_t y = 0; y < height; y++) {
+		putLittleEndian<int32_t>(exr, static_cast<int32_t>(y));
+		putLittleEndian<uint32_t>(exr, lineSize);
+
+		for (uint32_t channel : channelIndices)
+			for (uint32_t x = 0; x < width; x++)
+				putLittleEndian<float>(exr, rgba[(static_cast<size_t>(y) * width + x) * 4 + channel]);
+	}
+
+	return writeFile(path, exr);
+}
+
+uint32_t Core::ImageWriter::crc32(const uint8_t* data, size_t size, uint32_t crc) {
+	static uint32_t table[256] = {};
+	if (table[1] == 0) {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (uint32_t k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+uint32_t Core::ImageWriter::adler32(const uint8_t* data, size_t size, uint32_t adler) {
+	uint32_t a = adler & 0xFFFF, b = adler >> 16;
+	for (size_t i = 0; i < size; i++) {
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	return (b << 16) | a;
+}
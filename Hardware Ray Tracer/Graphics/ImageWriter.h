@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Core {
+	/*
+	 * Writes rendered frames to disk without third party libraries. PNGs are stored uncompressed inside
+	 * the zlib stream, EXRs are uncompressed 32 bit float scanline images.
+	 */
+	class ImageWriter {
+	public:
+		static bool write(const std::string& path, uint32_t width, uint32_t height, const float* rgba);
+		static bool writePNG(const std::string& path, uint32_t width, uint32_t height, const float* rgba);
+		static bool writeEXR(const std::string& path, uint32_t width, uint32_t height, const float* rgba);
+	private:
+		static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+		static uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+	};
+}
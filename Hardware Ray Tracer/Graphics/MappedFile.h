@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace Core {
+	/*
+	 * Read only memory mapping of a whole file, the mapping is released with close() or on destruction
+	 */
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& path);
+		void close();
+
+		inline const uint8_t* data() const { return mapped; }
+		inline size_t size() const { return fileSize; }
+		inline bool isOpen() const { return mapped != nullptr; }
+	private:
+		const uint8_t* mapped = nullptr;
+		size_t fileSize = 0;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+}
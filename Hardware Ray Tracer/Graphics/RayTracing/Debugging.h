@@ -3,4 +3,5 @@
 #include <iostream>
 
 #define DEBUG(message) std::cout << message << std::endl
-#define BUILD(name, step, stepCount, message) std::cout << "[INFO] " << name << ": " << step << " of " << stepCount << " completed! " << message << std::endl
\ No newline at end of file
+#define BUILD(name, step, stepCount, message) std::cout << "[INFO] " << name << ": " << step << " of " << stepCount << " completed! " << message << std::endl
+#define BENCHMARK(name, message) std::cout << "[BENCH] " << name << ": " << message << std::endl
@@ -0,0 +1,502 @@
+#include "LightSampling.h"
+
+#include <algorithm>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+#define ALIAS_BUCKET (1ULL << 32) //the average weight in the fixed point sums of buildAliasTable
+
+//relative power of a light, the constant 4 pi of a point light cancels in the pdf
+float RayTracing::lightPower(const Light& light) {
+	float luminance = 0.2126f * light.color[0] + 0.7152f * light.color[1] + 0.0722f * light.color[2];
+	return std::max(luminance * light.intensity, 0.f);
+}
+
+std::vector<RayTracing::LightAliasEntry> RayTracing::buildLightAliasTable(std::span<const Light> lights) {
+	std::vector<float> weights(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+		weights[i] = lightPower(lights[i]);
+	return buildAliasTable(weights);
+}
+
+namespace {
+	//runs function(chunk, begin, end) for equal parts of [0, count), the first part on the calling thread
+	template<typename F>
+	void forChunks(size_t count, uint32_t chunks, F function) {
+		size_t batch = (count + chunks - 1) / chunks;
+		std::vector<std::thread> workers;
+		for (uint32_t chunk = 1; chunk < chunks; chunk++)
+			workers.emplace_back(function, chunk, std::min(count, chunk * batch), std::min(count, (chunk + 1) * batch));
+		function(0U, size_t(0), std::min(count, batch));
+
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	struct AliasChunk {
+		double power = 0.0;
+		size_t light = 0; //buckets below the average
+		size_t heavy = 0;
+		uint64_t deficit = 0; //weight the light buckets miss to the average
+		uint64_t excess = 0; //weight the heavy buckets have above it
+	};
+}
+
+/*
+ * Alias table in O(n) with the sweep of Hübschle-Schneider and Sanders, "Parallel Weighted Random Sampling". The buckets
+ * below the average (light) are topped up in order by those above it (heavy). A light bucket's alias is the first heavy
+ * one whose excess, summed over the heavy buckets up to it, goes past the deficit of the light buckets before. A heavy
+ * bucket keeps what is left once those light buckets used up its excess and falls through to the next heavy one. Both
+ * running sums are prefix sums, so every step is split into threadCount parts. They are kept in 32.32 fixed point,
+ * which is exact in any order where doubles drift by a large fraction of a bucket over millions of entries. Entries
+ * without weight can never be picked, a table without any weight falls back to uniform picking.
+ */
+std::vector<RayTracing::LightAliasEntry> RayTracing::buildAliasTable(std::span<const float> weights, uint32_t threadCount) {
+	const size_t count = weights.size();
+	std::vector<LightAliasEntry> table(count);
+	if (count == 0) return table;
+
+	const uint32_t chunks = static_cast<uint32_t>(std::clamp<size_t>(count / LIGHT_ALIAS_PARALLEL_SIZE, 1, std::max(threadCount, 1U)));
+	std::vector<AliasChunk> sums(chunks);
+
+	forChunks(count, chunks, [&](uint32_t chunk, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			sums[chunk].power += std::max(weights[i], 0.f);
+	});
+	double totalPower = 0.0;
+	for (const AliasChunk& sum : sums)
+		totalPower += sum.power;
+
+	const bool uniform = totalPower <= 0.0;
+	if (uniform) totalPower = static_cast<double>(count);
+	const double toBuckets = count * static_cast<double>(ALIAS_BUCKET) / totalPower;
+	auto power = [&](size_t i) { return uniform ? 1.0 : static_cast<double>(std::max(weights[i], 0.f)); };
+	auto scaled = [&](size_t i) { return static_cast<uint64_t>(power(i) * toBuckets + 0.5); };
+
+	forChunks(count, chunks, [&](uint32_t chunk, size_t begin, size_t end) {
+		AliasChunk& sum = sums[chunk];
+		for (size_t i = begin; i < end; i++) {
+			uint64_t bucket = scaled(i);
+			table[i].pdf = static_cast<float>(power(i) / totalPower);
+			if (bucket < ALIAS_BUCKET) {
+				sum.light++;
+				sum.deficit += ALIAS_BUCKET - bucket;
+			}
+			else {
+				sum.heavy++;
+				sum.excess += bucket - ALIAS_BUCKET;
+			}
+		}
+	});
+
+	//exclusive scan over the chunks, each one then writes its part of the running sums
+	std::vector<AliasChunk> starts(chunks);
+	for (uint32_t chunk = 1; chunk < chunks; chunk++) {
+		starts[chunk].light = starts[chunk - 1].light + sums[chunk - 1].light;
+		starts[chunk].heavy = starts[chunk - 1].heavy + sums[chunk - 1].heavy;
+		starts[chunk].deficit = starts[chunk - 1].deficit + sums[chunk - 1].deficit;
+		starts[chunk].excess = starts[chunk - 1].excess + sums[chunk - 1].excess;
+	}
+	const size_t lightCount = starts.back().light + sums.back().light;
+	const size_t heavyCount = starts.back().heavy + sums.back().heavy;
+
+	std::vector<uint32_t> light(lightCount), heavy(heavyCount);
+	std::vector<uint64_t> deficit(lightCount + 1); //missing weight of the light buckets before, the total last
+	std::vector<uint64_t> excess(heavyCount); //excess weight of the heavy buckets up to and including this one
+	deficit[lightCount] = starts.back().deficit + sums.back().deficit;
+
+	forChunks(count, chunks, [&](uint32_t chunk, size_t begin, size_t end) {
+		size_t l = starts[chunk].light, h = starts[chunk].heavy;
+		uint64_t missing = starts[chunk].deficit, over = starts[chunk].excess;
+		for (size_t i = begin; i < end; i++) {
+			uint64_t bucket = scaled(i);
+			if (bucket < ALIAS_BUCKET) {
+				light[l] = static_cast<uint32_t>(i);
+				deficit[l++] = missing;
+				missing += ALIAS_BUCKET - bucket;
+			}
+			else {
+				over += bucket - ALIAS_BUCKET;
+				heavy[h] = static_cast<uint32_t>(i);
+				excess[h++] = over;
+			}
+		}
+	});
+
+	//both lists are sorted, each part searches its first partner and then walks along
+	forChunks(lightCount, chunks, [&](uint32_t, size_t begin, size_t end) {
+		if (begin >= end) return;
+		size_t h = std::upper_bound(excess.begin(), excess.end(), deficit[begin]) - excess.begin();
+		for (size_t l = begin; l < end; l++) {
+			while (h < heavyCount && excess[h] <= deficit[l])
+				h++;
+
+			//past the last heavy bucket only the rounding to fixed point is left
+			uint32_t i = light[l];
+			table[i].probability = h < heavyCount ? static_cast<float>(static_cast<double>(scaled(i)) / ALIAS_BUCKET) : 1.f;
+			table[i].alias = h < heavyCount ? heavy[h] : i;
+		}
+	});
+
+	forChunks(heavyCount, chunks, [&](uint32_t, size_t begin, size_t end) {
+		if (begin >= end) return;
+		size_t l = std::lower_bound(deficit.begin(), deficit.end(), excess[begin]) - deficit.begin();
+		for (size_t h = begin; h < end; h++) {
+			while (l <= lightCount && deficit[l] < excess[h])
+				l++;
+
+			//the last heavy bucket, and any the light ones do not use up, keep their own light up to rounding
+			uint32_t i = heavy[h];
+			bool spent = h + 1 < heavyCount && l <= lightCount;
+			table[i].probability = spent ? static_cast<float>(static_cast<double>(ALIAS_BUCKET + excess[h] - deficit[l]) / ALIAS_BUCKET) : 1.f;
+			table[i].alias = spent ? heavy[h + 1] : i;
+		}
+	});
+
+	forChunks(count, chunks, [&](uint32_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			table[i].aliasPdf = table[table[i].alias].pdf;
+	});
+
+	return table;
+}
+
+uint32_t RayTracing::sampleLightAliasTable(std::span<const LightAliasEntry> table, float u, float& pdf) {
+	float scaled = u * table.size();
+	uint32_t bucket = std::min(static_cast<uint32_t>(scaled), static_cast<uint32_t>(table.size()) - 1);
+
+	const LightAliasEntry& entry = table[bucket];
+	if (scaled - bucket < entry.probability) {
+		pdf = entry.pdf;
+		return bucket;
+	}
+	pdf = entry.aliasPdf;
+	return entry.alias;
+}
+
+/*
+ * Largest difference between the chance the table picks an entry, from its own bucket and every bucket that falls
+ * through to it, and the pdf the entry stores for the shader. It is relative to the average pdf 1 / n so tables of
+ * any size compare against the same tolerance. Aliases outside the table count as infinitely wrong.
+ */
+double RayTracing::aliasTableError(std::span<const LightAliasEntry> table) {
+	std::vector<double> picked(table.size(), 0.0);
+	for (size_t i = 0; i < table.size(); i++) {
+		if (table[i].alias >= table.size())
+			return std::numeric_limits<double>::infinity();
+		picked[i] += table[i].probability;
+		picked[table[i].alias] += 1.0 - table[i].probability;
+	}
+
+	//picked is in buckets, n times the chance
+	const double count = static_cast<double>(table.size());
+	double error = 0.0;
+	for (size_t i = 0; i < table.size(); i++) {
+		error = std::max(error, std::abs(picked[i] - count * table[i].pdf));
+		error = std::max(error, count * std::abs(table[i].aliasPdf - table[table[i].alias].pdf));
+	}
+	return error;
+}
+
+RayTracing::LightBounds RayTracing::lightBounds(const Light& light) {
+	glm::vec3 position(light.pos[0], light.pos[1], light.pos[2]);
+	return LightBounds{ position, position, lightPower(light), glm::vec3(0.f, 0.f, 1.f), glm::pi<float>() };
+}
+
+/*
+ * Union of two bounds, the cone is the smallest one around both cones (listing 1 of the paper)
+ */
+RayTracing::LightBounds RayTracing::unite(const LightBounds& a, const LightBounds& b) {
+	LightBounds result{ glm::min(a.min, b.min), glm::max(a.max, b.max), a.flux + b.flux, a.axis, a.coneAngle };
+
+	const LightBounds& wide = a.coneAngle >= b.coneAngle ? a : b;
+	const LightBounds& narrow = a.coneAngle >= b.coneAngle ? b : a;
+	result.axis = wide.axis;
+	result.coneAngle = wide.coneAngle;
+	if (wide.coneAngle >= glm::pi<float>())
+		return result;
+
+	float between = std::acos(std::clamp(glm::dot(wide.axis, narrow.axis), -1.f, 1.f));
+	if (std::min(between + narrow.coneAngle, glm::pi<float>()) <= wide.coneAngle)
+		return result;
+
+	float coneAngle = (wide.coneAngle + between + narrow.coneAngle) / 2.f;
+	if (coneAngle >= glm::pi<float>()) {
+		result.coneAngle = glm::pi<float>();
+		return result;
+	}
+
+	//rotate the wide axis towards the narrow one until the new cone touches both
+	glm::vec3 tangent = narrow.axis - wide.axis * glm::dot(wide.axis, narrow.axis);
+	if (glm::dot(tangent, tangent) < 1e-12f)
+		tangent = std::abs(wide.axis.x) < 0.9f ? glm::cross(wide.axis, glm::vec3(1.f, 0.f, 0.f)) : glm::cross(wide.axis, glm::vec3(0.f, 1.f, 0.f));
+
+	float rotation = coneAngle - wide.coneAngle;
+	result.axis = glm::normalize(wide.axis * std::cos(rotation) + glm::normalize(tangent) * std::sin(rotation));
+	result.coneAngle = coneAngle;
+	return result;
+}
+
+namespace {
+	struct BuildNode {
+		RayTracing::LightBounds bounds;
+		std::unique_ptr<BuildNode> children[2];
+		uint32_t emitter = 0;
+	};
+
+	//M_omega of the paper, the solid angle measure of the cone widened by the emission angle
+	float orientationMeasure(float coneAngle) {
+		//point lights only, the common case, skips the trigonometry of every split candidate
+		static const float sphere = 4.f * glm::pi<float>();
+		if (coneAngle >= glm::pi<float>())
+			return sphere;
+
+		float spread = std::min(coneAngle + LIGHT_EMISSION_ANGLE, glm::pi<float>());
+		float sinCone = std::sin(coneAngle), cosCone = std::cos(coneAngle);
+		return 2.f * glm::pi<float>() * (1.f - cosCone) + glm::pi<float>() / 2.f *
+			(2.f * spread * sinCone - std::cos(coneAngle - 2.f * spread) - 2.f * coneAngle * sinCone + cosCone);
+	}
+
+	//flat or point bounds still get an area, so splits between coplanar lights can be compared
+	float surfaceArea(const RayTracing::LightBounds& bounds, float minExtent) {
+		glm::vec3 extent = glm::max(bounds.max - bounds.min, glm::vec3(minExtent));
+		return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	glm::vec3 centroid(const RayTracing::LightBounds& bounds) {
+		return (bounds.min + bounds.max) * 0.5f;
+	}
+
+	class LightBVHBuilder {
+	public:
+		LightBVHBuilder(std::span<const RayTracing::LightBounds> emitters) : emitters(emitters) {}
+
+		std::unique_ptr<BuildNode> build(std::span<uint32_t> indices, uint32_t threads) {
+			auto node = std::make_unique<BuildNode>();
+			node->bounds = emitters[indices[0]];
+			node->emitter = indices[0];
+			if (indices.size() == 1)
+				return node;
+
+			glm::vec3 centroidMin = centroid(node->bounds), centroidMax = centroidMin;
+			for (size_t i = 1; i < indices.size(); i++) {
+				const RayTracing::LightBounds& emitter = emitters[indices[i]];
+				node->bounds = RayTracing::unite(node->bounds, emitter);
+				centroidMin = glm::min(centroidMin, centroid(emitter));
+				centroidMax = glm::max(centroidMax, centroid(emitter));
+			}
+
+			size_t middle = split(indices, node->bounds, centroidMin, centroidMax);
+			std::span<uint32_t> left = indices.first(middle), right = indices.subspan(middle);
+
+			if (threads > 1 && indices.size() >= LIGHT_BVH_PARALLEL_SIZE) {
+				std::thread worker([&]() { node->children[0] = build(left, threads / 2); });
+				node->children[1] = build(right, threads - threads / 2);
+				worker.join();
+			}
+			else {
+				node->children[0] = build(left, 1);
+				node->children[1] = build(right, 1);
+			}
+			return node;
+		}
+	private:
+		/*
+		 * Partitions the indices at the cheapest bucket boundary by the surface area orientation heuristic,
+		 * falls back to halving when all centroids coincide
+		 */
+		size_t split(std::span<uint32_t> indices, const RayTracing::LightBounds& bounds, glm::vec3 centroidMin, glm::vec3 centroidMax) {
+			glm::vec3 extent = bounds.max - bounds.min;
+			float maxExtent = std::max({ extent.x, extent.y, extent.z });
+			float minExtent = std::max(maxExtent * 1e-3f, 1e-6f);
+			float parentCost = bounds.flux * surfaceArea(bounds, minExtent) * orientationMeasure(bounds.coneAngle);
+
+			float bestCost = std::numeric_limits<float>::infinity();
+			int bestAxis = -1;
+			uint32_t bestBucket = 0;
+
+			//all three axes are binned in one pass, the emitters are scattered in memory
+			RayTracing::LightBounds bins[3][LIGHT_BVH_BUCKETS];
+			uint32_t binCounts[3][LIGHT_BVH_BUCKETS]{};
+			for (uint32_t index : indices) {
+				const RayTracing::LightBounds& emitter = emitters[index];
+				for (int axis = 0; axis < 3; axis++) {
+					if (centroidMax[axis] <= centroidMin[axis])
+						continue;
+
+					uint32_t bucket = bucketOf(emitter, axis, centroidMin, centroidMax);
+					bins[axis][bucket] = binCounts[axis][bucket]++ == 0 ? emitter : RayTracing::unite(bins[axis][bucket], emitter);
+				}
+			}
+
+			for (int axis = 0; axis < 3; axis++) {
+				if (centroidMax[axis] <= centroidMin[axis])
+					continue;
+
+				const RayTracing::LightBounds* buckets = bins[axis];
+				const uint32_t* counts = binCounts[axis];
+
+				//costs of the upper side for every boundary, swept from the top
+				float upperCosts[LIGHT_BVH_BUCKETS]{};
+				RayTracing::LightBounds upper{};
+				uint32_t upperCount = 0;
+				for (uint32_t bucket = LIGHT_BVH_BUCKETS - 1; bucket > 0; bucket--) {
+					if (counts[bucket] > 0)
+						upper = upperCount++ == 0 ? buckets[bucket] : RayTracing::unite(upper, buckets[bucket]);
+					upperCosts[bucket] = upperCount > 0 ? cost(upper, minExtent) : -1.f;
+				}
+
+				RayTracing::LightBounds lower{};
+				uint32_t lowerCount = 0;
+				float regularization = maxExtent / std::max(extent[axis], minExtent);
+				for (uint32_t bucket = 1; bucket < LIGHT_BVH_BUCKETS; bucket++) {
+					if (counts[bucket - 1] > 0)
+						lower = lowerCount++ == 0 ? buckets[bucket - 1] : RayTracing::unite(lower, buckets[bucket - 1]);
+					if (lowerCount == 0 || upperCosts[bucket] < 0.f)
+						continue;
+
+					float splitCost = regularization * (cost(lower, minExtent) + upperCosts[bucket]) / std::max(parentCost, 1e-30f);
+					if (splitCost < bestCost) {
+						bestCost = splitCost;
+						bestAxis = axis;
+						bestBucket = bucket;
+					}
+				}
+			}
+
+			if (bestAxis < 0)
+				return indices.size() / 2;
+
+			auto middle = std::partition(indices.begin(), indices.end(), [&](uint32_t index) {
+				return bucketOf(emitters[index], bestAxis, centroidMin, centroidMax) < bestBucket;
+			});
+			return static_cast<size_t>(middle - indices.begin());
+		}
+
+		static uint32_t bucketOf(const RayTracing::LightBounds& emitter, int axis, glm::vec3 centroidMin, glm::vec3 centroidMax) {
+			float offset = (centroid(emitter)[axis] - centroidMin[axis]) / (centroidMax[axis] - centroidMin[axis]);
+			return std::min(static_cast<uint32_t>(offset * LIGHT_BVH_BUCKETS), LIGHT_BVH_BUCKETS - 1);
+		}
+
+		static float cost(const RayTracing::LightBounds& bounds, float minExtent) {
+			return bounds.flux * surfaceArea(bounds, minExtent) * orientationMeasure(bounds.coneAngle);
+		}
+	private:
+		std::span<const RayTracing::LightBounds> emitters;
+	};
+
+	//depth first, the two children of a node are always stored next to each other
+	void flatten(const BuildNode& node, std::vector<RayTracing::LightBVHNode>& nodes, size_t index) {
+		RayTracing::LightBVHNode& flat = nodes[index];
+		for (int i = 0; i < 3; i++) {
+			flat.bBoxMin[i] = node.bounds.min[i];
+			flat.bBoxMax[i] = node.bounds.max[i];
+			flat.coneAxis[i] = node.bounds.axis[i];
+		}
+		flat.totalFlux = node.bounds.flux;
+		flat.coneAngle = node.bounds.coneAngle;
+
+		if (!node.children[0]) {
+			flat.childIndex = -static_cast<int>(node.emitter) - 1;
+			return;
+		}
+
+		size_t first = nodes.size();
+		flat.childIndex = static_cast<int>(first);
+		nodes.resize(first + 2);
+		flatten(*node.children[0], nodes, first);
+		flatten(*node.children[1], nodes, first + 1);
+	}
+}
+
+/*
+ * Builds the light BVH top down with SAOH splits, the bounds, flux and cones are merged bottom up by unite.
+ * The upper levels are split across threads. The result is the flattened tree with the root first.
+ */
+std::vector<RayTracing::LightBVHNode> RayTracing::buildLightBVH(std::span<const LightBounds> emitters, uint32_t threadCount) {
+	std::vector<LightBVHNode> nodes;
+	if (emitters.empty()) return nodes;
+
+	std::vector<uint32_t> indices(emitters.size());
+	for (uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+
+	LightBVHBuilder builder(emitters);
+	std::unique_ptr<BuildNode> root = builder.build(indices, std::max(threadCount, 1U));
+
+	nodes.reserve(emitters.size() * 2 - 1);
+	nodes.resize(1);
+	flatten(*root, nodes, 0);
+	return nodes;
+}
+
+/*
+ * Conservative estimate of the light a node can send to a surface at position with the given normal,
+ * zero only when every emitter is behind the surface or faces away from it
+ */
+float RayTracing::lightNodeImportance(const LightBVHNode& node, glm::vec3 position, glm::vec3 normal) {
+	glm::vec3 boxMin(node.bBoxMin[0], node.bBoxMin[1], node.bBoxMin[2]);
+	glm::vec3 boxMax(node.bBoxMax[0], node.bBoxMax[1], node.bBoxMax[2]);
+	glm::vec3 axis(node.coneAxis[0], node.coneAxis[1], node.coneAxis[2]);
+
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 toCenter = center - position;
+	float distance2 = glm::dot(toCenter, toCenter);
+	float radius2 = glm::dot(boxMax - center, boxMax - center);
+
+	//inside the bounding sphere every direction is possible
+	if (distance2 <= radius2)
+		return node.totalFlux / std::max(radius2, 1e-6f);
+
+	float distance = std::sqrt(distance2);
+	glm::vec3 direction = toCenter / distance;
+	float boundAngle = std::asin(std::min(std::sqrt(radius2) / distance, 1.f));
+
+	float emitterAngle = std::acos(std::clamp(glm::dot(axis, -direction), -1.f, 1.f));
+	float emitter = std::max(emitterAngle - node.coneAngle - boundAngle, 0.f);
+	if (emitter >= LIGHT_EMISSION_ANGLE)
+		return 0.f;
+
+	float receiverAngle = std::acos(std::clamp(glm::dot(normal, direction), -1.f, 1.f));
+	float receiver = std::max(receiverAngle - boundAngle, 0.f);
+	if (receiver >= glm::pi<float>() / 2.f)
+		return 0.f;
+
+	return node.totalFlux * std::cos(emitter) * std::cos(receiver) / distance2;
+}
+
+/*
+ * Walks from the root to one leaf, each child is chosen in proportion to its importance and the random number
+ * is rescaled for the next level. Returns the emitter and its pdf or -1 when no emitter reaches the point.
+ */
+int32_t RayTracing::sampleLightBVH(std::span<const LightBVHNode> nodes, glm::vec3 position, glm::vec3 normal, float u, float& pdf) {
+	pdf = 0.f;
+	if (nodes.empty() || lightNodeImportance(nodes[0], position, normal) <= 0.f)
+		return -1;
+
+	pdf = 1.f;
+	uint32_t index = 0;
+	while (nodes[index].childIndex >= 0) {
+		uint32_t first = static_cast<uint32_t>(nodes[index].childIndex);
+		float left = lightNodeImportance(nodes[first], position, normal);
+		float right = lightNodeImportance(nodes[first + 1], position, normal);
+		if (left + right <= 0.f) {
+			pdf = 0.f;
+			return -1;
+		}
+
+		float probability = left / (left + right);
+		if (u < probability) {
+			u = std::min(u / probability, 0.99999994f);
+			pdf *= probability;
+			index = first;
+		}
+		else {
+			u = std::min((u - probability) / (1.f - probability), 0.99999994f);
+			pdf *= 1.f - probability;
+			index = first + 1;
+		}
+	}
+	return -nodes[index].childIndex - 1;
+}
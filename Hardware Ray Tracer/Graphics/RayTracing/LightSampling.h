@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Scene.h"
+#include <span>
+#include <vector>
+#include <thread>
+
+#define LIGHT_BVH_BUCKETS 12U //SAOH split candidates per axis
+#define LIGHT_BVH_PARALLEL_SIZE 4096U //smallest subtree that is handed to another thread
+#define LIGHT_ALIAS_PARALLEL_SIZE 65536U //fewest alias table entries handed to one thread
+#define LIGHT_EMISSION_ANGLE (glm::pi<float>() / 2.f) //theta_e, every emitter shines up to 90 degrees past its normal cone
+#define LIGHT_ALIAS_TOLERANCE 1e-6 //largest aliasTableError of a built table, a few float ulps of the stored probabilities
+
+namespace RayTracing {
+	enum LightSampler : uint32_t {
+		eLightSamplerUniform,
+		eLightSamplerPower, //alias table
+		eLightSamplerBVH
+	};
+
+	/*
+	 * One bucket of the light alias table. A uniformly picked bucket keeps its own light with the given
+	 * probability and otherwise falls through to the alias. Both pdfs are stored so the shader needs a single read.
+	 */
+	struct LightAliasEntry {
+		float probability;
+		uint32_t alias;
+		float pdf; //chance of picking this bucket's light over the whole table
+		float aliasPdf; //chance of picking the alias over the whole table
+	};
+
+	/*
+	 * Spatial and directional bounds of a group of emitters (Conty Estevez and Kulla, "Importance Sampling of Many Lights
+	 * with Adaptive Tree Splitting"). The cone holds all emission normals, point lights use the full sphere.
+	 */
+	struct LightBounds {
+		glm::vec3 min;
+		glm::vec3 max;
+		float flux;
+		glm::vec3 axis;
+		float coneAngle; //theta_o
+	};
+
+	float lightPower(const Light& light);
+	std::vector<LightAliasEntry> buildAliasTable(std::span<const float> weights, uint32_t threadCount = std::thread::hardware_concurrency());
+	std::vector<LightAliasEntry> buildLightAliasTable(std::span<const Light> lights);
+	uint32_t sampleLightAliasTable(std::span<const LightAliasEntry> table, float u, float& pdf);
+	double aliasTableError(std::span<const LightAliasEntry> table);
+
+	LightBounds lightBounds(const Light& light);
+	LightBounds unite(const LightBounds& a, const LightBounds& b);
+	std::vector<LightBVHNode> buildLightBVH(std::span<const LightBounds> emitters, uint32_t threadCount = std::thread::hardware_concurrency());
+
+	//host versions of the traversal in shaders/light.slang, used to measure the sampling quality
+	float lightNodeImportance(const LightBVHNode& node, glm::vec3 position, glm::vec3 normal);
+	int32_t sampleLightBVH(std::span<const LightBVHNode> nodes, glm::vec3 position, glm::vec3 normal, float u, float& pdf);
+}
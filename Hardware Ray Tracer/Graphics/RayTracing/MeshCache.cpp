@@ -0,0 +1,146 @@
+#include "MeshCache.h"
+#include "../Hash.h"
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+
+/*
+ * Maps the cache of sourcePath. The cache is used if size and write time of the source still match,
+ * or if they changed but the content hash did not (e.g. after a fresh checkout). In that case the header
+ * takes the new size and time, so the next launch does not hash the source again.
+ */
+bool RayTracing::MeshCache::open(const std::string& sourcePath) {
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (!sourceInfo(sourcePath, sourceSize, sourceTime)) return false;
+
+	std::string path = cachePath(sourcePath);
+	file = std::make_shared<Core::MappedFile>();
+	if (!file->open(path)) return false;
+
+	if (file->size() < sizeof(BMeshHeader)) {
+		close();
+		return false;
+	}
+
+	//the counts come from the file, each product is checked against the payload so a corrupt cache cannot wrap them around
+	const BMeshHeader& header = getHeader();
+	uint64_t payload = file->size() - sizeof(BMeshHeader);
+	bool sizeMatches = header.vertexCount <= payload / sizeof(Vertex) && header.indexCount <= payload / sizeof(uint32_t)
+		&& header.vertexCount * sizeof(Vertex) == payload - header.indexCount * sizeof(uint32_t);
+
+	if (header.magic != BMESH_MAGIC || header.version != BMESH_VERSION || header.vertexStride != sizeof(Vertex) || !sizeMatches) {
+		close();
+		return false;
+	}
+
+	if (header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+		uint64_t sourceHash;
+		if (!hashSource(sourcePath, sourceHash) || sourceHash != header.sourceHash) {
+			close();
+			return false;
+		}
+
+		BMeshHeader updated = header;
+		updated.sourceSize = sourceSize;
+		updated.sourceTime = sourceTime;
+
+		//a mapped file cannot be written on Windows
+		file->close();
+		if (!writeHeader(path, updated))
+			DEBUG("[WARNING] Mesh Cache: failed to update the source time of " << path);
+		if (!file->open(path) || file->size() != sizeof(BMeshHeader) + payload) {
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::span<const RayTracing::Vertex> RayTracing::MeshCache::getVertices() {
+	const Vertex* vertices = reinterpret_cast<const Vertex*>(file->data() + sizeof(BMeshHeader));
+	return std::span<const Vertex>(vertices, getHeader().vertexCount);
+}
+
+std::span<const uint32_t> RayTracing::MeshCache::getIndices() {
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(file->data() + sizeof(BMeshHeader) + getHeader().vertexCount * sizeof(Vertex));
+	return std::span<const uint32_t>(indices, getHeader().indexCount);
+}
+
+/*
+ * Writes the cache into a temporary file first, so a crash never leaves a truncated cache behind
+ */
+bool RayTracing::MeshCache::write(const std::string& sourcePath, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+	BMeshHeader header{
+		.magic = BMESH_MAGIC,
+		.version = BMESH_VERSION,
+		.vertexStride = sizeof(Vertex),
+		.vertexCount = vertices.size(),
+		.indexCount = indices.size()
+	};
+
+	if (!sourceInfo(sourcePath, header.sourceSize, header.sourceTime) || !hashSource(sourcePath, header.sourceHash)) return false;
+
+	std::fill(std::begin(header.boundsMin), std::end(header.boundsMin), vertices.empty() ? 0.f : std::numeric_limits<float>::max());
+	std::fill(std::begin(header.boundsMax), std::end(header.boundsMax), vertices.empty() ? 0.f : -std::numeric_limits<float>::max());
+
+	for (const Vertex& vertex : vertices) {
+		for (uint32_t axis = 0; axis < 3; axis++) {
+			header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.pos[axis]);
+			header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.pos[axis]);
+		}
+	}
+
+	std::string path = cachePath(sourcePath);
+	std::string tempPath = path + ".tmp";
+
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(BMeshHeader));
+		out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+		out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+
+		if (!out) return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+//overwrites the header of an existing cache in place, the geometry behind it stays untouched
+bool RayTracing::MeshCache::writeHeader(const std::string& path, const BMeshHeader& header) {
+	std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+	if (!out) return false;
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(BMeshHeader));
+	return static_cast<bool>(out);
+}
+
+bool RayTracing::MeshCache::hashSource(const std::string& sourcePath, uint64_t& sourceHash) {
+	Core::MappedFile source;
+	if (!source.open(sourcePath)) return false;
+
+	sourceHash = Core::fnv1a(source.data(), source.size());
+	return true;
+}
+
+bool RayTracing::MeshCache::sourceInfo(const std::string& sourcePath, uint64_t& sourceSize, int64_t& sourceTime) {
+	std::error_code error;
+
+	sourceSize = std::filesystem::file_size(sourcePath, error);
+	if (error) return false;
+
+	sourceTime = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+	return !error;
+}
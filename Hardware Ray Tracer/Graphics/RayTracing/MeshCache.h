@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Scene.h"
+#include "../MappedFile.h"
+#include <span>
+#include <memory>
+
+#define BMESH_MAGIC 0x48534D42U //"BMSH"
+#define BMESH_VERSION 1U
+
+namespace RayTracing {
+	struct BMeshHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexStride; //sizeof(Vertex) at write time, a layout change invalidates the cache
+		uint32_t reserved;
+
+		uint64_t vertexCount;
+		uint64_t indexCount;
+
+		float boundsMin[3];
+		float boundsMax[3];
+
+		uint64_t sourceSize; //byte size of the source file
+		int64_t sourceTime; //last write time of the source file
+		uint64_t sourceHash; //FNV-1a hash of the source file
+	};
+
+	/*
+	 * Binary cache of an imported model, stored next to the source as <source>.bmesh.
+	 * The file is the header followed by the deduplicated vertex array and the 32 bit index array,
+	 * both are read straight from the memory mapping. Meshes built from the spans share the mapping, it stays open
+	 * until the last of them and the cache are gone.
+	 */
+	class MeshCache {
+	public:
+		bool open(const std::string& sourcePath);
+		void close() { file = std::make_shared<Core::MappedFile>(); }
+
+		std::span<const Vertex> getVertices();
+		std::span<const uint32_t> getIndices();
+		inline const BMeshHeader& getHeader() { return *reinterpret_cast<const BMeshHeader*>(file->data()); }
+		inline std::shared_ptr<const Core::MappedFile> getMapping() { return file; }
+
+		static bool write(const std::string& sourcePath, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		static inline std::string cachePath(const std::string& sourcePath) { return sourcePath + ".bmesh"; }
+	private:
+		static bool hashSource(const std::string& sourcePath, uint64_t& sourceHash);
+		static bool sourceInfo(const std::string& sourcePath, uint64_t& sourceSize, int64_t& sourceTime);
+		static bool writeHeader(const std::string& path, const BMeshHeader& header);
+	private:
+		std::shared_ptr<Core::MappedFile> file = std::make_shared<Core::MappedFile>();
+	};
+}
@@ -0,0 +1,383 @@
+#include "ObjImporter.h"
+#include "../VertexDeduplicator.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//character at offset i of the line, '\0' past its end like in a null terminated line buffer
+static inline char charAt(const char* token, const char* end, size_t i) {
+	return token + i < end ? token[i] : '\0';
+}
+
+static inline bool isSpace(char c) {
+	return c == ' ' || c == '\t';
+}
+
+static inline bool isDigit(char c) {
+	return static_cast<unsigned int>(c - '0') < 10U;
+}
+
+static inline const char* skipSpaces(const char* token, const char* end) {
+	while (token < end && isSpace(*token))
+		token++;
+	return token;
+}
+
+/*
+ * Same grammar and arithmetic as tryParseDouble of tinyobjloader 1.0.6, so every value rounds to the same float
+ */
+static bool parseDouble(const char* s, const char* end, double* result) {
+	if (s >= end)
+		return false;
+
+	double mantissa = 0.0;
+	int exponent = 0;
+	char sign = '+';
+	char expSign = '+';
+	const char* curr = s;
+	int read = 0;
+
+	if (*curr == '+' || *curr == '-') {
+		sign = *curr;
+		curr++;
+	} else if (!isDigit(*curr))
+		return false;
+
+	//integer part
+	while (curr < end && isDigit(*curr)) {
+		mantissa *= 10;
+		mantissa += static_cast<int>(*curr - '0');
+		curr++;
+		read++;
+	}
+
+	if (read == 0)
+		return false;
+
+	if (curr < end && *curr == '.') {
+		//decimal part
+		curr++;
+		read = 1;
+		while (curr < end && isDigit(*curr)) {
+			static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+			const int lutEntries = sizeof(powLut) / sizeof(powLut[0]);
+
+			mantissa += static_cast<int>(*curr - '0') * (read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+			read++;
+			curr++;
+		}
+	}
+
+	if (curr < end && (*curr == 'e' || *curr == 'E')) {
+		//exponent part
+		curr++;
+		if (curr < end && (*curr == '+' || *curr == '-')) {
+			expSign = *curr;
+			curr++;
+		} else if (curr >= end || !isDigit(*curr))
+			return false;
+
+		read = 0;
+		while (curr < end && isDigit(*curr)) {
+			exponent *= 10;
+			exponent += static_cast<int>(*curr - '0');
+			curr++;
+			read++;
+		}
+
+		exponent *= (expSign == '+' ? 1 : -1);
+		if (read == 0)
+			return false;
+	}
+
+	*result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+	return true;
+}
+
+static inline float parseFloat(const char** token, const char* end) {
+	*token = skipSpaces(*token, end);
+	const char* valueEnd = *token;
+	while (valueEnd < end && !isSpace(*valueEnd))
+		valueEnd++;
+
+	double value = 0.0;
+	parseDouble(*token, valueEnd, &value);
+	*token = valueEnd;
+	return static_cast<float>(value);
+}
+
+//atoi on a line that is not null terminated
+static inline int parseInt(const char* token, const char* end) {
+	while (token < end && (isSpace(*token) || *token == '\v' || *token == '\f'))
+		token++;
+
+	bool negative = false;
+	if (token < end && (*token == '+' || *token == '-')) {
+		negative = *token == '-';
+		token++;
+	}
+
+	int64_t value = 0;
+	while (token < end && isDigit(*token))
+		value = value * 10 + (*token++ - '0');
+	return static_cast<int>(negative ? -value : value);
+}
+
+static inline const char* skipIndex(const char* token, const char* end) {
+	while (token < end && *token != '/' && !isSpace(*token))
+		token++;
+	return token;
+}
+
+RayTracing::ObjImporter::ObjImporter(uint32_t threadCount) : threadCount(std::max(threadCount, 1U)) {}
+
+/*
+ * Imports the triangles of an OBJ file as deduplicated vertices and indices, positions and normals are flipped on the y axis
+ */
+void RayTracing::ObjImporter::load(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Core::MappedFile file;
+	if (!file.open(path)) {
+		std::string err = "Cannot open file [" + path + "]";
+		std::cout << "[ERROR] Scene: " << err << std::endl;
+		throw std::runtime_error(err);
+	}
+
+	//split at line boundaries, small files are parsed by fewer threads
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* dataEnd = data + file.size();
+	size_t chunkCount = std::clamp<size_t>(file.size() / OBJ_MIN_CHUNK_SIZE, 1, threadCount);
+
+	std::vector<Chunk> chunks(chunkCount);
+	const char* begin = data;
+	for (size_t i = 0; i < chunkCount; i++) {
+		const char* end = dataEnd;
+		if (i + 1 < chunkCount) {
+			end = std::max(data + file.size() * (i + 1) / chunkCount, begin);
+			const char* newLine = static_cast<const char*>(memchr(end, '\n', dataEnd - end));
+			end = newLine ? newLine + 1 : dataEnd;
+		}
+
+		chunks[i].begin = begin;
+		chunks[i].end = end;
+		begin = end;
+	}
+
+	parallelFor(chunkCount, [&](size_t i) { parseChunk(chunks[i]); });
+
+	//prefix scan over the attribute counts
+	size_t positionCount = 0, normalCount = 0, texcoordCount = 0, cornerCount = 0;
+	for (Chunk& chunk : chunks) {
+		chunk.positionBase = positionCount;
+		chunk.normalBase = normalCount;
+		chunk.texcoordBase = texcoordCount;
+
+		positionCount += chunk.positions.size() / 3;
+		normalCount += chunk.normals.size() / 3;
+		texcoordCount += chunk.texcoords.size() / 2;
+		cornerCount += chunk.corners.size();
+	}
+
+	std::vector<float> positions(positionCount * 3);
+	std::vector<float> normals(normalCount * 3);
+	std::vector<float> texcoords(texcoordCount * 2);
+
+	parallelFor(chunkCount, [&](size_t i) {
+		Chunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase * 3);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase * 3);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordBase * 2);
+
+		for (const auto& [cornerIndex, relative] : chunk.relativeCorners) {
+			Corner& corner = chunk.corners[cornerIndex];
+			if (relative & ePosition) corner.position += static_cast<int32_t>(chunk.positionBase);
+			if (relative & eTexcoord) corner.texcoord += static_cast<int32_t>(chunk.texcoordBase);
+			if (relative & eNormal) corner.normal += static_cast<int32_t>(chunk.normalBase);
+		}
+
+		chunk.positions = {};
+		chunk.normals = {};
+		chunk.texcoords = {};
+	});
+
+	//the dedup keeps the file order, so it stays on one thread
+	Core::VertexDeduplicator<Vertex> deduplicator(vertices, indices, cornerCount);
+	for (const Chunk& chunk : chunks) {
+		for (const Corner& corner : chunk.corners) {
+			if (corner.position >= static_cast<int64_t>(positionCount) || corner.normal >= static_cast<int64_t>(normalCount) || corner.texcoord >= static_cast<int64_t>(texcoordCount))
+				throw std::runtime_error("OBJ index out of range in " + path);
+
+			Vertex vertex{};
+			if (corner.position >= 0) {
+				vertex.pos[0] = positions[3 * corner.position + 0];
+				vertex.pos[1] = -positions[3 * corner.position + 1];
+				vertex.pos[2] = positions[3 * corner.position + 2];
+			}
+
+			if (corner.normal >= 0) {
+				vertex.normal[0] = normals[3 * corner.normal + 0];
+				vertex.normal[1] = -normals[3 * corner.normal + 1];
+				vertex.normal[2] = normals[3 * corner.normal + 2];
+			}
+
+			if (corner.texcoord >= 0) {
+				vertex.uv[0] = texcoords[2 * corner.texcoord + 0];
+				vertex.uv[1] = texcoords[2 * corner.texcoord + 1];
+			}
+
+			deduplicator.add(vertex);
+		}
+	}
+
+	float time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+	DEBUG("[INFO] OBJ Import: " << path << ": " << indices.size() / 3 << " triangles on " << chunkCount << " thread(s) in " << time << " ms");
+}
+
+/*
+ * Parses every line of the chunk, a line ends at \n, \r\n or a lone \r
+ */
+void RayTracing::ObjImporter::parseChunk(Chunk& chunk) {
+	const char* token = chunk.begin;
+	while (token < chunk.end) {
+		const char* newLine = static_cast<const char*>(memchr(token, '\n', chunk.end - token));
+		if (!newLine)
+			newLine = chunk.end;
+
+		const char* lineEnd = newLine;
+		const char* next = newLine == chunk.end ? chunk.end : newLine + 1;
+
+		const char* carriageReturn = static_cast<const char*>(memchr(token, '\r', newLine - token));
+		if (carriageReturn) {
+			lineEnd = carriageReturn;
+			if (carriageReturn + 1 != newLine)
+				next = carriageReturn + 1;
+		}
+
+		parseLine(chunk, token, lineEnd);
+		token = next;
+	}
+}
+
+void RayTracing::ObjImporter::parseLine(Chunk& chunk, const char* token, const char* end) {
+	token = skipSpaces(token, end);
+	if (token == end || *token == '#')
+		return;
+
+	//position
+	if (token[0] == 'v' && isSpace(charAt(token, end, 1))) {
+		token += 2;
+		for (uint32_t i = 0; i < 3; i++)
+			chunk.positions.push_back(parseFloat(&token, end));
+		return;
+	}
+
+	//normal
+	if (token[0] == 'v' && charAt(token, end, 1) == 'n' && isSpace(charAt(token, end, 2))) {
+		token += 3;
+		for (uint32_t i = 0; i < 3; i++)
+			chunk.normals.push_back(parseFloat(&token, end));
+		return;
+	}
+
+	//texcoord
+	if (token[0] == 'v' && charAt(token, end, 1) == 't' && isSpace(charAt(token, end, 2))) {
+		token += 3;
+		for (uint32_t i = 0; i < 2; i++)
+			chunk.texcoords.push_back(parseFloat(&token, end));
+		return;
+	}
+
+	//face, triangulated as a fan around the first corner
+	if (token[0] == 'f' && isSpace(charAt(token, end, 1))) {
+		token = skipSpaces(token + 2, end);
+
+		Corner first{}, previous{};
+		uint8_t firstRelative = 0, previousRelative = 0;
+		uint32_t cornerCount = 0;
+		while (token < end) {
+			uint8_t relative = 0;
+			Corner corner = parseCorner(chunk, &token, end, relative);
+			token = skipSpaces(token, end);
+
+			if (cornerCount >= 2) {
+				const Corner triangle[3] = { first, previous, corner };
+				const uint8_t triangleRelative[3] = { firstRelative, previousRelative, relative };
+				for (uint32_t i = 0; i < 3; i++) {
+					if (triangleRelative[i])
+						chunk.relativeCorners.push_back({ static_cast<uint32_t>(chunk.corners.size()), triangleRelative[i] });
+					chunk.corners.push_back(triangle[i]);
+				}
+			}
+
+			if (cornerCount == 0) {
+				first = corner;
+				firstRelative = relative;
+			}
+
+			previous = corner;
+			previousRelative = relative;
+			cornerCount++;
+		}
+	}
+
+	//groups, objects, materials and smoothing groups do not change the geometry
+}
+
+/*
+ * Parses v, v/vt, v//vn or v/vt/vn. Indices are 1 based, negative indices count back from the last attribute
+ * read so far and are only chunk local until load() adds the attribute counts of the preceding chunks.
+ */
+RayTracing::ObjImporter::Corner RayTracing::ObjImporter::parseCorner(Chunk& chunk, const char** token, const char* end, uint8_t& relative) {
+	auto fixIndex = [&relative](int index, size_t localCount, RelativeIndex flag) {
+		if (index > 0) return index - 1;
+		if (index == 0) return 0;
+
+		relative |= flag;
+		return static_cast<int>(localCount) + index;
+	};
+
+	Corner corner{ -1, -1, -1 };
+	corner.position = fixIndex(parseInt(*token, end), chunk.positions.size() / 3, ePosition);
+	*token = skipIndex(*token, end);
+	if (charAt(*token, end, 0) != '/')
+		return corner;
+	(*token)++;
+
+	//v//vn
+	if (charAt(*token, end, 0) == '/') {
+		(*token)++;
+		corner.normal = fixIndex(parseInt(*token, end), chunk.normals.size() / 3, eNormal);
+		*token = skipIndex(*token, end);
+		return corner;
+	}
+
+	//v/vt/vn or v/vt
+	corner.texcoord = fixIndex(parseInt(*token, end), chunk.texcoords.size() / 2, eTexcoord);
+	*token = skipIndex(*token, end);
+	if (charAt(*token, end, 0) != '/')
+		return corner;
+
+	(*token)++;
+	corner.normal = fixIndex(parseInt(*token, end), chunk.normals.size() / 3, eNormal);
+	*token = skipIndex(*token, end);
+	return corner;
+}
+
+/*
+ * Runs function(i) for every i below count, each on its own thread and the first one on the calling thread
+ */
+template<typename F>
+void RayTracing::ObjImporter::parallelFor(size_t count, F function) {
+	std::vector<std::thread> workers;
+	workers.reserve(count);
+	for (size_t i = 1; i < count; i++)
+		workers.emplace_back(function, i);
+
+	if (count > 0)
+		function(0);
+
+	for (auto& worker : workers)
+		worker.join();
+}
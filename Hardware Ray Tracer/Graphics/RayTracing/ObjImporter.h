@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Scene.h"
+#include "../MappedFile.h"
+#include <thread>
+
+#define OBJ_MIN_CHUNK_SIZE (4ULL * 1024ULL * 1024ULL) //smallest part of a file handed to one parser thread
+
+namespace RayTracing {
+	/*
+	 * Parallel importer for Wavefront OBJ files. The file is memory mapped and split at line boundaries,
+	 * every thread parses its chunk into local position, normal, texcoord and face corner arrays.
+	 * A prefix scan over the attribute counts turns relative (negative) indices into absolute ones,
+	 * then the corners are expanded into deduplicated vertices in file order.
+	 * Numbers and indices are parsed like tinyobjloader and faces are triangulated as fans,
+	 * so the output matches the previous tinyobj based import.
+	 */
+	class ObjImporter {
+	public:
+		ObjImporter(uint32_t threadCount = std::thread::hardware_concurrency());
+
+		void load(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	private:
+		struct Corner {
+			int32_t position;
+			int32_t texcoord;
+			int32_t normal;
+		};
+
+		enum RelativeIndex : uint8_t {
+			ePosition = 1,
+			eTexcoord = 2,
+			eNormal = 4
+		};
+
+		struct Chunk {
+			const char* begin;
+			const char* end;
+
+			std::vector<float> positions;
+			std::vector<float> normals;
+			std::vector<float> texcoords;
+			std::vector<Corner> corners; //three per triangle
+			std::vector<std::pair<uint32_t, uint8_t>> relativeCorners; //corners holding chunk local indices, with a RelativeIndex mask
+
+			size_t positionBase = 0;
+			size_t normalBase = 0;
+			size_t texcoordBase = 0;
+		};
+
+		static void parseChunk(Chunk& chunk);
+		static void parseLine(Chunk& chunk, const char* token, const char* end);
+		static Corner parseCorner(Chunk& chunk, const char** token, const char* end, uint8_t& relative);
+
+		template<typename F>
+		void parallelFor(size_t count, F function);
+	private:
+		uint32_t threadCount;
+	};
+}
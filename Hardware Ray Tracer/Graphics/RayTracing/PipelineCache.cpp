@@ -0,0 +1,120 @@
+#include "PipelineCache.h"
+#include "../Hash.h"
+#include "Debugging.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+RayTracing::PipelineCache::PipelineCache(Core::Device& device, const std::string& path, uint64_t shaderHash) : device(device), path(path), shaderHash(shaderHash) {
+	std::vector<uint8_t> data;
+	warm = read(data);
+	if (warm)
+		loadedHash = Core::fnv1a(data.data(), data.size());
+
+	VkPipelineCacheCreateInfo cacheInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = warm ? data.size() : 0,
+		.pInitialData = warm ? data.data() : nullptr
+	};
+
+	VK_CHECK_RESULT(vkCreatePipelineCache(device.getDevice(), &cacheInfo, nullptr, &cache), "failed to create pipeline cache!");
+}
+RayTracing::PipelineCache::~PipelineCache() {
+	vkDestroyPipelineCache(device.getDevice(), cache, nullptr);
+}
+
+/*
+ * Writes the cache with everything the driver merged into it since it was loaded, nothing is written if it did not change
+ */
+bool RayTracing::PipelineCache::save() {
+	size_t size = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device.getDevice(), cache, &size, nullptr), "failed to query pipeline cache size!");
+
+	std::vector<uint8_t> data(size);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device.getDevice(), cache, &size, data.data()), "failed to read pipeline cache!");
+	data.resize(size);
+
+	uint64_t dataHash = Core::fnv1a(data.data(), data.size());
+	if (warm && dataHash == loadedHash)
+		return true;
+
+	PipelineCacheHeader header{
+		.magic = PIPELINE_CACHE_MAGIC,
+		.version = PIPELINE_CACHE_VERSION,
+		.vendorID = device.properties.vendorID,
+		.deviceID = device.properties.deviceID,
+		.driverVersion = device.properties.driverVersion,
+		.shaderHash = shaderHash,
+		.dataSize = data.size(),
+		.dataHash = dataHash
+	};
+	memcpy(header.pipelineCacheUUID, device.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(PipelineCacheHeader));
+		out.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+		if (!out) return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	loadedHash = dataHash;
+	return true;
+}
+
+bool RayTracing::PipelineCache::read(std::vector<uint8_t>& data) {
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if (!in) return false;
+
+	size_t fileSize = static_cast<size_t>(in.tellg());
+	if (fileSize < sizeof(PipelineCacheHeader)) return false;
+
+	PipelineCacheHeader header{};
+	in.seekg(0);
+	in.read(reinterpret_cast<char*>(&header), sizeof(PipelineCacheHeader));
+	if (!in || header.dataSize != fileSize - sizeof(PipelineCacheHeader)) return false;
+
+	data.resize(header.dataSize);
+	in.read(reinterpret_cast<char*>(data.data()), data.size());
+	if (!in) return false;
+
+	if (!validate(header, data)) {
+		DEBUG("[INFO] Pipeline Cache: " << path << " is outdated, the pipeline is compiled from scratch");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Checks our header against the current GPU, driver and shader, and the header the driver put in front of its own data
+ */
+bool RayTracing::PipelineCache::validate(const PipelineCacheHeader& header, const std::vector<uint8_t>& data) {
+	const VkPhysicalDeviceProperties& properties = device.properties;
+
+	if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_VERSION) return false;
+	if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID || header.driverVersion != properties.driverVersion) return false;
+	if (memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+	if (header.shaderHash != shaderHash) return false;
+	if (header.dataHash != Core::fnv1a(data.data(), data.size())) return false;
+
+	VkPipelineCacheHeaderVersionOne driverHeader{};
+	if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) return false;
+	memcpy(&driverHeader, data.data(), sizeof(VkPipelineCacheHeaderVersionOne));
+
+	return driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		driverHeader.vendorID == properties.vendorID &&
+		driverHeader.deviceID == properties.deviceID &&
+		memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
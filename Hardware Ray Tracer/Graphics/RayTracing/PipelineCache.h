@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../vulkan_core/Device.h"
+#include <string>
+#include <vector>
+
+#define PIPELINE_CACHE_MAGIC 0x48435050U //"PPCH"
+#define PIPELINE_CACHE_VERSION 1U
+
+namespace RayTracing {
+	struct PipelineCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint32_t reserved;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+
+		uint64_t shaderHash; //FNV-1a hash of the SPIR-V the pipeline was created from
+		uint64_t dataSize;
+		uint64_t dataHash; //FNV-1a hash of the driver blob that follows the header
+	};
+
+	/*
+	 * VkPipelineCache that persists between launches. The blob on disk is only handed to the driver
+	 * if the GPU, the driver and the SPIR-V still match the header, otherwise the pipeline is compiled cold.
+	 * save() writes the merged cache back through a temporary file.
+	 */
+	class PipelineCache {
+	public:
+		PipelineCache(Core::Device& device, const std::string& path, uint64_t shaderHash);
+		~PipelineCache();
+
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache operator=(const PipelineCache&) = delete;
+
+		bool save();
+
+		inline VkPipelineCache getCache() { return cache; }
+		inline bool isWarm() { return warm; }
+	private:
+		bool read(std::vector<uint8_t>& data);
+		bool validate(const PipelineCacheHeader& header, const std::vector<uint8_t>& data);
+	private:
+		Core::Device& device;
+		std::string path;
+		uint64_t shaderHash;
+
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		bool warm = false;
+		uint64_t loadedHash = 0;
+	};
+}
@@ -1,54 +1,253 @@
 #include "RTApp.h"
+#include "SceneFile.h"
+#include "../ImageWriter.h"
+#include "../CameraPath.h"
+#include "../Benchmarks/BenchmarkReport.h"
+
+#include <algorithm>
+
+/*
+ * Parses --headless, --width <w>, --height <h>, --frames <n>, --camera <px py pz rx ry rz>, --output <path>, --scene <path>, --profile <path.csv>,
+ * the ray count options --ray-stats and --heatmap <path>, the accumulation options --accumulate, --denoise, --upscale <0.5-1>, --jitter, --exposure <scale> and --tonemap,
+ * the dynamic resolution options --dynamic-resolution, --target-ms <ms>, --min-scale <0.5-1> and --resolution-log <path.csv>,
+ * the path options --max-depth <n>, --rr-depth <n>, --light-samples <n>, --light-sampler <uniform,power,bvh>, --sampler <pcg,sobol> and --time-budget <ms>,
+ * the benchmark options --benchmark <camera path>, --warmup <n>, --timestep <seconds> and --report <path.json|.csv>
+ * and the generator options --generate <sphere,grid,terrain>, --triangles <n>, --instances <n>, --materials <n>, --emissive <n>, --lights <n> and --seed <n>.
+ * Unknown arguments are left for the benchmark switches in main.
+ */
+RayTracing::RenderSettings RayTracing::RenderSettings::fromArguments(int argc, char** argv) {
+	RenderSettings settings;
+	bool frameCountGiven = false;
+
+	auto value = [&](int& i, const std::string& name) -> std::string {
+		if (i + 1 >= argc)
+			throw std::runtime_error("missing value for " + name);
+		return argv[++i];
+	};
 
-RayTracing::RTApp::RTApp() : window({800, 600, "Bloon RT Engine v0.1.2 | DLSS 4", false}), device(&window), scene(device) {
-	scene.loadModel("models/Plane.obj");
-
-	scene.createMaterial(glm::vec3(1.f, 1.f, 1.f), 1.0f);
-	scene.createMaterial(glm::vec3(1.f, 1.f, 1.f), 1.0f, 0.0f);
-	
-	scene.createLight(glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.0f, 0.0f, 1.0f), 2.0f);
-	scene.createLight(glm::vec3(-1.f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 2.0f);
-	scene.createLight(glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f), 2.0f);
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+
+		if (argument == "--headless")
+			settings.headless = true;
+		else if (argument == "--width")
+			settings.width = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--height")
+			settings.height = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--frames") {
+			settings.frameCount = static_cast<uint32_t>(std::stoul(value(i, argument)));
+			frameCountGiven = true;
+		}
+		else if (argument == "--output")
+			settings.outputPath = value(i, argument);
+		else if (argument == "--scene")
+			settings.scenePath = value(i, argument);
+		else if (argument == "--profile")
+			settings.profilePath = value(i, argument);
+		else if (argument == "--accumulate")
+			settings.accumulate = true;
+		else if (argument == "--denoise")
+			settings.denoise = true;
+		else if (argument == "--upscale") {
+			settings.upscale = true;
+			settings.renderScale = std::stof(value(i, argument));
+		}
+		else if (argument == "--dynamic-resolution")
+			settings.dynamicResolution = true;
+		else if (argument == "--target-ms")
+			settings.targetFrameMs = std::stof(value(i, argument));
+		else if (argument == "--min-scale")
+			settings.minRenderScale = std::stof(value(i, argument));
+		else if (argument == "--resolution-log")
+			settings.resolutionLogPath = value(i, argument);
+		else if (argument == "--exposure")
+			settings.exposure = std::stof(value(i, argument));
+		else if (argument == "--tonemap")
+			settings.tonemap = true;
+		else if (argument == "--jitter")
+			settings.jitter = true;
+		else if (argument == "--max-depth")
+			settings.maxDepth = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--rr-depth")
+			settings.rouletteDepth = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--light-samples")
+			settings.lightSamples = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--light-sampler") {
+			std::string sampler = value(i, argument);
+			if (sampler == "uniform") settings.lightSampler = eLightSamplerUniform;
+			else if (sampler == "power") settings.lightSampler = eLightSamplerPower;
+			else if (sampler == "bvh") settings.lightSampler = eLightSamplerBVH;
+			else throw std::runtime_error("unknown light sampler: " + sampler);
+		}
+		else if (argument == "--sampler") {
+			std::string sampler = value(i, argument);
+			if (sampler == "pcg") settings.sampler = eSamplerPCG;
+			else if (sampler == "sobol") settings.sampler = eSamplerSobol;
+			else throw std::runtime_error("unknown sampler: " + sampler);
+		}
+		else if (argument == "--time-budget")
+			settings.timeBudget = std::stof(value(i, argument));
+		else if (argument == "--ray-stats")
+			settings.rayStats = true;
+		else if (argument == "--heatmap") {
+			settings.rayStats = true;
+			settings.heatmapPath = value(i, argument);
+		}
+		else if (argument == "--benchmark") {
+			settings.benchmark = true;
+			settings.cameraPath = value(i, argument);
+		}
+		else if (argument == "--warmup")
+			settings.warmupFrames = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--timestep")
+			settings.timestep = std::stof(value(i, argument));
+		else if (argument == "--report")
+			settings.reportPath = value(i, argument);
+		else if (argument == "--generate") {
+			settings.generateScene = true;
+			settings.generator.shapes = SceneGenerator::parseShapes(value(i, argument));
+		}
+		else if (argument == "--triangles")
+			settings.generator.triangleCount = std::stoull(value(i, argument));
+		else if (argument == "--instances")
+			settings.generator.instanceCount = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--materials")
+			settings.generator.materialCount = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--emissive")
+			settings.generator.emissiveMaterialCount = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--lights")
+			settings.generator.lightCount = static_cast<uint32_t>(std::stoul(value(i, argument)));
+		else if (argument == "--seed")
+			settings.generator.seed = std::stoull(value(i, argument), nullptr, 0);
+		else if (argument == "--camera") {
+			for (int c = 0; c < 3; c++)
+				settings.cameraPosition[c] = std::stof(value(i, argument));
+			for (int c = 0; c < 3; c++)
+				settings.cameraRotation[c] = std::stof(value(i, argument));
+		}
+	}
 
-	scene.createInstance(0, 1, glm::vec3(0.f, -1.f, 0.f), glm::vec3(), glm::vec3(1.0f, 1.0f, 1.0f));
-	scene.createInstance(0, 0, glm::vec3(0.f, 1.f, 0.f), glm::vec3(), glm::vec3(4.0f, 1.0f, 4.0f));
+	if (settings.benchmark && !frameCountGiven)
+		settings.frameCount = BENCHMARK_DEFAULT_FRAMES;
+	//a resolution below the output needs the upscaler to fill in the display image
+	if (settings.dynamicResolution)
+		settings.upscale = true;
+	//the denoiser and upscaler accumulate over time themselves and need the samples of every frame on their own
+	if (settings.denoise || settings.upscale)
+		settings.accumulate = false;
+
+	if (settings.width == 0 || settings.height == 0 || settings.frameCount == 0)
+		throw std::runtime_error("resolution and frame count have to be greater than zero!");
+	if (settings.maxDepth == 0 || settings.maxDepth > PATH_MAX_DEPTH)
+		throw std::runtime_error("max depth has to be between 1 and " + std::to_string(PATH_MAX_DEPTH));
+	if (settings.lightSamples == 0)
+		throw std::runtime_error("light samples have to be greater than zero!");
+	if (settings.renderScale < UPSCALE_MIN_SCALE || settings.renderScale > UPSCALE_MAX_SCALE)
+		throw std::runtime_error("upscale has to be between " + std::to_string(UPSCALE_MIN_SCALE) + " and " + std::to_string(UPSCALE_MAX_SCALE));
+	if (settings.minRenderScale < UPSCALE_MIN_SCALE || settings.minRenderScale > settings.renderScale)
+		throw std::runtime_error("min scale has to be between " + std::to_string(UPSCALE_MIN_SCALE) + " and the upscale");
+	if (settings.targetFrameMs <= 0.f)
+		throw std::runtime_error("target ms has to be greater than zero!");
+
+	return settings;
+}
 
+RayTracing::RTApp::RTApp(const RenderSettings& settings) 
+	: settings(settings),
+	window(settings.headless ? nullptr : std::make_unique<Core::Window>(static_cast<int>(settings.width), static_cast<int>(settings.height), WINDOW_TITLE, false)),
+	device(window.get()),
+	scene(device) {
+	if (settings.generateScene)
+		SceneGenerator::generate(settings.generator, scene);
+	else
+		SceneFile::load(settings.scenePath, scene);
 	scene.build();
 
-	recreateSwapChain();
-	rtPipeline = Pipeline::createPipeline(device, swapChain, scene);
+	if (settings.headless) {
+		//render straight into a float storage image at the requested resolution
+		rtPipeline = std::make_unique<Pipeline>(device, VK_FORMAT_R32G32B32A32_SFLOAT, VkExtent2D{ settings.width, settings.height }, scene.getTlas(), scene.getSceneInfoBuffer(), settings.rayStats);
+		createFrameFences();
+
+		readbackBuffer = std::make_unique<Core::Buffer>(
+			device,
+			static_cast<VkDeviceSize>(settings.width) * settings.height * 4 * sizeof(float),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+		);
+		VK_CHECK_RESULT(readbackBuffer->map(), "failed to map readback buffer!");
+	}
+	else {
+		recreateSwapChain();
+		rtPipeline = Pipeline::createPipeline(device, swapChain, scene, settings.rayStats);
+	}
+	rtPipeline->enableDenoiser(settings.denoise);
+	rtPipeline->enableUpscaler(settings.upscale, settings.renderScale);
 	
 	BUILD("Command Buffer Build", 0, 1, "Creating command buffers...");
 	createCommandBuffers();
 	BUILD("Command Buffer Build", 1, 1, "Command buffers created!");
 
-	camera.setView(glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3());
+	profiler = std::make_unique<Core::GpuProfiler>(device);
+	if (!settings.profilePath.empty() && !profiler->openCSV(settings.profilePath))
+		throw std::runtime_error("failed to open " + settings.profilePath);
+
+	if (settings.dynamicResolution) {
+		resolutionController = std::make_unique<Extensions::ResolutionController>(settings.targetFrameMs, settings.minRenderScale, settings.renderScale);
+		if (!settings.resolutionLogPath.empty() && !resolutionController->openCSV(settings.resolutionLogPath))
+			throw std::runtime_error("failed to open " + settings.resolutionLogPath);
+	}
+
+	camera.setView(settings.cameraPosition, settings.cameraRotation);
+}
+RayTracing::RTApp::~RTApp() {
+	vkDeviceWaitIdle(device.getDevice());
+
+	for (VkFence fence : frameFences)
+		vkDestroyFence(device.getDevice(), fence, nullptr);
 }
-RayTracing::RTApp::~RTApp() {}
 
 void RayTracing::RTApp::run() {
+	if (settings.benchmark) {
+		benchmark();
+		return;
+	}
+
+	if (settings.headless) {
+		renderHeadless();
+		return;
+	}
+
 	auto currentTime = std::chrono::high_resolution_clock::now();
+	float titleTimer = 0.f;
 
-	while (!window.shouldClose()) {
+	while (!window->shouldClose()) {
 		glfwPollEvents();
 
 		auto newTime = std::chrono::high_resolution_clock::now();
 		float delta = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 		currentTime = newTime;
 
-		camera.handleInputs(window.getGLFWWindow(), delta);
-		float aspectRatio = swapChain->extentAspectRatio();
-		camera.setPerspectiveProjection(glm::radians(60.f), aspectRatio, 0.001f, 100000.f);
-
-		//update uniform buffer
-		Uniform uniform{
-			.viewInverse = glm::inverse(glm::transpose(camera.getView())),
-			.projInverse = glm::inverse(glm::transpose(camera.getProjection())),
-			.frame = imageIndex,
-			.depthMax = 2
-		};
-
-		rtPipeline->writeToUniformBuffer(&uniform, frameIndex);
+		titleTimer += delta;
+		if (titleTimer >= PROFILER_TITLE_INTERVAL) {
+			std::string title = std::string(WINDOW_TITLE) + " | " + profiler->summary();
+			if (rtPipeline->hasRayStats())
+				title += " | " + rtPipeline->raySummary(profiler->getAverage("Trace Rays"));
+			title += " | depth " + std::to_string(settings.maxDepth) + ", RR " + std::to_string(settings.rouletteDepth);
+			if (settings.accumulate)
+				title += " | " + std::to_string(rtPipeline->getSampleCount()) + " spp";
+			if (settings.denoise)
+				title += " | SVGF";
+			if (settings.upscale)
+				title += " | " + std::to_string(rtPipeline->getRenderExtent().width) + "x" + std::to_string(rtPipeline->getRenderExtent().height) + " upscaled";
+			if (resolutionController)
+				title += " | " + resolutionController->summary();
+			window->setWindowTitle(title);
+			titleTimer = 0.f;
+		}
+
+		camera.handleInputs(window->getGLFWWindow(), delta);
+		handlePathKeys();
+		writeUniform(static_cast<uint32_t>(frameNumber));
 
 		//render scene
 		rayTraceScene();
@@ -56,6 +255,420 @@ void RayTracing::RTApp::run() {
 	}
 
 	vkDeviceWaitIdle(device.getDevice());
+	profiler->resolveAll();
+	profiler->printHistogram();
+	rtPipeline->resolveRayStats();
+	if (resolutionController)
+		DEBUG("[INFO] Dynamic Resolution: " << resolutionController->summary());
+}
+
+/*
+ * Plays back the camera path with a fixed timestep, so every run renders the same frames no matter how fast they are.
+ * After the warm up frames every frame adds its CPU frame interval and, a few frames later, its GPU pass times to the report.
+ * Windowed runs present with the swapchain's present mode and can be capped by vsync, headless runs are not.
+ */
+void RayTracing::RTApp::benchmark() {
+	Core::CameraPath path(settings.cameraPath);
+
+	Benchmarks::RenderReport report;
+	report.scene = settings.generateScene ? SceneGenerator::describe(settings.generator) : settings.scenePath;
+	report.cameraPath = settings.cameraPath;
+	report.device = device.properties.deviceName;
+	report.warmupFrames = settings.warmupFrames;
+	report.measuredFrames = settings.frameCount;
+	report.timestep = settings.timestep;
+
+	VkExtent2D extent = settings.headless ? VkExtent2D{ settings.width, settings.height } : swapChain->getSwapChainExtent();
+	report.width = extent.width;
+	report.height = extent.height;
+	report.raysPerFrame = static_cast<uint64_t>(rtPipeline->getRenderExtent().width) * rtPipeline->getRenderExtent().height * SHADER_SAMPLES;
+
+	const SceneBuildTimings& timings = scene.getBuildTimings();
+	report.addBuildTime("BLAS", timings.bottomAS);
+	report.addBuildTime("TLAS", timings.topAS);
+	report.addBuildTime("materials", timings.materials);
+	report.addBuildTime("lights", timings.lights);
+	report.addBuildTime("light BVH", timings.lightBVH);
+	report.addBuildTime("emitters", timings.emitters);
+	report.addBuildTime("sky", timings.sky);
+	report.addBuildTime("scene information", timings.sceneInformation);
+	report.addBuildTime("upload", timings.upload);
+	report.addBuildTime("pipeline", rtPipeline->getPipelineCreationTime());
+	report.addBuildTime("SBT", rtPipeline->getSBTCreationTime());
+
+	uint64_t firstMeasured = frameNumber + settings.warmupFrames;
+	auto collectGpuFrames = [&]() {
+		for (const auto& timing : profiler->takeResults())
+			if (timing.frame >= firstMeasured)
+				report.addGpuFrame(timing);
+
+		for (const RayStatistics& statistics : rtPipeline->takeRayStats())
+			if (statistics.frame >= firstMeasured)
+				for (uint32_t type = 0; type < eRayTypeCount; type++)
+					report.addRayCount(statistics.frame, RayStatistics::typeName(type), statistics.rays[type]);
+	};
+
+	uint32_t totalFrames = settings.warmupFrames + settings.frameCount;
+	auto previous = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t i = 0; i < totalFrames; i++) {
+		if (!settings.headless) {
+			glfwPollEvents();
+			if (window->shouldClose()) break;
+		}
+
+		glm::vec3 position, rotation;
+		path.sample(i * settings.timestep, position, rotation);
+		camera.setView(position, rotation);
+
+		uint64_t frame = frameNumber;
+		if (settings.headless)
+			renderHeadlessFrame(false);
+		else {
+			writeUniform(static_cast<uint32_t>(frame));
+			rayTraceScene();
+		}
+
+		auto now = std::chrono::high_resolution_clock::now();
+		if (i >= settings.warmupFrames)
+			report.addCpuFrame(frame, std::chrono::duration<double, std::chrono::milliseconds::period>(now - previous).count());
+		previous = now;
+
+		collectGpuFrames();
+	}
+
+	vkDeviceWaitIdle(device.getDevice());
+	profiler->resolveAll();
+	rtPipeline->resolveRayStats();
+	collectGpuFrames();
+
+	report.print();
+	profiler->printHistogram();
+	if (resolutionController)
+		DEBUG("[INFO] Dynamic Resolution: " << resolutionController->summary());
+	if (!report.write(settings.reportPath))
+		throw std::runtime_error("failed to write " + settings.reportPath);
+
+	DEBUG("[INFO] Benchmark: wrote " << settings.reportPath);
+}
+
+/*
+ * Records frames full of trace and device address calls without submitting them. The frames are recorded once through
+ * the dispatch table and once with the vkGetDeviceProcAddr lookup every extension call used to do.
+ */
+void RayTracing::RTApp::benchmarkDispatch(uint32_t frames, uint32_t commandsPerFrame) {
+	vkDeviceWaitIdle(device.getDevice());
+
+	VkCommandBuffer buffer = commandBuffers[0];
+	VkBuffer sceneInfoBuffer = scene.getSceneInfoBuffer()->getBuffer();
+	uint64_t lookups = 0;
+	VkDeviceAddress addressSum = 0;
+
+	auto recordFrames = [&](bool lookup) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			VK_CHECK_RESULT(vkResetCommandBuffer(buffer, 0), "failed to reset command buffer!");
+
+			VkCommandBufferBeginInfo beginInfo{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+			};
+			VK_CHECK_RESULT(vkBeginCommandBuffer(buffer, &beginInfo), "failed to begin command buffer!");
+
+			rtPipeline->bind(buffer);
+			rtPipeline->bindDescriptorSets(buffer, 0);
+
+			for (uint32_t i = 0; i < commandsPerFrame; i++) {
+				if (lookup) lookups += vkGetDeviceProcAddr(device.getDevice(), "vkCmdTraceRaysKHR") != nullptr;
+				rtPipeline->traceRays(buffer, 1, 1, 1);
+
+				if (lookup) lookups += vkGetDeviceProcAddr(device.getDevice(), "vkGetBufferDeviceAddressKHR") != nullptr;
+				addressSum += device.getBufferDeviceAddress(sceneInfoBuffer);
+			}
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(buffer), "failed to record buffer!");
+		}
+
+		return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+	};
+
+	recordFrames(false); //warm up
+	float lookupTime = recordFrames(true);
+	float tableTime = recordFrames(false);
+
+	VK_CHECK_RESULT(vkResetCommandBuffer(buffer, 0), "failed to reset command buffer!");
+
+	BENCHMARK("Dispatch Table", frames << " frames with " << commandsPerFrame << " trace rays and device address calls each (" << lookups << " lookups, checksum " << addressSum << ")");
+	BENCHMARK("Dispatch Table", "per call lookup: " << lookupTime << " ms/frame, dispatch table: " << tableTime << " ms/frame, saved " << lookupTime - tableTime << " ms/frame");
+}
+
+/*
+ * Renders the requested number of frames without presenting them. Only the last frame is copied
+ * into the readback buffer and written to disk. With a time budget the first frame that starts after
+ * the budget is used up is the last one.
+ */
+void RayTracing::RTApp::renderHeadless() {
+	auto start = std::chrono::high_resolution_clock::now();
+	auto elapsed = [&]() { return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count(); };
+
+	uint32_t frameCount = 0;
+	for (bool last = false; !last; frameCount++) {
+		last = settings.timeBudget > 0.f ? elapsed() >= settings.timeBudget : frameCount + 1 == settings.frameCount;
+		renderHeadlessFrame(last);
+	}
+
+	vkDeviceWaitIdle(device.getDevice());
+	float renderTime = elapsed();
+	DEBUG("[INFO] Headless: rendered " << frameCount << " frames at " << settings.width << "x" << settings.height << " in " << renderTime << " ms (" << renderTime / frameCount << " ms/frame)");
+	if (settings.accumulate)
+		DEBUG("[INFO] Headless: accumulated " << rtPipeline->getSampleCount() << " spp");
+
+	profiler->resolveAll();
+	DEBUG("[INFO] Headless: " << profiler->summary());
+	profiler->printHistogram();
+	if (resolutionController)
+		DEBUG("[INFO] Dynamic Resolution: " << resolutionController->summary());
+
+	if (rtPipeline->hasRayStats()) {
+		rtPipeline->resolveRayStats();
+		const RayStatistics& statistics = rtPipeline->getLastRayStats();
+		DEBUG("[INFO] Ray Stats: " << statistics.total() << " rays in the last frame, " << rtPipeline->raySummary(profiler->getAverage("Trace Rays")));
+
+		for (uint32_t depth = 0; depth < RAY_STATS_DEPTHS; depth++)
+			if (statistics.depths[depth] > 0)
+				DEBUG("[INFO] Ray Stats: depth " << depth << (depth + 1 == RAY_STATS_DEPTHS ? "+" : "") << ": " << statistics.depths[depth] << " rays");
+
+		if (!settings.heatmapPath.empty()) {
+			if (!rtPipeline->writeRayHeatmap(settings.heatmapPath))
+				throw std::runtime_error("failed to write " + settings.heatmapPath);
+			DEBUG("[INFO] Headless: wrote " << settings.heatmapPath);
+		}
+	}
+
+	VK_CHECK_RESULT(readbackBuffer->invalidate(), "failed to invalidate readback buffer!");
+	if (!Core::ImageWriter::write(settings.outputPath, settings.width, settings.height, static_cast<const float*>(readbackBuffer->getMappedMemory())))
+		throw std::runtime_error("failed to write " + settings.outputPath);
+
+	DEBUG("[INFO] Headless: wrote " << settings.outputPath);
+}
+
+/*
+ * Records and submits one frame, frames in flight are throttled with our own fences instead of the swapchain's
+ */
+void RayTracing::RTApp::renderHeadlessFrame(bool readback) {
+	VK_CHECK_RESULT(vkWaitForFences(device.getDevice(), 1, &frameFences[frameIndex], VK_TRUE, UINT64_MAX), "failed to wait for frame fence!");
+	VK_CHECK_RESULT(vkResetFences(device.getDevice(), 1, &frameFences[frameIndex]), "failed to reset frame fence!");
+
+	writeUniform(static_cast<uint32_t>(frameNumber));
+
+	VkCommandBuffer buffer = commandBuffers[frameIndex];
+	VkCommandBufferBeginInfo beginInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+	VK_CHECK_RESULT(vkBeginCommandBuffer(buffer, &beginInfo), "failed to begin command buffer!");
+
+	profiler->beginFrame(buffer, frameIndex, frameNumber);
+	recordTraceRays(buffer, readback && !settings.heatmapPath.empty());
+
+	if (readback) {
+		profiler->beginScope(buffer, "Readback");
+		copyRenderOutputToBuffer(buffer);
+		profiler->endScope(buffer);
+	}
+
+	profiler->endFrame(buffer);
+	VK_CHECK_RESULT(vkEndCommandBuffer(buffer), "failed to record buffer!");
+
+	VkSubmitInfo submitInfo{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &buffer
+	};
+	VK_CHECK_RESULT(vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, frameFences[frameIndex]), "failed to submit headless frame!");
+
+	frameIndex = (frameIndex + 1) % Core::SwapChain::MAX_FRAMES_IN_FLIGHT;
+	frameNumber++;
+}
+
+/*
+ * Updates the projection for the current output size and writes the camera into the uniform buffer of this frame index.
+ * The accumulated samples are dropped when the camera or the scene changed, or every frame without --accumulate.
+ */
+void RayTracing::RTApp::writeUniform(uint32_t frame) {
+	float aspectRatio = settings.headless ? static_cast<float>(settings.width) / static_cast<float>(settings.height) : swapChain->extentAspectRatio();
+	camera.setPerspectiveProjection(glm::radians(60.f), aspectRatio, 0.001f, 100000.f);
+
+	updateRenderScale();
+
+	//the upscaler has to know where the samples are, every pixel takes the same Halton offset
+	jitter = rtPipeline->hasUpscaler() ? Extensions::upscaleJitter(frame, rtPipeline->getRenderScale()) : glm::vec2(0.f);
+
+	Uniform uniform{
+		.viewInverse = glm::inverse(glm::transpose(camera.getView())),
+		.projInverse = glm::inverse(glm::transpose(camera.getProjection())),
+		.frame = frame,
+		.depthMax = settings.maxDepth,
+		.rouletteDepth = settings.rouletteDepth,
+		.lightSamples = settings.lightSamples,
+		.lightSampler = settings.lightSampler,
+		.samplerType = settings.sampler,
+		.writeGBuffer = rtPipeline->getGBufferWrites(),
+		.jitter = jitter,
+		.jitterMode = rtPipeline->hasUpscaler() ? eJitterFixed : settings.jitter ? eJitterRandom : eJitterNone
+	};
+
+	//the first frame has no previous camera, its motion vectors are zero
+	bool firstFrame = previousViewInverse == glm::mat4(0.f);
+	uniform.previousViewInverse = firstFrame ? uniform.viewInverse : previousViewInverse;
+	uniform.previousProjInverse = firstFrame ? uniform.projInverse : previousProjInverse;
+	previousViewInverse = uniform.viewInverse;
+	previousProjInverse = uniform.projInverse;
+
+	glm::uvec2 depths(settings.maxDepth, settings.rouletteDepth);
+	if (!settings.accumulate || uniform.viewInverse != accumulatedView || uniform.projInverse != accumulatedProjection || scene.getRevision() != accumulatedRevision || depths != accumulatedDepths) {
+		rtPipeline->resetAccumulation();
+		accumulatedView = uniform.viewInverse;
+		accumulatedProjection = uniform.projInverse;
+		accumulatedRevision = scene.getRevision();
+		accumulatedDepths = depths;
+	}
+	uniform.sampleIndex = rtPipeline->getSampleCount();
+	//an accumulated image continues its sequence, otherwise every frame takes the next samples of each pixel
+	uniform.sequenceIndex = settings.accumulate ? uniform.sampleIndex : frame;
+
+	//the denoiser reprojects from this frame's view space into last frame's clip space
+	glm::mat4 view = camera.getView();
+	glm::mat4 projection = camera.getProjection();
+	reprojection = previousViewProjection * glm::inverse(view);
+	previousViewProjection = projection * view;
+	viewScale = glm::vec2(1.f / projection[0][0], 1.f / projection[1][1]);
+
+	rtPipeline->writeToUniformBuffer(&uniform, frameIndex);
+}
+
+/*
+ * Gives the newest GPU frame the profiler read back to the resolution controller. A new scale only moves the traced
+ * area inside the allocated images, the frames still in flight keep the one they were recorded with.
+ */
+void RayTracing::RTApp::updateRenderScale() {
+	if (!resolutionController)
+		return;
+
+	const Core::GpuProfiler::FrameTiming& timing = profiler->getLastFrame();
+	auto trace = std::find_if(timing.scopes.begin(), timing.scopes.end(), [](const auto& scope) { return scope.name == "Trace Rays"; });
+	if (trace == timing.scopes.end())
+		return;
+
+	if (resolutionController->update(frameNumber, timing.frame, timing.milliseconds, trace->milliseconds))
+		rtPipeline->setRenderScale(resolutionController->getScale());
+}
+
+/*
+ * [ and ] change the maximum path depth, - and = the depth russian roulette starts at
+ */
+void RayTracing::RTApp::handlePathKeys() {
+	const std::array<int, 4> keys = { GLFW_KEY_LEFT_BRACKET, GLFW_KEY_RIGHT_BRACKET, GLFW_KEY_MINUS, GLFW_KEY_EQUAL };
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		bool down = glfwGetKey(window->getGLFWWindow(), keys[i]) == GLFW_PRESS;
+		bool pressed = down && !pathKeysDown[i];
+		pathKeysDown[i] = down;
+		if (!pressed) continue;
+
+		uint32_t& depth = i < 2 ? settings.maxDepth : settings.rouletteDepth;
+		uint32_t minimum = i < 2 ? 1U : 0U;
+		if (i % 2 == 0 && depth > minimum) depth--;
+		else if (i % 2 == 1 && depth < PATH_MAX_DEPTH) depth++;
+
+		DEBUG("[INFO] Path: max depth " << settings.maxDepth << ", russian roulette after " << settings.rouletteDepth << " bounces");
+	}
+}
+
+void RayTracing::RTApp::recordTraceRays(VkCommandBuffer buffer, bool heatmap) {
+	profiler->beginScope(buffer, "AS Update");
+	if (scene.updateTopAS(buffer, frameIndex))
+		rtPipeline->updateTopLevelAS(scene.getTlas());
+	profiler->endScope(buffer);
+
+	rtPipeline->bind(buffer);
+	rtPipeline->beginAccumulation(buffer);
+	rtPipeline->bindDescriptorSets(buffer, frameIndex);
+	rtPipeline->beginRayStats(buffer, frameIndex, frameNumber);
+
+	profiler->beginScope(buffer, "Trace Rays");
+	VkExtent2D extent = rtPipeline->getRenderExtent();
+	rtPipeline->traceRays(buffer, extent.width, extent.height, 1);
+	profiler->endScope(buffer);
+
+	rtPipeline->endRayStats(buffer, frameIndex, heatmap);
+
+	if (rtPipeline->hasDenoiser()) {
+		profiler->beginScope(buffer, "Denoise");
+		rtPipeline->denoise(buffer, reprojection, viewScale);
+		profiler->endScope(buffer);
+	}
+
+	if (rtPipeline->hasUpscaler()) {
+		profiler->beginScope(buffer, "Upscale");
+		rtPipeline->upscale(buffer, jitter);
+		profiler->endScope(buffer);
+	}
+
+	//headless output stays linear for the EXR writer
+	profiler->beginScope(buffer, "Resolve");
+	rtPipeline->resolve(buffer, settings.exposure, settings.tonemap && !settings.headless);
+	profiler->endScope(buffer);
+}
+
+void RayTracing::RTApp::copyRenderOutputToBuffer(VkCommandBuffer buffer) {
+	VkImage image = rtPipeline->getRenderOutput().image;
+
+	VkImageMemoryBarrier imageBarrier{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.image = image,
+		.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &imageBarrier);
+
+	VkBufferImageCopy region{
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.imageOffset = { 0, 0, 0 },
+		.imageExtent = { settings.width, settings.height, 1 }
+	};
+	vkCmdCopyImageToBuffer(buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer->getBuffer(), 1, &region);
+
+	VkBufferMemoryBarrier bufferBarrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = readbackBuffer->getBuffer(),
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, VK_NULL_HANDLE, 1, &bufferBarrier, 0, VK_NULL_HANDLE);
+}
+
+void RayTracing::RTApp::createFrameFences() {
+	frameFences.resize(Core::SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+	VkFenceCreateInfo fenceInfo{
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.flags = VK_FENCE_CREATE_SIGNALED_BIT
+	};
+
+	for (VkFence& fence : frameFences)
+		VK_CHECK_RESULT(vkCreateFence(device.getDevice(), &fenceInfo, nullptr, &fence), "failed to create frame fence!");
 }
 
 void RayTracing::RTApp::createCommandBuffers() {
@@ -70,34 +683,20 @@ void RayTracing::RTApp::createCommandBuffers() {
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, commandBuffers.data()), "failed to allocate command buffers");
 }
 
-void RayTracing::RTApp::prepareStorageImage(VkCommandBuffer buffer) {
-	VkImageMemoryBarrier barrier{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.srcAccessMask = 0,
-		.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-		.image = rtPipeline->getRenderOutput().image,
-		.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
-	};
-
-	vkCmdPipelineBarrier(buffer, 0, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
-}
-
 void RayTracing::RTApp::copyImageToSwapchain(VkCommandBuffer buffer, VkImage swapChainImage, VkExtent2D size) {
 	VkImageSubresourceRange ressourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 	
 	{
 		VkImageMemoryBarrier srcBarrier{
 			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
 			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
 			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 			.image = rtPipeline->getRenderOutput().image,
 			.subresourceRange = ressourceRange
 		};
-		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &srcBarrier);
+		vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &srcBarrier);
 	}
 	{
 		VkImageMemoryBarrier dstBarrier{
@@ -152,16 +751,14 @@ void RayTracing::RTApp::copyImageToSwapchain(VkCommandBuffer buffer, VkImage swa
 }
 void RayTracing::RTApp::rayTraceScene() {
 	if (auto buffer = beginFrame()) {
-		rtPipeline->bind(buffer);
-		prepareStorageImage(buffer);
-		rtPipeline->bindDescriptorSets(buffer, frameIndex);
-
-		VkExtent2D size = swapChain->getSwapChainExtent();
-		rtPipeline->traceRays(buffer, size.width, size.height, 1);
+		profiler->beginFrame(buffer, frameIndex, frameNumber);
+		recordTraceRays(buffer);
 
-		//DLSS Ray Reconstruction will denoise the image
-		//DLSS Super Resolution will upscale the image
+		//the display image is at the swapchain resolution, the upscaler has filled it in from the render resolution
+		profiler->beginScope(buffer, "Image Copy");
 		copyImageToSwapchain(buffer, swapChain->getImage(imageIndex), swapChain->getSwapChainExtent());
+		profiler->endScope(buffer);
+		profiler->endFrame(buffer);
 
 		endFrame();
 	}
@@ -198,8 +795,8 @@ void RayTracing::RTApp::endFrame() {
 	//submit command buffers
 	auto result = swapChain->submitCommandBuffers(&commandBuffer, &imageIndex);
 	//check results of the rendering and recreate the swap chain if the window has changed it's size
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized()) {
-		window.resetWindowResizeFlag();
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window->wasWindowResized()) {
+		window->resetWindowResizeFlag();
 		discardFrame = true;
 		recreateSwapChain();
 		rtPipeline->rebuildRenderOutput(swapChain->getSwapChainImageFormat(), swapChain->getSwapChainExtent());
@@ -209,20 +806,21 @@ void RayTracing::RTApp::endFrame() {
 	//reset frameStarted and updated frame index
 	frameStarted = false;
 	frameIndex = (frameIndex + 1) % Core::SwapChain::MAX_FRAMES_IN_FLIGHT;
+	frameNumber++;
 }
 
 void RayTracing::RTApp::recreateSwapChain() {
-	auto extent = window.getExtent();
+	auto extent = window->getExtent();
 
 	while (extent.width == 0 || extent.height == 0) {
-		extent = window.getExtent();
+		extent = window->getExtent();
 		glfwWaitEvents();
 	}
 
 	vkDeviceWaitIdle(device.getDevice());
 
 	if (swapChain == nullptr)
-		swapChain = std::make_unique<Core::SwapChain>(device, window.getExtent());
+		swapChain = std::make_unique<Core::SwapChain>(device, window->getExtent());
 	else {
 		std::shared_ptr<Core::SwapChain> oldSwapChain = std::move(swapChain);
 		swapChain = std::make_unique<Core::SwapChain>(device, extent, oldSwapChain);
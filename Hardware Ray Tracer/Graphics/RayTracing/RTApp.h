@@ -1,33 +1,106 @@
 #pragma once
 
 #include <chrono>
+#include <array>
 #include "../Window.h"
 #include "../Camera.h"
 #include "../vulkan_core/Device.h"
 #include "../vulkan_core/SwapChain.h"
+#include "../vulkan_core/GpuProfiler.h"
 
 #include "Scene.h"
+#include "SceneGenerator.h"
 #include "RTPipeline.h"
+#include "LightSampling.h"
+#include "../Upscaler/ResolutionController.h"
+
+#define WINDOW_TITLE "Bloon RT Engine v0.1.2 | DLSS 4"
+#define PROFILER_TITLE_INTERVAL 0.5f //seconds between window title updates with the GPU pass times
+#define SHADER_SAMPLES 1U //SAMPLES in shaders/constants.slang, primary rays per pixel and frame
+#define BENCHMARK_DEFAULT_FRAMES 512U //measured frames when --benchmark is given without --frames
+#define PATH_DEFAULT_DEPTH 8U //bounces per path
+#define PATH_DEFAULT_ROULETTE_DEPTH 3U //bounces before russian roulette may end a path
+#define PATH_MAX_DEPTH 64U //upper bound of --max-depth and the depth keys
+#define LIGHT_DEFAULT_SAMPLES 1U //lights picked per hit
 
 namespace RayTracing {
+	/*
+	 * Command line controlled render options. Headless renders frameCount frames into the storage image
+	 * without a window or swapchain and writes the last one to outputPath (.png or .exr), with accumulate
+	 * that is the linear average of all frames. A time budget renders until it is used up instead of frameCount frames,
+	 * so path tracing settings can be compared at equal time. Without tonemap and jitter the image is the one the
+	 * renderer always produced, linear radiance through the pixel corners.
+	 * A benchmark plays back cameraPath instead and measures frameCount frames after warmupFrames.
+	 */
+	struct RenderSettings {
+		bool headless = false;
+		uint32_t width = 800;
+		uint32_t height = 600;
+		uint32_t frameCount = 1;
+		float timeBudget = 0.f; //headless milliseconds to render instead of frameCount, 0 to disable
+		glm::vec3 cameraPosition = glm::vec3(0.0f, 0.0f, -2.0f);
+		glm::vec3 cameraRotation = glm::vec3();
+		std::string outputPath = "frame.png";
+		std::string scenePath = "scenes/default.scene";
+		std::string profilePath; //CSV with the GPU pass times of every frame, empty to disable
+		bool accumulate = false; //average the frames while camera and scene stay still
+		bool denoise = false; //SVGF on the samples of every frame, turns accumulate off
+		bool upscale = false; //temporal upscaling from renderScale, turns accumulate off
+		float renderScale = UPSCALE_MAX_SCALE; //traced fraction of the output resolution on each axis, the upper bound of a dynamic one
+		bool dynamicResolution = false; //renderScale follows the GPU frame time, implies upscale
+		float targetFrameMs = RESOLUTION_DEFAULT_TARGET_MS;
+		float minRenderScale = UPSCALE_MIN_SCALE;
+		std::string resolutionLogPath; //CSV with the GPU times and render scale of every frame, empty to disable
+		float exposure = 1.f;
+		bool tonemap = false; //ACES fit and sRGB encoding of the windowed output, headless output stays linear
+		bool jitter = false; //random subpixel positions of the primary rays, the upscaler uses its own
+		uint32_t maxDepth = PATH_DEFAULT_DEPTH;
+		uint32_t rouletteDepth = PATH_DEFAULT_ROULETTE_DEPTH; //maxDepth or more gives fixed length paths
+		uint32_t lightSamples = LIGHT_DEFAULT_SAMPLES; //shadow rays per hit, independent of the light count
+		LightSampler lightSampler = eLightSamplerBVH;
+		SamplerType sampler = eSamplerSobol; //random numbers of the paths, pcg is kept as the reference
+		bool rayStats = false; //count rays per type in the shader
+		std::string heatmapPath; //headless rays per pixel image of the last frame, implies rayStats
+		bool generateScene = false; //use the scene generator instead of scenePath
+		GeneratorSettings generator;
+
+		bool benchmark = false;
+		std::string cameraPath;
+		uint32_t warmupFrames = 32;
+		float timestep = 1.f / 60.f; //seconds of camera path per frame
+		std::string reportPath = "benchmark.json";
+
+		static RenderSettings fromArguments(int argc, char** argv);
+	};
+
 	class RTApp {
 	public:
-		RTApp();
+		RTApp(const RenderSettings& settings = {});
 		~RTApp();
 
 		void run();
+		void benchmarkDispatch(uint32_t frames = 1000, uint32_t commandsPerFrame = 256);
 	private:
 		void createCommandBuffers();
-		void prepareStorageImage(VkCommandBuffer buffer);
 		void copyImageToSwapchain(VkCommandBuffer buffer, VkImage swapChainImage, VkExtent2D size);
 		void rayTraceScene();
+		void renderHeadless();
+		void renderHeadlessFrame(bool readback);
+		void benchmark();
+		void writeUniform(uint32_t frame);
+		void updateRenderScale();
+		void handlePathKeys();
+		void recordTraceRays(VkCommandBuffer buffer, bool heatmap = false);
+		void copyRenderOutputToBuffer(VkCommandBuffer buffer);
+		void createFrameFences();
 		VkCommandBuffer beginFrame();
 		void endFrame();
 
 		void recreateSwapChain();
 
 	private:
-		Core::Window window;
+		RenderSettings settings;
+		std::unique_ptr<Core::Window> window;
 		Core::Device device;
 		Core::Camera camera;
 		Scene scene;
@@ -35,10 +108,29 @@ namespace RayTracing {
 		std::unique_ptr<Pipeline> rtPipeline;
 
 		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<VkFence> frameFences; //headless only, the swapchain owns the fences otherwise
+		std::unique_ptr<Core::Buffer> readbackBuffer;
+		std::unique_ptr<Core::GpuProfiler> profiler;
+
+		bool frameStarted = false;
+		bool discardFrame = false;
+		uint32_t frameIndex = 0;
+		uint32_t imageIndex = 0;
+		uint64_t frameNumber = 0; //submitted frames
+
+		glm::mat4 accumulatedView{ 0.f }; //camera and scene the accumulation image belongs to
+		glm::mat4 accumulatedProjection{ 0.f };
+		uint64_t accumulatedRevision = UINT64_MAX;
+		glm::uvec2 accumulatedDepths{ 0 }; //maximum and roulette depth
+
+		glm::mat4 previousViewInverse{ 0.f }; //camera of the last written uniform, zero before the first frame
+		glm::mat4 previousProjInverse{ 0.f };
+		glm::mat4 reprojection{ 1.f }; //view space of this frame to clip space of the previous one
+		glm::mat4 previousViewProjection{ 1.f };
+		glm::vec2 viewScale{ 1.f };
+		glm::vec2 jitter{ 0.f }; //Halton offset the frame is traced with while upscaling
+		std::unique_ptr<Extensions::ResolutionController> resolutionController; //only with a dynamic resolution
 
-		bool frameStarted;
-		bool discardFrame;
-		uint32_t frameIndex;
-		uint32_t imageIndex;
+		std::array<bool, 4> pathKeysDown{}; //[ ] - = of the last frame, a depth changes once per key press
 	};
 }
\ No newline at end of file
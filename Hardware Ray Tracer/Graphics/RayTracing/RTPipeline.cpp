@@ -1,16 +1,47 @@
 #include "RTPipeline.h"
 #include "Debugging.h"
+#include "../Hash.h"
+#include "../ImageWriter.h"
+#include "../vulkan_core/Shader.h"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+#define RAY_COUNTER_TYPES 4U //type counters in front of the depth histogram, padded like RAY_TYPE_COUNT in the shader
+#define RAY_COUNTER_BYTES ((RAY_COUNTER_TYPES + RAY_STATS_DEPTHS) * sizeof(uint32_t))
+
+uint64_t RayTracing::RayStatistics::total() const {
+	uint64_t sum = 0;
+	for (uint64_t count : rays)
+		sum += count;
+	return sum;
+}
 
-RayTracing::Pipeline::Pipeline(Core::Device& device, VkFormat format, VkExtent2D extent, AccelerationStructure topLevelAS, std::unique_ptr<Core::Buffer>& sceneInfoBuffer) 
+const char* RayTracing::RayStatistics::typeName(uint32_t type) {
+	switch (type) {
+	case ePrimaryRay: return "primary";
+	case eShadowRay: return "shadow";
+	case eBounceRay: return "bounce";
+	default: return "unknown";
+	}
+}
+
+RayTracing::Pipeline::Pipeline(Core::Device& device, VkFormat format, VkExtent2D extent, AccelerationStructure topLevelAS, std::unique_ptr<Core::Buffer>& sceneInfoBuffer, bool rayStats) 
 	: device(device), 
 	format(format), 
 	extent(extent), 
+	maxRenderExtent(extent),
+	renderExtent(extent),
 	topLevelAS(topLevelAS),
-	sceneInfoBuffer(sceneInfoBuffer) {
+	sceneInfoBuffer(sceneInfoBuffer),
+	rayStats(rayStats) {
 	
 	BUILD("Ray Tracing Pipeline", 0, 5, "Creating uniform buffers...");
 	uniformBuffers.resize(Core::SwapChain::MAX_FRAMES_IN_FLIGHT);
 	createUniformBuffers();
+	createRayStatsBuffers();
+	createSobolBuffer();
 
 	BUILD("Ray Tracing Pipeline", 1, 5, "Creating Storage Image...");
 	createStorageImage();
@@ -21,10 +52,15 @@ RayTracing::Pipeline::Pipeline(Core::Device& device, VkFormat format, VkExtent2D
 	createPipelineLayout();
 	BUILD("Ray Tracing Pipeline", 4, 5, "Creating Pipeline...");
 	createPipeline();
+	resolvePass = std::make_unique<ResolvePass>(device, pipelineCache->getCache());
+	resolvePass->setImages(accumulationImage.imageView, storageImage.imageView);
 
-	BUILD("Ray Tracing Pipeline", 5, 5, "Pipeline created!");
+	BUILD("Ray Tracing Pipeline", 5, 5, "Pipeline created in " << pipelineCreationTime << " ms (" << (pipelineCache->isWarm() ? "warm" : "cold") << " pipeline cache)");
 }
 RayTracing::Pipeline::~Pipeline() {
+	if (!pipelineCache->save())
+		DEBUG("[WARNING] Pipeline Cache: failed to write " << PIPELINE_CACHE_PATH);
+
 	destroyStorageImage();
 
 	vkDestroyPipeline(device.getDevice(), graphicsPipeline, nullptr);
@@ -39,7 +75,7 @@ void RayTracing::Pipeline::bindDescriptorSets(VkCommandBuffer buffer, uint32_t i
 	vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, graphicsPipelineLayout, 0, 1, &globalDescriptorSets[index], 0, VK_NULL_HANDLE);
 }
 void RayTracing::Pipeline::traceRays(VkCommandBuffer buffer, uint32_t width, uint32_t height, uint32_t depth) {
-	vkCmdTraceRaysKHR(buffer, &raygenRegion, &missRegion, &hitRegion, &callableRegion, width, height, depth);
+	device.dispatch().vkCmdTraceRaysKHR(buffer, &raygenRegion, &missRegion, &hitRegion, &callableRegion, width, height, depth);
 }
 void RayTracing::Pipeline::writeToUniformBuffer(void* data, uint32_t index) {
 	uniformBuffers[index]->writeToBuffer(data);
@@ -50,12 +86,370 @@ void RayTracing::Pipeline::rebuildRenderOutput(VkFormat format, VkExtent2D exten
 	destroyStorageImage();
 	this->format = format;
 	this->extent = extent;
+	glm::uvec2 scaled = Extensions::scaledExtent(glm::uvec2(extent.width, extent.height), maxRenderScale);
+	maxRenderExtent = VkExtent2D{ scaled.x, scaled.y };
+	scaled = Extensions::scaledExtent(glm::uvec2(extent.width, extent.height), renderScale);
+	renderExtent = VkExtent2D{ scaled.x, scaled.y };
 	createStorageImage();
+	createRayHeatmapBuffers();
 	createDescriptorSets();
+	setPassImages();
+
+	sampleCount = 0;
+	accumulationDefined = false;
 }
 
+//only call this while none of the descriptor sets is used by a pending command buffer
 void RayTracing::Pipeline::updateTopLevelAS(AccelerationStructure topLevelAS) {
-	
+	this->topLevelAS = topLevelAS;
+
+	VkWriteDescriptorSetAccelerationStructureKHR accelInfo{};
+	accelInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+	accelInfo.accelerationStructureCount = 1;
+	accelInfo.pAccelerationStructures = &this->topLevelAS.handle;
+
+	for (int i = 0; i < Core::SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+		Core::DescriptorWriter(*globalSetLayout, *globalPool)
+			.writeAccelStructure(0, &accelInfo)
+			.overwrite(globalDescriptorSets[i]);
+	}
+}
+
+//only call this while the device is idle, the images are recreated and the accumulation restarts
+void RayTracing::Pipeline::enableGBuffer(bool enabled) {
+	//the denoiser and upscaler keep reading it
+	if (enabled == gBufferEnabled || (!enabled && (denoiser || upscaler)))
+		return;
+
+	gBufferEnabled = enabled;
+	rebuildRenderOutput(format, extent);
+}
+
+//only call this while the device is idle, turns the G-buffer on as well, the instance image is written while both are on
+void RayTracing::Pipeline::enableInstanceIds(bool enabled) {
+	if (enabled == instanceIdsEnabled && (!enabled || gBufferEnabled))
+		return;
+
+	instanceIdsEnabled = enabled;
+	gBufferEnabled = gBufferEnabled || enabled;
+	rebuildRenderOutput(format, extent);
+}
+
+//only call this while the device is idle, the denoiser turns the G-buffer on and leaves it on
+void RayTracing::Pipeline::enableDenoiser(bool enabled) {
+	if (enabled == hasDenoiser())
+		return;
+
+	denoiser = enabled ? std::make_unique<Extensions::Denoiser>(device, pipelineCache->getCache()) : nullptr;
+	if (enabled && !gBufferEnabled)
+		enableGBuffer(true);
+	else setPassImages();
+}
+
+//only call this while the device is idle, the render resolution changes and the accumulation restarts
+void RayTracing::Pipeline::enableUpscaler(bool enabled, float scale) {
+	if (enabled == hasUpscaler() && (!enabled || scale == maxRenderScale))
+		return;
+
+	if (enabled && !upscaler)
+		upscaler = std::make_unique<Extensions::Upscaler>(device, pipelineCache->getCache());
+	else if (!enabled)
+		upscaler = nullptr;
+	maxRenderScale = enabled ? std::clamp(scale, UPSCALE_MIN_SCALE, UPSCALE_MAX_SCALE) : UPSCALE_MAX_SCALE;
+	renderScale = maxRenderScale;
+
+	//the upscaler needs the depth and motion vectors, rebuilding with the G-buffer on covers both changes
+	gBufferEnabled = gBufferEnabled || enabled;
+	rebuildRenderOutput(format, extent);
+}
+
+/*
+ * Chains the enabled passes: accumulation image, denoiser, upscaler, resolve. The resolve pass reads the last one.
+ */
+void RayTracing::Pipeline::setPassImages() {
+	VkImageView color = accumulationImage.imageView;
+
+	if (denoiser) {
+		denoiser->setImages(maxRenderExtent, Extensions::DenoiserInputs{
+			.color = color,
+			.depth = gBuffer.depth.imageView,
+			.normal = gBuffer.normal.imageView,
+			.albedo = gBuffer.albedo.imageView
+		});
+		denoiser->setViewport(renderExtent);
+		color = denoiser->getOutputView();
+	}
+
+	if (upscaler) {
+		upscaler->setImages(renderExtent, extent, Extensions::UpscalerInputs{
+			.color = color,
+			.depth = gBuffer.depth.imageView,
+			.motion = gBuffer.motion.imageView
+		});
+		color = upscaler->getOutputView();
+	}
+
+	resolvePass->setImages(color, storageImage.imageView);
+}
+
+VkImage RayTracing::Pipeline::getResolveInput() {
+	if (upscaler)
+		return upscaler->getOutput();
+	return denoiser ? denoiser->getOutput() : accumulationImage.image;
+}
+
+/*
+ * Filters this frame's samples, call it after the trace and before resolve(). The accumulation image has
+ * to hold only this frame, the denoiser keeps its own history.
+ */
+void RayTracing::Pipeline::denoise(VkCommandBuffer buffer, const glm::mat4& reprojection, glm::vec2 viewScale) {
+	denoiser->denoise(buffer, Extensions::SVGFConstants{
+		.reprojection = reprojection,
+		.viewScale = viewScale
+	});
+}
+
+/*
+ * Moves the traced area inside the allocated images, between the smallest scale and the one the upscaler was enabled with.
+ * Nothing is recreated and no descriptor set changes, so this may be called between any two frames while upscaling.
+ */
+void RayTracing::Pipeline::setRenderScale(float scale) {
+	if (!upscaler)
+		return;
+
+	renderScale = std::clamp(scale, UPSCALE_MIN_SCALE, maxRenderScale);
+	glm::uvec2 scaled = Extensions::scaledExtent(glm::uvec2(extent.width, extent.height), renderScale);
+	renderExtent = VkExtent2D{ scaled.x, scaled.y };
+
+	if (denoiser)
+		denoiser->setViewport(renderExtent);
+	upscaler->setRenderExtent(renderExtent);
+}
+
+/*
+ * Reconstructs the output resolution image after the trace and the denoiser, before resolve().
+ * The jitter has to be the one the frame was traced with.
+ */
+void RayTracing::Pipeline::upscale(VkCommandBuffer buffer, glm::vec2 jitter) {
+	upscaler->upscale(buffer, Extensions::UpscaleConstants{ .jitter = jitter });
+}
+
+/*
+ * Makes the previous frame's samples visible to this trace. Call it after the uniform of the frame has been written
+ * with getSampleCount() as the sample index, the count then includes this frame.
+ */
+void RayTracing::Pipeline::beginAccumulation(VkCommandBuffer buffer) {
+	//the G-buffer is rewritten every frame but may still be read by the previous frame's denoiser
+	std::array<VkImageMemoryBarrier, 6> barriers;
+	std::array<VkImage, 6> images = { accumulationImage.image, gBuffer.depth.image, gBuffer.normal.image, gBuffer.albedo.image, gBuffer.motion.image, gBuffer.instance.image };
+	for (size_t i = 0; i < images.size(); i++) {
+		barriers[i] = VkImageMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = accumulationDefined ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : 0,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			.oldLayout = accumulationDefined ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.image = images[i],
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+	}
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	accumulationDefined = true;
+	sampleCount++;
+}
+
+/*
+ * Writes the display image from the accumulation image, or from the denoiser output while it is enabled.
+ * Without displayTransform the radiance is only scaled by the exposure, with it the ACES fit is applied and
+ * UNORM outputs are sRGB encoded.
+ * The display image is left in the general layout.
+ */
+void RayTracing::Pipeline::resolve(VkCommandBuffer buffer, float exposure, bool displayTransform) {
+	std::array<VkImageMemoryBarrier, 2> barriers{
+		VkImageMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.image = getResolveInput(),
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		},
+		//the previous frame's copy of the display image only needs to finish, its content is replaced
+		VkImageMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.image = storageImage.image,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		}
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	bool unorm = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+
+	ResolveConstants constants{
+		.width = extent.width,
+		.height = extent.height,
+		.exposure = exposure,
+		.flags = displayTransform ? eResolveTonemap | (unorm ? eResolveSRGB : 0U) : 0U
+	};
+	resolvePass->record(buffer, constants);
+}
+
+static VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+	return VkBufferMemoryBarrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = srcAccess,
+		.dstAccessMask = dstAccess,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+}
+
+/*
+ * Clears the ray counters and the heatmap before the trace. The counters this frame index collected last time
+ * are read first, the caller has waited on the frame's fence, so they are complete and reading them never stalls.
+ */
+void RayTracing::Pipeline::beginRayStats(VkCommandBuffer buffer, uint32_t index, uint64_t frame) {
+	if (!rayStats) return;
+
+	readRayStats(index);
+	rayStatsReadbacks[index].frame = frame;
+
+	//the previous frame may still be adding to or copying from the buffers
+	std::array<VkBufferMemoryBarrier, 2> clearBarriers{
+		bufferBarrier(rayCounterBuffer->getBuffer(), VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+		bufferBarrier(rayHeatmapBuffer->getBuffer(), VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT)
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, static_cast<uint32_t>(clearBarriers.size()), clearBarriers.data(), 0, VK_NULL_HANDLE);
+
+	vkCmdFillBuffer(buffer, rayCounterBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+	vkCmdFillBuffer(buffer, rayHeatmapBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+	std::array<VkBufferMemoryBarrier, 2> traceBarriers{
+		bufferBarrier(rayCounterBuffer->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+		bufferBarrier(rayHeatmapBuffer->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0, VK_NULL_HANDLE, static_cast<uint32_t>(traceBarriers.size()), traceBarriers.data(), 0, VK_NULL_HANDLE);
+}
+
+/*
+ * Copies the counters of this frame into the readback slot of the frame index, the heatmap only when asked for
+ */
+void RayTracing::Pipeline::endRayStats(VkCommandBuffer buffer, uint32_t index, bool heatmap) {
+	if (!rayStats) return;
+
+	std::array<VkBufferMemoryBarrier, 2> copyBarriers{
+		bufferBarrier(rayCounterBuffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+		bufferBarrier(rayHeatmapBuffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT)
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, heatmap ? 2 : 1, copyBarriers.data(), 0, VK_NULL_HANDLE);
+
+	VkBufferCopy counterRegion{ .srcOffset = 0, .dstOffset = index * RAY_COUNTER_BYTES, .size = RAY_COUNTER_BYTES };
+	vkCmdCopyBuffer(buffer, rayCounterBuffer->getBuffer(), rayCounterReadback->getBuffer(), 1, &counterRegion);
+
+	if (heatmap) {
+		VkBufferCopy heatmapRegion{ .srcOffset = 0, .dstOffset = 0, .size = rayHeatmapBuffer->getBufferSize() };
+		vkCmdCopyBuffer(buffer, rayHeatmapBuffer->getBuffer(), rayHeatmapReadback->getBuffer(), 1, &heatmapRegion);
+	}
+
+	std::array<VkBufferMemoryBarrier, 2> hostBarriers{
+		bufferBarrier(rayCounterReadback->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT),
+		bufferBarrier(rayHeatmapReadback->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT)
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, VK_NULL_HANDLE, heatmap ? 2 : 1, hostBarriers.data(), 0, VK_NULL_HANDLE);
+
+	rayStatsReadbacks[index].pending = true;
+}
+
+/*
+ * Reads every pending frame in submission order, only call this after the device is idle
+ */
+void RayTracing::Pipeline::resolveRayStats() {
+	if (!rayStats) return;
+
+	std::array<uint32_t, Core::SwapChain::MAX_FRAMES_IN_FLIGHT> order;
+	for (uint32_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return rayStatsReadbacks[a].frame < rayStatsReadbacks[b].frame; });
+
+	for (uint32_t index : order)
+		readRayStats(index);
+}
+
+std::vector<RayTracing::RayStatistics> RayTracing::Pipeline::takeRayStats() {
+	std::vector<RayStatistics> taken(rayStatsResults.begin(), rayStatsResults.end());
+	rayStatsResults.clear();
+	return taken;
+}
+
+/*
+ * Mrays/s of every ray type in the last read back frame, the trace time usually is the profiler's "Trace Rays" average
+ */
+std::string RayTracing::Pipeline::raySummary(double traceMilliseconds) const {
+	std::ostringstream summary;
+	summary << std::fixed << std::setprecision(1);
+
+	for (uint32_t type = 0; type < eRayTypeCount; type++) {
+		double megaRays = traceMilliseconds > 0.0 ? lastRayStats.rays[type] / (traceMilliseconds * 1e3) : 0.0;
+		summary << (type > 0 ? ", " : "") << RayStatistics::typeName(type) << " " << megaRays;
+	}
+	summary << " Mrays/s";
+
+	return summary.str();
+}
+
+/*
+ * Writes the rays per pixel of the last frame copied with endRayStats(..., true), scaled to the busiest pixel
+ * on a black, red, yellow, white ramp
+ */
+bool RayTracing::Pipeline::writeRayHeatmap(const std::string& path) {
+	if (!rayStats) return false;
+
+	VK_CHECK_RESULT(rayHeatmapReadback->invalidate(), "failed to invalidate ray heatmap readback!");
+	const uint32_t* counts = static_cast<const uint32_t*>(rayHeatmapReadback->getMappedMemory());
+	size_t pixelCount = static_cast<size_t>(renderExtent.width) * renderExtent.height;
+
+	uint32_t maxCount = *std::max_element(counts, counts + pixelCount);
+	float scale = maxCount > 0 ? 1.f / maxCount : 0.f;
+
+	std::vector<float> rgba(pixelCount * 4);
+	for (size_t i = 0; i < pixelCount; i++) {
+		float t = counts[i] * scale * 3.f;
+		rgba[i * 4 + 0] = std::clamp(t, 0.f, 1.f);
+		rgba[i * 4 + 1] = std::clamp(t - 1.f, 0.f, 1.f);
+		rgba[i * 4 + 2] = std::clamp(t - 2.f, 0.f, 1.f);
+		rgba[i * 4 + 3] = 1.f;
+	}
+
+	DEBUG("[INFO] Ray Heatmap: up to " << maxCount << " rays per pixel");
+	return Core::ImageWriter::write(path, renderExtent.width, renderExtent.height, rgba.data());
+}
+
+void RayTracing::Pipeline::readRayStats(uint32_t index) {
+	RayStatsReadback& readback = rayStatsReadbacks[index];
+	if (!readback.pending) return;
+	readback.pending = false;
+
+	const uint32_t* counters = static_cast<const uint32_t*>(rayCounterReadback->getMappedMemory()) + index * (RAY_COUNTER_BYTES / sizeof(uint32_t));
+
+	RayStatistics statistics{ .frame = readback.frame };
+	for (uint32_t type = 0; type < eRayTypeCount; type++)
+		statistics.rays[type] = counters[type];
+	for (uint32_t depth = 0; depth < RAY_STATS_DEPTHS; depth++)
+		statistics.depths[depth] = counters[RAY_COUNTER_TYPES + depth];
+
+	lastRayStats = statistics;
+	rayStatsResults.push_back(statistics);
+	if (rayStatsResults.size() > RAY_STATS_MAX_RESULTS)
+		rayStatsResults.pop_front();
 }
 
 void RayTracing::Pipeline::createUniformBuffers() {
@@ -71,40 +465,88 @@ void RayTracing::Pipeline::createUniformBuffers() {
 	}
 }
 
-void RayTracing::Pipeline::createStorageImage() {
-	VkImageCreateInfo imageInfo{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-		.imageType = VK_IMAGE_TYPE_2D,
-		.format = format,
-		.extent = {.width = extent.width, .height = extent.height, .depth = 1},
-		.mipLevels = 1,
-		.arrayLayers = 1, 
-		.samples = VK_SAMPLE_COUNT_1_BIT,
-		.tiling = VK_IMAGE_TILING_OPTIMAL,
-		.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
-	};
+/*
+ * The counter and heatmap buffers are bound even without instrumentation, they just stay tiny then
+ */
+void RayTracing::Pipeline::createRayStatsBuffers() {
+	rayCounterBuffer = std::make_unique<Core::Buffer>(
+		device,
+		RAY_COUNTER_BYTES,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
 
-	VkImageViewCreateInfo viewInfo{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-		.viewType = VK_IMAGE_VIEW_TYPE_2D,
-		.format = format,
-		.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 },
-	};
+	if (rayStats) {
+		rayCounterReadback = std::make_unique<Core::Buffer>(
+			device,
+			RAY_COUNTER_BYTES * Core::SwapChain::MAX_FRAMES_IN_FLIGHT,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+		);
+		VK_CHECK_RESULT(rayCounterReadback->map(), "failed to map ray counter readback!");
+	}
+
+	createRayHeatmapBuffers();
+}
+
+void RayTracing::Pipeline::createRayHeatmapBuffers() {
+	VkDeviceSize size = rayStats ? static_cast<VkDeviceSize>(maxRenderExtent.width) * maxRenderExtent.height * sizeof(uint32_t) : sizeof(uint32_t);
+
+	rayHeatmapBuffer = std::make_unique<Core::Buffer>(
+		device,
+		size,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
+
+	if (rayStats) {
+		rayHeatmapReadback = std::make_unique<Core::Buffer>(
+			device,
+			size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+		);
+		VK_CHECK_RESULT(rayHeatmapReadback->map(), "failed to map ray heatmap readback!");
+	}
+}
 
-	device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, storageImage.image, storageImage.imageMemory);
+/*
+ * Tiny and never rewritten, so it stays host visible instead of going through a staging copy
+ */
+void RayTracing::Pipeline::createSobolBuffer() {
+	std::vector<uint32_t> matrices = createSobolMatrices(SOBOL_DIMENSIONS);
 
-	viewInfo.image = storageImage.image;
+	sobolBuffer = std::make_unique<Core::Buffer>(
+		device,
+		matrices.size() * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	VK_CHECK_RESULT(sobolBuffer->map(), "failed to map Sobol buffer!");
+	sobolBuffer->writeToBuffer(matrices.data());
+	sobolBuffer->unmap();
+}
 
-	VK_CHECK_RESULT(vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &storageImage.imageView), "failed to create texture image view!");
+void RayTracing::Pipeline::createStorageImage() {
+	storageImage.create(device, format, extent, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	accumulationImage.create(device, VK_FORMAT_R32G32B32A32_SFLOAT, maxRenderExtent, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+
+	//the descriptors always need views, unused G-buffer images shrink to one pixel
+	VkExtent2D gBufferExtent = gBufferEnabled ? maxRenderExtent : VkExtent2D{ 1, 1 };
+	gBuffer.depth.create(device, VK_FORMAT_R32_SFLOAT, gBufferExtent);
+	gBuffer.normal.create(device, VK_FORMAT_R32_UINT, gBufferExtent);
+	gBuffer.albedo.create(device, VK_FORMAT_R8G8B8A8_UNORM, gBufferExtent);
+	gBuffer.motion.create(device, VK_FORMAT_R16G16_SFLOAT, gBufferExtent);
+	gBuffer.instance.create(device, VK_FORMAT_R32_UINT, hasInstanceIds() ? gBufferExtent : VkExtent2D{ 1, 1 });
 }
+
 void RayTracing::Pipeline::createDescriptorSets() {
 	globalPool = Core::DescriptorPool::Builder(device)
 		.setMaxSets(Core::SwapChain::MAX_FRAMES_IN_FLIGHT)
 		.addPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, Core::SwapChain::MAX_FRAMES_IN_FLIGHT)
-		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, Core::SwapChain::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6 * Core::SwapChain::MAX_FRAMES_IN_FLIGHT)
 		.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, Core::SwapChain::MAX_FRAMES_IN_FLIGHT)
-		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Core::SwapChain::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * Core::SwapChain::MAX_FRAMES_IN_FLIGHT)
 		.build();
 
 	globalSetLayout = Core::DescriptorSetLayout::Builder(device)
@@ -112,13 +554,21 @@ void RayTracing::Pipeline::createDescriptorSets() {
 		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_ALL, 1)
 		.addBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL, 1)
 		.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_ALL, 1)
+		.addBinding(11, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_ALL, 1)
 		.build();
 
 	globalDescriptorSets.resize(Core::SwapChain::MAX_FRAMES_IN_FLIGHT);
 
 	VkDescriptorImageInfo imageInfo{};
 	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	imageInfo.imageView = storageImage.imageView;
+	imageInfo.imageView = accumulationImage.imageView;
 
 	VkWriteDescriptorSetAccelerationStructureKHR accelInfo{};
 	accelInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
@@ -126,6 +576,14 @@ void RayTracing::Pipeline::createDescriptorSets() {
 	accelInfo.pAccelerationStructures = &topLevelAS.handle;
 
 	auto sceneInfo = sceneInfoBuffer->descriptorInfo();
+	auto rayCounters = rayCounterBuffer->descriptorInfo();
+	auto rayHeatmap = rayHeatmapBuffer->descriptorInfo();
+	auto sobolMatrices = sobolBuffer->descriptorInfo();
+	VkDescriptorImageInfo depthInfo{ .imageView = gBuffer.depth.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo normalInfo{ .imageView = gBuffer.normal.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo albedoInfo{ .imageView = gBuffer.albedo.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo motionInfo{ .imageView = gBuffer.motion.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo instanceInfo{ .imageView = gBuffer.instance.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
 
 	for (int i = 0; i < Core::SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
 		auto uboBufInfo = uniformBuffers[i]->descriptorInfo();
@@ -135,6 +593,14 @@ void RayTracing::Pipeline::createDescriptorSets() {
 			.writeImage(1, &imageInfo)
 			.writeBuffer(2, &uboBufInfo)
 			.writeBuffer(3, &sceneInfo)
+			.writeBuffer(4, &rayCounters)
+			.writeBuffer(5, &rayHeatmap)
+			.writeBuffer(6, &sobolMatrices)
+			.writeImage(7, &depthInfo)
+			.writeImage(8, &normalInfo)
+			.writeImage(9, &albedoInfo)
+			.writeImage(10, &motionInfo)
+			.writeImage(11, &instanceInfo)
 			.build(globalDescriptorSets[i]);
 	}
 }
@@ -162,10 +628,48 @@ void RayTracing::Pipeline::createPipeline() {
 
 	std::array<VkPipelineShaderStageCreateInfo, eShaderGroupCount> stages{};
 
-	for (VkPipelineShaderStageCreateInfo& info : stages)
+	//RAY_STATS in shaders/raystats.slang, the driver strips the counting when it is false
+	VkBool32 rayStatsEnabled = rayStats ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry rayStatsEntry{ .constantID = 0, .offset = 0, .size = sizeof(VkBool32) };
+	VkSpecializationInfo specialization{
+		.mapEntryCount = 1,
+		.pMapEntries = &rayStatsEntry,
+		.dataSize = sizeof(VkBool32),
+		.pData = &rayStatsEnabled
+	};
+
+	for (VkPipelineShaderStageCreateInfo& info : stages) {
 		info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		info.pSpecializationInfo = &specialization;
+	}
 
-	readShader("shaders/raytracing.slang.spv", &rtShaderModule);
+	std::vector<char> shaderCode = Core::Shader::readFile(RT_SHADER_PATH);
+	Core::ShaderInterface(shaderCode, RT_SHADER_PATH)
+		.requireSpecConstant(0) //RAY_STATS
+		.requireBinding(0, 4) //rayCounters
+		.requireBinding(0, 5) //rayHeatmap
+		.requireMember(0, 2, "sampleIndex", offsetof(Uniform, sampleIndex))
+		.requireMember(0, 2, "rouletteDepth", offsetof(Uniform, rouletteDepth))
+		.requireMember(0, 2, "lightSamples", offsetof(Uniform, lightSamples))
+		.requireMember(0, 3, "lightAliasBuffer", offsetof(SceneBufferInfo, laBuf))
+		.requireMember(0, 2, "lightSampler", offsetof(Uniform, lightSampler))
+		.requireMember(0, 3, "lightBVHBuffer", offsetof(SceneBufferInfo, lbvhBuf))
+		.requireMember(0, 3, "emitterBuffer", offsetof(SceneBufferInfo, eBuf))
+		.requireMember(0, 3, "emitterProbability", offsetof(SceneBufferInfo, eProbability))
+		.requireBinding(0, 6) //sobolMatrices
+		.requireMember(0, 2, "samplerType", offsetof(Uniform, samplerType))
+		.requireMember(0, 2, "sequenceIndex", offsetof(Uniform, sequenceIndex))
+		.requireBinding(0, 7) //G-buffer depth, normal, albedo and motion
+		.requireBinding(0, 8)
+		.requireBinding(0, 9)
+		.requireBinding(0, 10)
+		.requireBinding(0, 11) //G-buffer instance, only written with GBUFFER_WRITE_INSTANCE
+		.requireMember(0, 2, "previousViewInverse", offsetof(Uniform, previousViewInverse))
+		.requireMember(0, 2, "writeGBuffer", offsetof(Uniform, writeGBuffer))
+		.requireMember(0, 2, "jitter", offsetof(Uniform, jitter))
+		.requireMember(0, 2, "jitterMode", offsetof(Uniform, jitterMode));
+	rtShaderModule = Core::Shader::createModule(device, shaderCode);
+	pipelineCache = std::make_unique<PipelineCache>(device, PIPELINE_CACHE_PATH, Core::fnv1a(shaderCode.data(), shaderCode.size()));
 	stages[eRayGen].pName = "rgenMain";
 	stages[eRayGen].stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
 	stages[eRayGen].module = rtShaderModule;
@@ -217,10 +721,14 @@ void RayTracing::Pipeline::createPipeline() {
 	rtPipelineInfo.maxPipelineRayRecursionDepth = std::max(MAX_DEPTH, device.getRTProperties()->maxRayRecursionDepth);
 	rtPipelineInfo.layout = graphicsPipelineLayout;
 
-	vkCreateRayTracingPipelinesKHR(device.getDevice(), {}, {}, 1, &rtPipelineInfo, nullptr, &graphicsPipeline);
+	auto start = std::chrono::high_resolution_clock::now();
+	VK_CHECK_RESULT(device.dispatch().vkCreateRayTracingPipelinesKHR(device.getDevice(), {}, pipelineCache->getCache(), 1, &rtPipelineInfo, nullptr, &graphicsPipeline), "failed to create ray tracing pipeline!");
+	pipelineCreationTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
 
 	std::cout << "Creating Shader Binding Table..." << std::endl;
+	start = std::chrono::high_resolution_clock::now();
 	createShaderBindingTable(rtPipelineInfo);
+	sbtCreationTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
 	std::cout << "Shader Binding Table created" << std::endl;
 }
 
@@ -232,7 +740,7 @@ void RayTracing::Pipeline::createShaderBindingTable(const VkRayTracingPipelineCr
 
 	size_t dataSize = handleSize * groupCount;
 	shaderHandles.resize(dataSize);
-	VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device.getDevice(), graphicsPipeline, 0, groupCount, dataSize, shaderHandles.data()), "failed to get shader shader handles!");
+	VK_CHECK_RESULT(device.dispatch().vkGetRayTracingShaderGroupHandlesKHR(device.getDevice(), graphicsPipeline, 0, groupCount, dataSize, shaderHandles.data()), "failed to get shader shader handles!");
 
 	auto     alignUp = [](uint32_t size, uint32_t alignment) { return (size + alignment - 1) & ~(alignment - 1); };
 	uint32_t raygenSize = alignUp(handleSize, handleAlignment);
@@ -280,46 +788,18 @@ void RayTracing::Pipeline::createShaderBindingTable(const VkRayTracingPipelineCr
 	callableRegion.stride = 0;
 }
 
-void RayTracing::Pipeline::readShader(std::string path, VkShaderModule* module) {
-	std::vector<char> code = readShaderFile(path);
-	createShaderModule(code, module);
-}
-
-std::vector<char> RayTracing::Pipeline::readShaderFile(std::string& path) {
-	std::ifstream file(path, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open()) throw std::runtime_error("failed to open: " + path);
-
-	size_t size = static_cast<size_t>(file.tellg());
-	std::vector<char> buf(size);
-	file.seekg(0);
-	file.read(buf.data(), size);
-	file.close();
-
-	return buf;
-}
-
-void RayTracing::Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* module) {
-	VkShaderModuleCreateInfo info{};
-	info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	info.codeSize = code.size();
-	info.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-	VK_CHECK_RESULT(vkCreateShaderModule(device.getDevice(), &info, nullptr, module), "failed to create Shader module");
-}
-
 void RayTracing::Pipeline::destroyStorageImage() {
-	vkDestroyImageView(device.getDevice(), storageImage.imageView, nullptr);
-	vkDestroyImage(device.getDevice(), storageImage.image, nullptr);
-	vkFreeMemory(device.getDevice(), storageImage.imageMemory, nullptr);
+	for (Core::StorageImage* image : { &storageImage, &accumulationImage, &gBuffer.depth, &gBuffer.normal, &gBuffer.albedo, &gBuffer.motion, &gBuffer.instance })
+		image->destroy(device);
 }
 
-std::unique_ptr<RayTracing::Pipeline> RayTracing::Pipeline::createPipeline(Core::Device& device, std::unique_ptr<Core::SwapChain>& swapChain, Scene& scene) {
+std::unique_ptr<RayTracing::Pipeline> RayTracing::Pipeline::createPipeline(Core::Device& device, std::unique_ptr<Core::SwapChain>& swapChain, Scene& scene, bool rayStats) {
 	return std::make_unique<RayTracing::Pipeline>(
 		device,
 		swapChain->getSwapChainImageFormat(),
 		swapChain->getSwapChainExtent(),
 		scene.getTlas(),
-		scene.getSceneInfoBuffer()
+		scene.getSceneInfoBuffer(),
+		rayStats
 	);
 }
\ No newline at end of file
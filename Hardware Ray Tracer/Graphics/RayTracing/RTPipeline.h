@@ -1,37 +1,91 @@
 #pragma once
 
 #include <array>
+#include <deque>
 #include <fstream>
 #include <glm/glm.hpp>
 #include "../vulkan_core/Device.h"
 #include "../vulkan_core/SwapChain.h"
 #include "../vulkan_core/Descriptors.h"
+#include "../vulkan_core/StorageImage.h"
 #include "Scene.h"
+#include "PipelineCache.h"
+#include "ResolvePass.h"
+#include "SobolSampler.h"
+#include "../Denoiser/Denoiser.h"
+#include "../Upscaler/Upscaler.h"
 
-#define vkCreateRayTracingPipelinesKHR reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkCreateRayTracingPipelinesKHR"))
-#define vkGetRayTracingShaderGroupHandlesKHR reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkGetRayTracingShaderGroupHandlesKHR"))
-#define vkCmdTraceRaysKHR reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkCmdTraceRaysKHR"))
 
 #define MAX_DEPTH 10U
+#define RT_SHADER_PATH "shaders/raytracing.slang.spv" //compiled from shaders/raytracing.slang by the slangc build step
+#define PIPELINE_CACHE_PATH "shaders/raytracing.pipelinecache" //driver pipeline cache, written back on shutdown
+#define RAY_STATS_DEPTHS 16U //depth histogram buckets, RAY_STATS_DEPTHS in shaders/raystats.slang
+#define RAY_STATS_MAX_RESULTS 1024U //read back frames kept until takeRayStats(), older ones are dropped
+#define GBUFFER_WRITE 1U //Uniform::writeGBuffer bit for depth, normal, albedo and motion, GBUFFER_WRITE in shaders/raytracing.slang
+#define GBUFFER_WRITE_INSTANCE 2U //Uniform::writeGBuffer bit for the instance image
 
 namespace RayTracing {
-	struct StorageImage {
-		VkImage image;
-		VkDeviceMemory imageMemory;
-		VkImageView imageView;
+	/*
+	 * Primary hit data written next to the radiance, 16 bytes per pixel. The denoiser uses it to find edges, the motion
+	 * vectors follow the camera only. While disabled the images are 1x1 placeholders the shader does not write.
+	 * The instance image adds 4 bytes and stays a placeholder until a consumer asks for it with enableInstanceIds(),
+	 * packing it into the albedo cost dark albedos their precision and wrapped above 65535 instances.
+	 */
+	struct GBuffer {
+		Core::StorageImage depth; //R32F view space depth, 0 for misses
+		Core::StorageImage normal; //R32UI octahedral world normal, Extensions::encodeNormal
+		Core::StorageImage albedo; //RGBA8 base color, white for misses, Extensions::packAlbedo
+		Core::StorageImage motion; //RG16F pixels from the position in this frame to the one in the previous frame
+		Core::StorageImage instance; //R32UI instance index + 1, 0 for misses, only with enableInstanceIds()
 	};
 
 	struct Uniform {
 		glm::mat4 viewInverse;
 		glm::mat4 projInverse;
+		glm::mat4 previousViewInverse; //camera of the previous frame for the motion vectors
+		glm::mat4 previousProjInverse;
 		uint32_t frame;
 		uint32_t depthMax;
 		float LIGHT_TRESHOLD = .0001f;
+		uint32_t sampleIndex; //samples already averaged in the accumulation image, 0 restarts the average
+		uint32_t rouletteDepth; //bounces before russian roulette may end a path
+		uint32_t lightSamples; //lights picked per hit, each costs one shadow ray
+		uint32_t lightSampler; //LightSampler
+		uint32_t samplerType; //SamplerType
+		uint32_t sequenceIndex; //first sample of the Sobol sequence traced this frame, in units of SAMPLES
+		uint32_t writeGBuffer; //getGBufferWrites()
+		glm::vec2 jitter; //offset of every sample from its pixel center with eJitterFixed
+		uint32_t jitterMode; //JitterMode
+	};
+
+	enum JitterMode : uint32_t {
+		eJitterNone, //every sample through the pixel corner, like the output before accumulation
+		eJitterRandom, //positions from the path sampler, antialiases accumulated frames
+		eJitterFixed //Uniform::jitter for every pixel, the upscaler has to know where the samples are
+	};
+
+	enum RayType : uint32_t {
+		ePrimaryRay,
+		eShadowRay,
+		eBounceRay,
+		eRayTypeCount
+	};
+
+	/*
+	 * Rays traced in one frame, counted by the instrumented shader
+	 */
+	struct RayStatistics {
+		uint64_t frame = 0;
+		std::array<uint64_t, eRayTypeCount> rays{};
+		std::array<uint64_t, RAY_STATS_DEPTHS> depths{}; //primary and bounce rays per path depth
+
+		uint64_t total() const;
+		static const char* typeName(uint32_t type);
 	};
 
 	class Pipeline {
 	public:
-		Pipeline(Core::Device& device, VkFormat format, VkExtent2D, AccelerationStructure topLevelAS, std::unique_ptr<Core::Buffer>& sceneInfoBuffer);
+		Pipeline(Core::Device& device, VkFormat format, VkExtent2D, AccelerationStructure topLevelAS, std::unique_ptr<Core::Buffer>& sceneInfoBuffer, bool rayStats = false);
 		~Pipeline();
 
 		Pipeline(const Pipeline&) = delete;
@@ -46,34 +100,103 @@ namespace RayTracing {
 		void rebuildRenderOutput(VkFormat format, VkExtent2D extent);
 		void updateTopLevelAS(AccelerationStructure topLevelAS);
 
-		inline StorageImage& getRenderOutput() { return storageImage; }
-
-		static std::unique_ptr<Pipeline> createPipeline(Core::Device& device, std::unique_ptr<Core::SwapChain>& swapChain, Scene& scene);
+		void beginAccumulation(VkCommandBuffer buffer);
+		void resolve(VkCommandBuffer buffer, float exposure, bool displayTransform);
+		inline void resetAccumulation() { sampleCount = 0; }
+		inline uint32_t getSampleCount() { return sampleCount; }
+
+		void enableGBuffer(bool enabled);
+		inline bool hasGBuffer() { return gBufferEnabled; }
+		void enableInstanceIds(bool enabled);
+		inline bool hasInstanceIds() { return gBufferEnabled && instanceIdsEnabled; }
+		inline uint32_t getGBufferWrites() { return (gBufferEnabled ? GBUFFER_WRITE : 0U) | (hasInstanceIds() ? GBUFFER_WRITE_INSTANCE : 0U); }
+		void enableDenoiser(bool enabled);
+		void denoise(VkCommandBuffer buffer, const glm::mat4& reprojection, glm::vec2 viewScale);
+		inline bool hasDenoiser() { return denoiser != nullptr; }
+
+		void enableUpscaler(bool enabled, float scale = UPSCALE_MAX_SCALE);
+		void upscale(VkCommandBuffer buffer, glm::vec2 jitter);
+		void setRenderScale(float scale);
+		inline bool hasUpscaler() { return upscaler != nullptr; }
+		inline float getRenderScale() { return renderScale; }
+		inline float getMaxRenderScale() { return maxRenderScale; }
+		inline VkExtent2D getRenderExtent() { return renderExtent; }
+
+		void beginRayStats(VkCommandBuffer buffer, uint32_t index, uint64_t frame);
+		void endRayStats(VkCommandBuffer buffer, uint32_t index, bool heatmap = false);
+		void resolveRayStats();
+		std::vector<RayStatistics> takeRayStats();
+		std::string raySummary(double traceMilliseconds) const;
+		bool writeRayHeatmap(const std::string& path);
+
+		inline Core::StorageImage& getRenderOutput() { return storageImage; }
+		inline Core::StorageImage& getAccumulationImage() { return accumulationImage; }
+		inline GBuffer& getGBuffer() { return gBuffer; }
+		inline bool hasRayStats() { return rayStats; }
+		inline const RayStatistics& getLastRayStats() { return lastRayStats; }
+		inline float getPipelineCreationTime() { return pipelineCreationTime; }
+		inline float getSBTCreationTime() { return sbtCreationTime; }
+
+		static std::unique_ptr<Pipeline> createPipeline(Core::Device& device, std::unique_ptr<Core::SwapChain>& swapChain, Scene& scene, bool rayStats = false);
 	private:
+		struct RayStatsReadback {
+			uint64_t frame = 0;
+			bool pending = false; //written by a submitted frame and not yet read back
+		};
+
 		void createUniformBuffers();
 		void createStorageImage();
+		void createRayStatsBuffers();
+		void createRayHeatmapBuffers();
+		void createSobolBuffer();
+		void readRayStats(uint32_t index);
 		void createDescriptorSets();
 		void createPipelineLayout();
 		void createPipeline();
 		void createShaderBindingTable(const VkRayTracingPipelineCreateInfoKHR& rtPipelineInfo);
 
-		void readShader(std::string path, VkShaderModule* module);
-		std::vector<char> readShaderFile(std::string& path);
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* module);
 
 		void destroyStorageImage();
+		void setPassImages();
+		VkImage getResolveInput();
 	private:
 		Core::Device& device;
 
 		VkFormat format;
-		VkExtent2D extent;
-		StorageImage storageImage;
+		VkExtent2D extent; //output size of the display image
+		VkExtent2D maxRenderExtent; //allocated size of the accumulation image and the G-buffer, smaller while upscaling
+		VkExtent2D renderExtent; //traced top left part of them, only smaller than maxRenderExtent with a dynamic render scale
+		float maxRenderScale = UPSCALE_MAX_SCALE;
+		float renderScale = UPSCALE_MAX_SCALE;
+		Core::StorageImage storageImage; //display image in the output format, written by the resolve pass
+		Core::StorageImage accumulationImage; //running average of the traced samples
+		GBuffer gBuffer;
+		bool gBufferEnabled = false;
+		bool instanceIdsEnabled = false; //nothing reads the instance image by default
+		std::unique_ptr<ResolvePass> resolvePass;
+		std::unique_ptr<Extensions::Denoiser> denoiser; //replaces the accumulation image as the resolve input while enabled
+		std::unique_ptr<Extensions::Upscaler> upscaler; //reads the denoiser output or the accumulation image, feeds the resolve pass
+		uint32_t sampleCount = 0;
+		bool accumulationDefined = false; //false until the accumulation image has been transitioned out of the undefined layout
 
 		AccelerationStructure topLevelAS;
 		std::unique_ptr<Core::Buffer>& sceneInfoBuffer;
 
 		VkPipeline graphicsPipeline;
 		VkPipelineLayout graphicsPipelineLayout;
+		std::unique_ptr<PipelineCache> pipelineCache;
+		float pipelineCreationTime = 0.f;
+		float sbtCreationTime = 0.f;
+
+		bool rayStats;
+		std::unique_ptr<Core::Buffer> rayCounterBuffer; //device local counters the shader adds to
+		std::unique_ptr<Core::Buffer> rayCounterReadback; //one copy of the counters per frame in flight
+		std::unique_ptr<Core::Buffer> rayHeatmapBuffer;
+		std::unique_ptr<Core::Buffer> rayHeatmapReadback;
+		std::unique_ptr<Core::Buffer> sobolBuffer; //direction numbers of the Sobol sampler, written once
+		std::array<RayStatsReadback, Core::SwapChain::MAX_FRAMES_IN_FLIGHT> rayStatsReadbacks{};
+		std::deque<RayStatistics> rayStatsResults;
+		RayStatistics lastRayStats;
 
 		std::unique_ptr<Core::DescriptorPool> globalPool{};
 		std::unique_ptr<Core::DescriptorSetLayout> globalSetLayout;
@@ -82,7 +205,6 @@ namespace RayTracing {
 
 		std::unique_ptr<Core::Buffer> sbtBuffer;
 		std::vector<uint8_t> shaderHandles;
-		std::vector<char> shaderRawCode;
 		VkShaderModule rtShaderModule;
 
 		VkStridedDeviceAddressRegionKHR raygenRegion{};
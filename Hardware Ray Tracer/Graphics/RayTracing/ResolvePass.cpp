@@ -0,0 +1,62 @@
+#include "ResolvePass.h"
+#include "../vulkan_core/Shader.h"
+
+RayTracing::ResolvePass::ResolvePass(Core::Device& device, VkPipelineCache cache) : device(device) {
+	createDescriptorSet();
+	createPipeline(cache);
+}
+RayTracing::ResolvePass::~ResolvePass() {
+	vkDestroyPipeline(device.getDevice(), pipeline, nullptr);
+	vkDestroyPipelineLayout(device.getDevice(), pipelineLayout, nullptr);
+}
+
+//only call this while the descriptor set is not used by a pending command buffer
+void RayTracing::ResolvePass::setImages(VkImageView accumulation, VkImageView output) {
+	VkDescriptorImageInfo accumulationInfo{ .imageView = accumulation, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo outputInfo{ .imageView = output, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+
+	Core::DescriptorWriter writer(*setLayout, *pool);
+	writer.writeImage(0, &accumulationInfo)
+		.writeImage(1, &outputInfo);
+
+	if (descriptorSet == VK_NULL_HANDLE) {
+		if (!writer.build(descriptorSet))
+			throw std::runtime_error("failed to allocate resolve descriptor set!");
+	}
+	else writer.overwrite(descriptorSet);
+}
+
+void RayTracing::ResolvePass::record(VkCommandBuffer buffer, const ResolveConstants& constants) {
+	vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, VK_NULL_HANDLE);
+	vkCmdPushConstants(buffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResolveConstants), &constants);
+	vkCmdDispatch(buffer, (constants.width + RESOLVE_GROUP_SIZE - 1) / RESOLVE_GROUP_SIZE, (constants.height + RESOLVE_GROUP_SIZE - 1) / RESOLVE_GROUP_SIZE, 1);
+}
+
+void RayTracing::ResolvePass::createDescriptorSet() {
+	pool = Core::DescriptorPool::Builder(device)
+		.setMaxSets(1)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2)
+		.build();
+
+	setLayout = Core::DescriptorSetLayout::Builder(device)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+		.build();
+}
+
+void RayTracing::ResolvePass::createPipeline(VkPipelineCache cache) {
+	VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+	VkPushConstantRange pushConstants{ .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(ResolveConstants) };
+
+	VkPipelineLayoutCreateInfo layoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstants
+	};
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device.getDevice(), &layoutInfo, nullptr, &pipelineLayout), "failed to create resolve pipeline layout!");
+
+	pipeline = Core::Shader::createComputePipeline(device, cache, pipelineLayout, RESOLVE_SHADER_PATH, "resolveMain");
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../vulkan_core/Device.h"
+#include "../vulkan_core/Descriptors.h"
+#include <string>
+#include <vector>
+
+#define RESOLVE_SHADER_PATH "shaders/resolve.slang.spv"
+#define RESOLVE_GROUP_SIZE 8U //numthreads of resolveMain in shaders/resolve.slang
+
+namespace RayTracing {
+	enum ResolveFlags : uint32_t {
+		eResolveTonemap = 1, //RESOLVE_TONEMAP
+		eResolveSRGB = 2 //RESOLVE_SRGB
+	};
+
+	struct ResolveConstants {
+		uint32_t width;
+		uint32_t height;
+		float exposure;
+		uint32_t flags;
+	};
+
+	/*
+	 * Compute pass that turns the accumulated radiance into the display image. Both images stay in the
+	 * general layout, the caller takes care of the barriers around record().
+	 */
+	class ResolvePass {
+	public:
+		ResolvePass(Core::Device& device, VkPipelineCache cache);
+		~ResolvePass();
+
+		ResolvePass(const ResolvePass&) = delete;
+		ResolvePass operator=(const ResolvePass&) = delete;
+
+		void setImages(VkImageView accumulation, VkImageView output);
+		void record(VkCommandBuffer buffer, const ResolveConstants& constants);
+	private:
+		void createDescriptorSet();
+		void createPipeline(VkPipelineCache cache);
+	private:
+		Core::Device& device;
+
+		std::unique_ptr<Core::DescriptorPool> pool;
+		std::unique_ptr<Core::DescriptorSetLayout> setLayout;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+	};
+}
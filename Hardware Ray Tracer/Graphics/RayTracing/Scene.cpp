@@ -1,88 +1,79 @@
 #include "Scene.h"
+#include "MeshCache.h"
+#include "ObjImporter.h"
+#include "LightSampling.h"
 
 #include <span>
+#include <algorithm>
+#include <thread>
+#include <glm/gtc/constants.hpp>
 
-namespace std {
-	template<>
-	struct hash<RayTracing::Vertex> {
-		size_t operator()(RayTracing::Vertex const& vert) const {
-			size_t seed = 0;
-			hashCombine(seed, vert.pos[0], vert.pos[1], vert.pos[2], 0);
-			return seed;
-		}
-	};
-}
-
-RayTracing::Scene::Scene(Core::Device& device) : device(device) {}
+RayTracing::Scene::Scene(Core::Device& device) : device(device), uploadManager(device) {}
 RayTracing::Scene::~Scene() {
-	vkDestroyAccelerationStructureKHR(device.getDevice(), tlasAccel.handle, nullptr);
-	vkDestroyBuffer(device.getDevice(), tlasAccel.buffer, nullptr);
-	vkFreeMemory(device.getDevice(), tlasAccel.memory, nullptr);
-
-	for (uint32_t i = 0; i < blasAccel.size(); i++) {
-		vkDestroyAccelerationStructureKHR(device.getDevice(), blasAccel[i].handle, nullptr);
-		vkDestroyBuffer(device.getDevice(), blasAccel[i].buffer, nullptr);
-		vkFreeMemory(device.getDevice(), blasAccel[i].memory, nullptr);
-	}
+	uploadManager.waitIdle();
+	destroyAccelerationStructure(tlasAccel);
+
+	for (uint32_t i = 0; i < blasAccel.size(); i++)
+		destroyAccelerationStructure(blasAccel[i]);
 }
 
+/*
+ * Loads a model from its .bmesh cache if it is still valid, otherwise the model is imported and the cache written
+ */
 void RayTracing::Scene::loadModel(std::string path) {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	
-	tinyobj::attrib_t attributes;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err;
-
-	if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &err, path.c_str())) {
-		std::cout << "[ERROR] Scene: " << err << std::endl;
-		throw std::runtime_error(err);
+	MeshCache cache;
+	if (cache.open(path)) {
+		meshes.push_back(Mesh{ device, uploadManager, cache.getVertices(), cache.getIndices(), cache.getMapping() });
+		return;
 	}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex{};
-			if (index.vertex_index >= 0) {
-				vertex.pos[0] = attributes.vertices[3 * index.vertex_index + 0];
-				vertex.pos[1] = -attributes.vertices[3 * index.vertex_index + 1];
-				vertex.pos[2] = attributes.vertices[3 * index.vertex_index + 2];
-			}
-
-			if (index.normal_index >= 0) {
-				vertex.normal[0] = attributes.normals[3 * index.normal_index + 0];
-				vertex.normal[1] = -attributes.normals[3 * index.normal_index + 1];
-				vertex.normal[2] = attributes.normals[3 * index.normal_index + 2];
-			}
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	parseModel(path, vertices, indices);
 
-			if (index.texcoord_index >= 0) {
-				vertex.uv[0] = attributes.texcoords[2 * index.texcoord_index + 0];
-				vertex.uv[1] = attributes.texcoords[2 * index.texcoord_index + 1];
-			}
+	if (!MeshCache::write(path, vertices, indices))
+		DEBUG("[WARNING] Scene: failed to write mesh cache " << MeshCache::cachePath(path));
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
+	meshes.push_back(Mesh{ device, uploadManager, std::move(vertices), std::move(indices) });
+}
 
-			indices.push_back(uniqueVertices[vertex]);
-		}
-	}
+/*
+ * Adds a mesh from memory, e.g. generated geometry, and returns its mesh id
+ */
+uint32_t RayTracing::Scene::createMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices) {
+	meshes.push_back(Mesh{ device, uploadManager, std::vector<Vertex>(vertices.begin(), vertices.end()), std::vector<uint32_t>(indices.begin(), indices.end()) });
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
 
-	meshes.push_back(Mesh{ device, vertices, indices });
+void RayTracing::Scene::parseModel(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	ObjImporter importer;
+	importer.load(path, vertices, indices);
 }
 
 void RayTracing::Scene::createInstance(uint32_t meshId, uint32_t materialId, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale) {
 	instances.push_back(MeshInstance(meshId, materialId, position, rotation, scale));
+	instanceDirtyFrames.push_back((1U << Core::SwapChain::MAX_FRAMES_IN_FLIGHT) - 1);
+	dirtyInstanceInfos.push_back(static_cast<uint32_t>(instances.size() - 1));
+	revision++;
+}
+
+void RayTracing::Scene::updateInstance(uint32_t instanceId, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale) {
+	instances[instanceId].setPosition(position);
+	instances[instanceId].setRotation(rotation);
+	instances[instanceId].setScale(scale);
+	instanceDirtyFrames[instanceId] = (1U << Core::SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+	revision++;
 }
 
 void RayTracing::Scene::createMaterial(glm::vec3 color, float metallic, float roughness, glm::vec3 emissiveColor, float emissionStrength) {
+	glm::vec3 emission = emissiveColor * emissionStrength;
 	materials.push_back(Material{
 		.color = {color.x, color.y, color.z},
 		.metallic = metallic,
-		.roughness = roughness
+		.roughness = roughness,
+		.emission = {emission.x, emission.y, emission.z}
 	});
+	revision++;
 }
 
 void RayTracing::Scene::createLight(glm::vec3 position, glm::vec3 color, float intensity) {
@@ -94,34 +85,65 @@ void RayTracing::Scene::createLight(glm::vec3 position, glm::vec3 color, float i
 			LightType::POINT
 		}
 	);
+	revision++;
 }
 
 
 void RayTracing::Scene::build() {
-	BUILD("SCENE", 0, 7, "Creating Bottom Level Acceleration Structure...");
-	createBottomAS();
-	BUILD("SCENE", 1, 7, "Creating TOP Level Acceleration Structure...");
-	createTopAS();
+	//the geometry has to be resident before the acceleration structures are built
+	uploadManager.waitIdle();
 
-	BUILD("SCENE", 2, 7, "Creating materials...");
-	createMaterials();
-	BUILD("SCENE", 3, 7, "Creating lights...");
-	createLights();
+	auto timed = [](float& milliseconds, auto function) {
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+	};
 
-	BUILD("SCENE", 4, 7, "Creating Sky...");
-	createSky();
+	BUILD("SCENE", 0, 9, "Creating Bottom Level Acceleration Structure...");
+	timed(buildTimings.bottomAS, [&] { createBottomAS(); });
+	BUILD("SCENE", 1, 9, "Creating TOP Level Acceleration Structure...");
+	timed(buildTimings.topAS, [&] { createTopAS(); });
+
+	BUILD("SCENE", 2, 9, "Creating materials...");
+	timed(buildTimings.materials, [&] { createMaterials(); });
+	BUILD("SCENE", 3, 9, "Creating lights...");
+	timed(buildTimings.lights, [&] { createLights(); });
+	BUILD("SCENE", 4, 9, "Creating light BVH...");
+	timed(buildTimings.lightBVH, [&] { prepareRendering(); });
+	BUILD("SCENE", 5, 9, "Gathering emissive triangles...");
+	timed(buildTimings.emitters, [&] { createEmitters(); });
+
+	BUILD("SCENE", 6, 9, "Creating Sky...");
+	timed(buildTimings.sky, [&] { createSky(); });
+
+	BUILD("SCENE", 7, 9, "Creating scene information...");
+	timed(buildTimings.sceneInformation, [&] {
+		createSceneInformation();
+		BUILD("SCENE", 8, 9, "Creating scene information buffer...");
+		createSceneInfoBuffer();
+	});
 
-	BUILD("SCENE", 5, 7, "Creating scene information...");
-	createSceneInformation();
-	BUILD("SCENE", 6, 7, "Creating scene information buffer...");
-	createSceneInfoBuffer();
+	timed(buildTimings.upload, [&] { uploadManager.waitIdle(); });
+	DEBUG("[INFO] SCENE: uploaded with " << uploadManager.getSubmitCount() << " submission(s)");
 
-	BUILD("SCENE", 7, 7, "Scene created!");
+	BUILD("SCENE", 9, 9, "Scene created!");
+	device.getAllocator().printStats();
 }
 
 void RayTracing::Scene::destroyInstance(uint32_t instanceID) {
 	instances[instanceID] = instances[instances.size() - 1];
 	instances.pop_back();
+	instanceDirtyFrames.pop_back();
+	if (instanceID < emitterOffsets.size()) {
+		emitterOffsets[instanceID] = emitterOffsets.back();
+		emitterOffsets.pop_back();
+	}
+
+	if (instanceID < instances.size()) {
+		instanceDirtyFrames[instanceID] = (1U << Core::SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+		dirtyInstanceInfos.push_back(instanceID);
+	}
+	revision++;
 }
 
 void RayTracing::Scene::unloadModel(uint32_t meshId) {}
@@ -132,9 +154,25 @@ void RayTracing::Scene::destroyLight(uint32_t lightId) {
 void RayTracing::Scene::destroyMaterial(uint32_t materialId) {
 }
 
+/*
+ * Builds the light BVH over all lights and uploads the flattened nodes, the shader walks it to pick
+ * lights by their estimated contribution at the shading point
+ */
 void RayTracing::Scene::prepareRendering() {
-	std::cout << "Not implemented!" << std::endl;
-	throw std::runtime_error("LBVH not implemented!");
+	std::vector<LightBounds> emitters;
+	emitters.reserve(lights.size());
+	for (const Light& light : lights)
+		emitters.push_back(lightBounds(light));
+
+	std::vector<LightBVHNode> nodes = buildLightBVH(emitters);
+	uint64_t size = nodes.size() * sizeof(LightBVHNode);
+	DEBUG("[INFO] SCENE: light BVH with " << nodes.size() << " nodes over " << lights.size() << " lights");
+
+	lightAccelerationStructures = std::make_unique<Core::Buffer>(
+		device, std::max<uint64_t>(size, sizeof(LightBVHNode)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+	);
+
+	stageInformation(nodes.data(), size, lightAccelerationStructures->getBuffer());
 }
 
 void RayTracing::Scene::primitiveToGeometry(const Mesh& mesh, VkAccelerationStructureGeometryKHR& geometry, VkAccelerationStructureBuildRangeInfoKHR& rangeInfo) {
@@ -160,154 +198,394 @@ void RayTracing::Scene::primitiveToGeometry(const Mesh& mesh, VkAccelerationStru
 	rangeInfo = VkAccelerationStructureBuildRangeInfoKHR{ .primitiveCount = triangeCount };
 }
 
+/*
+ * Builds all bottom level acceleration structures in batches. The scratch memory of every build
+ * is sub-allocated from a single arena, a batch ends once the arena is exhausted and the next batch
+ * reuses it after a barrier. All batches are submitted together and waited on with one fence.
+ * With compaction enabled, every batch also writes the compacted sizes of its structures into one query pool.
+ */
 void RayTracing::Scene::createBottomAS() {
+	if (meshes.empty()) return;
+
+	auto alignUp = [](auto value, size_t alignment) noexcept { return ((value + alignment - 1) & ~(alignment - 1)); };
+	const VkDeviceSize scratchAlignment = device.getAccelProperties()->minAccelerationStructureScratchOffsetAlignment;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
 	blasAccel.resize(meshes.size());
 
+	VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+	if (compactBLAS)
+		flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+
+	std::vector<VkAccelerationStructureGeometryKHR> geometries(meshes.size());
+	std::vector<VkAccelerationStructureBuildRangeInfoKHR> rangeInfos(meshes.size());
+	std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(meshes.size());
+	std::vector<VkDeviceSize> scratchSizes(meshes.size());
+	std::vector<VkDeviceSize> buildSizes(meshes.size());
+	std::vector<VkAccelerationStructureKHR> handles(meshes.size());
+
+	VkDeviceSize totalScratchSize = 0;
+	VkDeviceSize maxScratchSize = 0;
+	uint64_t triangleCount = 0;
+
 	for (uint32_t i = 0; i < meshes.size(); i++) {
-		VkAccelerationStructureGeometryKHR asGeometry{};
-		VkAccelerationStructureBuildRangeInfoKHR asBuildRangeInfo{};
+		primitiveToGeometry(meshes[i], geometries[i], rangeInfos[i]);
+
+		buildInfos[i] = VkAccelerationStructureBuildGeometryInfoKHR{
+			.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+			.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+			.flags = flags,
+			.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+			.geometryCount = 1,
+			.pGeometries = &geometries[i]
+		};
+
+		VkAccelerationStructureBuildSizesInfoKHR asBuildSize{ .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR };
+		device.dispatch().vkGetAccelerationStructureBuildSizesKHR(device.getDevice(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfos[i], &rangeInfos[i].primitiveCount, &asBuildSize);
 
-		primitiveToGeometry(meshes[i], asGeometry, asBuildRangeInfo);
+		createAccelerationStructureBuffer(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, blasAccel[i], asBuildSize.accelerationStructureSize);
+		buildInfos[i].dstAccelerationStructure = blasAccel[i].handle;
+		handles[i] = blasAccel[i].handle;
+		buildSizes[i] = asBuildSize.accelerationStructureSize;
 
-		createAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, blasAccel[i], asGeometry, asBuildRangeInfo, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+		scratchSizes[i] = alignUp(asBuildSize.buildScratchSize, scratchAlignment);
+		totalScratchSize += scratchSizes[i];
+		maxScratchSize = std::max(maxScratchSize, scratchSizes[i]);
+		triangleCount += rangeInfos[i].primitiveCount;
 	}
-}
 
-void RayTracing::Scene::createTopAS() {
-	std::vector<VkAccelerationStructureInstanceKHR> tlasInstances;
-	tlasInstances.reserve(instances.size());
+	//the arena never exceeds the budget unless a single mesh needs more than that on its own
+	VkDeviceSize arenaSize = std::max(maxScratchSize, std::min(totalScratchSize, static_cast<VkDeviceSize>(BLAS_SCRATCH_BUDGET)));
 
-	for (uint32_t i = 0; i < instances.size(); i++) {
-		uint32_t meshId = instances[i].getMeshId();
-
-		VkAccelerationStructureInstanceKHR asInstance{
-			.transform = instances[i].getTransformation(),
-			.instanceCustomIndex = meshId,
-			.mask = 0xFF,
-			.instanceShaderBindingTableRecordOffset = 0,
-			.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV,
-			.accelerationStructureReference = blasAccel[meshId].address,
+	Core::Buffer scratchArena{
+		device,
+		arenaSize + scratchAlignment,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	};
+	VkDeviceAddress scratchAddress = alignUp(scratchArena.getAddress(), scratchAlignment);
+
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	if (compactBLAS) {
+		VkQueryPoolCreateInfo queryPoolInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+			.queryCount = static_cast<uint32_t>(meshes.size())
 		};
-		tlasInstances.emplace_back(asInstance);
+
+		VK_CHECK_RESULT(vkCreateQueryPool(device.getDevice(), &queryPoolInfo, nullptr, &queryPool), "failed to create query pool!");
 	}
 
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> pRangeInfos(meshes.size());
+
+	uint32_t first = 0;
+	while (first < meshes.size()) {
+		uint32_t last = first;
+		VkDeviceSize offset = 0;
+
+		while (last < meshes.size() && offset + scratchSizes[last] <= arenaSize) {
+			buildInfos[last].scratchData = { .deviceAddress = scratchAddress + offset };
+			pRangeInfos[last] = &rangeInfos[last];
+			offset += scratchSizes[last];
+			last++;
+		}
+
+		VkCommandBuffer cmd = device.beginSingleTimeCommands();
+
+		if (commandBuffers.empty() && queryPool != VK_NULL_HANDLE)
+			vkCmdResetQueryPool(cmd, queryPool, 0, static_cast<uint32_t>(meshes.size()));
+
+		if (!commandBuffers.empty()) {
+			//the previous batch has to finish before its scratch memory is reused
+			VkMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+				.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR
+			};
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+		}
+
+		device.dispatch().vkCmdBuildAccelerationStructuresKHR(cmd, last - first, &buildInfos[first], &pRangeInfos[first]);
+
+		if (queryPool != VK_NULL_HANDLE) {
+			//the compacted size is only known once the build has finished
+			VkMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+				.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR
+			};
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+			device.dispatch().vkCmdWriteAccelerationStructuresPropertiesKHR(cmd, last - first, &handles[first], VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, first);
+		}
+
+		commandBuffers.push_back(cmd);
+
+		first = last;
+	}
+
+	size_t batchCount = commandBuffers.size();
+	device.endSingleTimeCommands(commandBuffers);
+
+	float duration = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+	BENCHMARK("BLAS", meshes.size() << " mesh(es), " << triangleCount << " triangles, " << batchCount << " batch(es), " << arenaSize / 1024 << " KiB scratch: " << duration << " ms");
+
+	if (queryPool != VK_NULL_HANDLE) {
+		compactBottomAS(queryPool, buildSizes);
+		vkDestroyQueryPool(device.getDevice(), queryPool, nullptr);
+	}
+}
+
+/*
+ * Copies every bottom level acceleration structure into a buffer of its compacted size and frees the original.
+ * Has to run before the top level acceleration structure is built, so the instances reference the compacted copies.
+ */
+void RayTracing::Scene::compactBottomAS(VkQueryPool queryPool, const std::vector<VkDeviceSize>& buildSizes) {
+	auto start = std::chrono::high_resolution_clock::now();
+	uint32_t count = static_cast<uint32_t>(blasAccel.size());
+
+	std::vector<VkDeviceSize> compactedSizes(count);
+	VK_CHECK_RESULT(vkGetQueryPoolResults(device.getDevice(), queryPool, 0, count, sizeof(VkDeviceSize) * count, compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT), "failed to read compacted acceleration structure sizes!");
+
+	std::vector<AccelerationStructure> compacted(count);
 	VkCommandBuffer cmd = device.beginSingleTimeCommands();
 
-	constexpr size_t instanceAlignment = 16;
+	for (uint32_t i = 0; i < count; i++) {
+		createAccelerationStructureBuffer(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compacted[i], compactedSizes[i]);
 
-	Core::Buffer stagingBuffer{
-		device,
-		std::span<VkAccelerationStructureInstanceKHR const>(tlasInstances).size_bytes(),
-		VK_BUFFER_USAGE_2_TRANSFER_SRC_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		instanceAlignment
-	};
+		VkCopyAccelerationStructureInfoKHR copyInfo{
+			.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR,
+			.src = blasAccel[i].handle,
+			.dst = compacted[i].handle,
+			.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR
+		};
+		device.dispatch().vkCmdCopyAccelerationStructureKHR(cmd, &copyInfo);
+	}
 
-	Core::Buffer tlasInstanceBuffer{
-		device,
-		std::span<VkAccelerationStructureInstanceKHR const>(tlasInstances).size_bytes(),
-		VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		instanceAlignment
-	};
+	device.endSingleTimeCommands(cmd);
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer(tlasInstances.data());
+	VkDeviceSize totalBefore = 0;
+	VkDeviceSize totalAfter = 0;
 
-	VkBufferCopy2 copyRegionInfo{
-		.sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2,
-		.srcOffset = 0,
-		.dstOffset = 0,
-		.size = std::span<VkAccelerationStructureInstanceKHR const>(tlasInstances).size_bytes()
-	};
+	for (uint32_t i = 0; i < count; i++) {
+		DEBUG("[INFO] BLAS Compaction: mesh " << i << ": " << buildSizes[i] << " -> " << compactedSizes[i] << " bytes");
+		totalBefore += buildSizes[i];
+		totalAfter += compactedSizes[i];
 
-	VkCopyBufferInfo2 copyBufferInfo{
-		.sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
-		.srcBuffer = stagingBuffer.getBuffer(),
-		.dstBuffer = tlasInstanceBuffer.getBuffer(),
-		.regionCount = 1,
-		.pRegions = &copyRegionInfo
-	};
+		destroyAccelerationStructure(blasAccel[i]);
+		blasAccel[i] = compacted[i];
+	}
 
-	vkCmdCopyBuffer2(cmd, &copyBufferInfo);
+	float duration = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+	BENCHMARK("BLAS Compaction", totalBefore << " -> " << totalAfter << " bytes (" << (totalBefore > 0 ? 100.0 * totalAfter / totalBefore : 100.0) << "%): " << duration << " ms");
+}
 
+void RayTracing::Scene::createTopAS() {
+	createTopASStorage(std::max(static_cast<uint32_t>(instances.size()), 1U));
+
+	for (uint32_t frame = 0; frame < tlasInstanceBuffers.size(); frame++) {
+		for (uint32_t i = 0; i < instances.size(); i++)
+			writeInstance(i, frame);
+	}
+	std::fill(instanceDirtyFrames.begin(), instanceDirtyFrames.end(), 0);
+
+	VkCommandBuffer cmd = device.beginSingleTimeCommands();
+	recordTopASBuild(cmd, 0, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR);
 	device.endSingleTimeCommands(cmd);
+}
 
-	{
-		VkAccelerationStructureGeometryKHR asGeometry{};
-		VkAccelerationStructureBuildRangeInfoKHR asBuildRangeInfo{};
+/*
+ * Records the per frame update of the top level acceleration structure into the frame command buffer.
+ * Only instances that changed since this frame slot was last used are written into its instance buffer.
+ * The structure is refit as long as the instance count stays the same and rebuilt after TLAS_MAX_REFITS refits
+ * or once instances were added or removed. Returns true if the handle changed and the descriptors have to be rewritten.
+ */
+bool RayTracing::Scene::updateTopAS(VkCommandBuffer cmd, uint32_t frameIndex) {
+	uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+	bool handleChanged = false;
+
+	if (instanceCount > tlasInstanceCapacity) {
+		//the instance buffers of the other frame in flight may still be read, so growing has to wait for the device
+		vkDeviceWaitIdle(device.getDevice());
+
+		createTopASStorage(std::max(instanceCount, tlasInstanceCapacity * 2));
+		createSceneInformation();
+		createSceneInfoBuffer();
+		uploadManager.waitIdle();
+
+		std::fill(instanceDirtyFrames.begin(), instanceDirtyFrames.end(), (1U << Core::SwapChain::MAX_FRAMES_IN_FLIGHT) - 1);
+		handleChanged = true;
+	}
 
-		VkAccelerationStructureGeometryInstancesDataKHR geometryInstances{
-				.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
-				.data = {.deviceAddress = tlasInstanceBuffer.getAddress()}
-		};
+	uint32_t frameBit = 1U << frameIndex;
+	bool instancesWritten = false;
 
-		asGeometry = {
-			.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
-			.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
-			.geometry = {.instances = geometryInstances }
-		};
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		if (instanceDirtyFrames[i] & frameBit) {
+			writeInstance(i, frameIndex);
+			instanceDirtyFrames[i] &= ~frameBit;
+			instancesWritten = true;
+		}
+	}
+
+	bool topologyChanged = handleChanged || instanceCount != tlasInstanceCount;
+	if (!instancesWritten && !topologyChanged && dirtyInstanceInfos.empty())
+		return false;
+
+	//the previous frame may still trace against the structure and read the instance information
+	VkMemoryBarrier preBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_SHADER_READ_BIT,
+		.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_TRANSFER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &preBarrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+	for (uint32_t instanceId : dirtyInstanceInfos) {
+		if (instanceId >= instanceCount) continue;
 
-		asBuildRangeInfo = { .primitiveCount = static_cast<uint32_t>(instances.size()) };
+		InstanceInfo info = getInstanceInfo(instanceId);
+		vkCmdUpdateBuffer(cmd, instanceBuffer->getBuffer(), sizeof(InstanceInfo) * instanceId, sizeof(InstanceInfo), &info);
+	}
+	dirtyInstanceInfos.clear();
 
-		createAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, tlasAccel, asGeometry, asBuildRangeInfo, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+	if (instancesWritten || topologyChanged) {
+		bool rebuild = topologyChanged || tlasRefitCount >= TLAS_MAX_REFITS;
+		recordTopASBuild(cmd, frameIndex, rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR);
 	}
+
+	VkMemoryBarrier postBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_SHADER_READ_BIT
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &postBarrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+	return handleChanged;
 }
-void RayTracing::Scene::createAccelerationStructure(VkAccelerationStructureTypeKHR asType,
-	AccelerationStructure& accelStructure,
-	VkAccelerationStructureGeometryKHR& asGeometry,
-	VkAccelerationStructureBuildRangeInfoKHR& asBuildRangeInfo,
-	VkBuildAccelerationStructureFlagsKHR flags) {
+
+/*
+ * Creates the top level acceleration structure for up to capacity instances, its persistent scratch buffer
+ * and one persistently mapped instance buffer per frame in flight. The scratch buffer covers builds and refits.
+ */
+void RayTracing::Scene::createTopASStorage(uint32_t capacity) {
 	auto alignUp = [](auto value, size_t alignment) noexcept { return ((value + alignment - 1) & ~(alignment - 1)); };
+	constexpr size_t instanceAlignment = 16;
+
+	tlasInstanceCapacity = capacity;
+	tlasInstanceBuffers.resize(Core::SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+	for (uint32_t i = 0; i < tlasInstanceBuffers.size(); i++) {
+		tlasInstanceBuffers[i] = std::make_unique<Core::Buffer>(
+			device,
+			sizeof(VkAccelerationStructureInstanceKHR) * capacity,
+			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			instanceAlignment
+		);
+
+		tlasInstanceBuffers[i]->map();
+	}
+
+	VkAccelerationStructureGeometryKHR asGeometry{
+		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+		.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+		.geometry = {.instances = {.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR } }
+	};
 
 	VkAccelerationStructureBuildGeometryInfoKHR asBuildInfo{
 		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
-		.type = asType,
-		.flags = flags,
+		.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+		.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
 		.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
 		.geometryCount = 1,
 		.pGeometries = &asGeometry
 	};
 
-	std::vector<uint32_t> maxPrimCount(1);
-	maxPrimCount[0] = asBuildRangeInfo.primitiveCount;
-
 	VkAccelerationStructureBuildSizesInfoKHR asBuildSize{ .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR };
-	vkGetAccelerationStructureBuildSizesKHR(device.getDevice(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &asBuildInfo, maxPrimCount.data(), &asBuildSize);
+	device.dispatch().vkGetAccelerationStructureBuildSizesKHR(device.getDevice(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &asBuildInfo, &capacity, &asBuildSize);
 
-	VkDeviceSize scratchSize = alignUp(asBuildSize.buildScratchSize, device.getAccelProperties()->minAccelerationStructureScratchOffsetAlignment);
+	destroyAccelerationStructure(tlasAccel);
+	createAccelerationStructureBuffer(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, tlasAccel, asBuildSize.accelerationStructureSize);
 
-	Core::Buffer scratchBuffer{
+	VkDeviceSize scratchAlignment = device.getAccelProperties()->minAccelerationStructureScratchOffsetAlignment;
+	tlasScratchBuffer = std::make_unique<Core::Buffer>(
 		device,
-		asBuildSize.buildScratchSize,
+		std::max(asBuildSize.buildScratchSize, asBuildSize.updateScratchSize) + scratchAlignment,
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-		device.getAccelProperties()->minAccelerationStructureScratchOffsetAlignment
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	);
+	tlasScratchAddress = alignUp(tlasScratchBuffer->getAddress(), scratchAlignment);
+}
+
+void RayTracing::Scene::recordTopASBuild(VkCommandBuffer cmd, uint32_t frameIndex, VkBuildAccelerationStructureModeKHR mode) {
+	VkAccelerationStructureGeometryInstancesDataKHR geometryInstances{
+		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
+		.data = {.deviceAddress = tlasInstanceBuffers[frameIndex]->getAddress() }
+	};
+
+	VkAccelerationStructureGeometryKHR asGeometry{
+		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+		.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+		.geometry = {.instances = geometryInstances }
+	};
+
+	VkAccelerationStructureBuildGeometryInfoKHR asBuildInfo{
+		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+		.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+		.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
+		.mode = mode,
+		.srcAccelerationStructure = mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR ? tlasAccel.handle : VK_NULL_HANDLE,
+		.dstAccelerationStructure = tlasAccel.handle,
+		.geometryCount = 1,
+		.pGeometries = &asGeometry,
+		.scratchData = {.deviceAddress = tlasScratchAddress }
+	};
+
+	VkAccelerationStructureBuildRangeInfoKHR asBuildRangeInfo{ .primitiveCount = static_cast<uint32_t>(instances.size()) };
+	VkAccelerationStructureBuildRangeInfoKHR* pBuildRangeInfo = &asBuildRangeInfo;
+	device.dispatch().vkCmdBuildAccelerationStructuresKHR(cmd, 1, &asBuildInfo, &pBuildRangeInfo);
+
+	tlasInstanceCount = asBuildRangeInfo.primitiveCount;
+	tlasRefitCount = mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR ? tlasRefitCount + 1 : 0;
+}
+
+void RayTracing::Scene::writeInstance(uint32_t instanceId, uint32_t frameIndex) {
+	uint32_t meshId = instances[instanceId].getMeshId();
+
+	VkAccelerationStructureInstanceKHR asInstance{
+		.transform = instances[instanceId].getTransformation(),
+		.instanceCustomIndex = meshId,
+		.mask = 0xFF,
+		.instanceShaderBindingTableRecordOffset = 0,
+		.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV,
+		.accelerationStructureReference = blasAccel[meshId].address,
 	};
 
-	device.createBuffer(asBuildSize.accelerationStructureSize, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &accelStructure.buffer, &accelStructure.memory);
+	tlasInstanceBuffers[frameIndex]->writeToBuffer(&asInstance, sizeof(VkAccelerationStructureInstanceKHR), sizeof(VkAccelerationStructureInstanceKHR) * instanceId);
+}
+
+void RayTracing::Scene::createAccelerationStructureBuffer(VkAccelerationStructureTypeKHR asType, AccelerationStructure& accelStructure, VkDeviceSize size) {
+	device.createBuffer(size, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &accelStructure.buffer, &accelStructure.allocation);
 
 	VkAccelerationStructureCreateInfoKHR createInfo{
 		.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
 		.buffer = accelStructure.buffer,
-		.size = asBuildSize.accelerationStructureSize,
+		.size = size,
 		.type = asType,
 	};
 
-	vkCreateAccelerationStructureKHR(device.getDevice(), &createInfo, nullptr, &accelStructure.handle);
-
-	VkCommandBuffer cmd = device.beginSingleTimeCommands();
-	asBuildInfo.dstAccelerationStructure = accelStructure.handle;
-	asBuildInfo.scratchData = { .deviceAddress = scratchBuffer.getAddress() };
-
-	VkAccelerationStructureBuildRangeInfoKHR* pBuildRangeInfo = &asBuildRangeInfo;
-	vkCmdBuildAccelerationStructuresKHR(cmd, 1, &asBuildInfo, &pBuildRangeInfo);
+	VK_CHECK_RESULT(device.dispatch().vkCreateAccelerationStructureKHR(device.getDevice(), &createInfo, nullptr, &accelStructure.handle), "failed to create acceleration structure!");
 
 	VkAccelerationStructureDeviceAddressInfoKHR info{ .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
 													.accelerationStructure = accelStructure.handle };
-	accelStructure.address = vkGetAccelerationStructureDeviceAddressKHR(device.getDevice(), &info);
+	accelStructure.address = device.dispatch().vkGetAccelerationStructureDeviceAddressKHR(device.getDevice(), &info);
+}
 
-	device.endSingleTimeCommands(cmd);
+void RayTracing::Scene::destroyAccelerationStructure(AccelerationStructure& accelStructure) {
+	device.dispatch().vkDestroyAccelerationStructureKHR(device.getDevice(), accelStructure.handle, nullptr);
+	device.destroyBuffer(accelStructure.buffer, accelStructure.allocation);
 }
 
 void RayTracing::Scene::createMaterials() {
@@ -323,11 +601,122 @@ void RayTracing::Scene::createMaterials() {
 void RayTracing::Scene::createLights() {
 	uint64_t size = lights.size() * sizeof(Light);
 
+	//scenes lit only by emissive meshes have no lights, the buffers still need an address
 	lightBuffer = std::make_unique<Core::Buffer>(
-		device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+		device, std::max<uint64_t>(size, sizeof(Light)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
 	);
 
 	stageInformation(lights.data(), size, lightBuffer->getBuffer());
+
+	//lights are picked by power in the shader, so the shadow rays per hit do not grow with the light count
+	std::vector<LightAliasEntry> aliasTable = buildLightAliasTable(lights);
+	uint64_t aliasSize = aliasTable.size() * sizeof(LightAliasEntry);
+
+	lightAliasBuffer = std::make_unique<Core::Buffer>(
+		device, std::max<uint64_t>(aliasSize, sizeof(LightAliasEntry)), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+	);
+
+	stageInformation(aliasTable.data(), aliasSize, lightAliasBuffer->getBuffer());
+}
+
+/*
+ * Gathers the triangles of every instance with an emissive material into one world space list and builds an
+ * alias table over their power, area times radiance. Each thread transforms its own range of triangles.
+ * Emitters are two sided, imported meshes do not have a reliable winding.
+ */
+void RayTracing::Scene::createEmitters() {
+	struct EmissiveInstance {
+		uint32_t instance;
+		uint64_t first; //index of its first triangle in the emitter list
+	};
+
+	std::vector<EmissiveInstance> emissive;
+	emitterOffsets.assign(instances.size(), NO_EMITTER);
+	emitterCount = 0;
+
+	for (uint32_t i = 0; i < instances.size(); i++) {
+		const float* emission = materials[instances[i].getMaterialId()].emission;
+		if (emission[0] <= 0.f && emission[1] <= 0.f && emission[2] <= 0.f)
+			continue;
+
+		uint64_t triangles = meshes[instances[i].getMeshId()].indices.size() / 3;
+		if (emitterCount + triangles >= NO_EMITTER) {
+			DEBUG("[WARNING] SCENE: more than " << NO_EMITTER << " emissive triangles, the remaining instances do not emit");
+			break;
+		}
+
+		emissive.push_back({ i, emitterCount });
+		emitterOffsets[i] = static_cast<uint32_t>(emitterCount);
+		emitterCount += triangles;
+	}
+
+	std::vector<EmissiveTriangle> emitters(emitterCount);
+	std::vector<float> power(emitterCount);
+
+	auto gather = [&](uint64_t begin, uint64_t end) {
+		//the last instance that starts at or before begin
+		size_t slot = std::upper_bound(emissive.begin(), emissive.end(), begin, [](uint64_t index, const EmissiveInstance& instance) { return index < instance.first; }) - emissive.begin() - 1;
+
+		for (uint64_t index = begin; index < end; index++) {
+			while (slot + 1 < emissive.size() && emissive[slot + 1].first <= index)
+				slot++;
+
+			MeshInstance& instance = instances[emissive[slot].instance];
+			const Mesh& mesh = meshes[instance.getMeshId()];
+			VkTransformMatrixKHR transform = instance.getTransformation();
+			uint64_t triangle = index - emissive[slot].first;
+
+			glm::vec3 corners[3];
+			for (int c = 0; c < 3; c++) {
+				const float* p = mesh.vertices[mesh.indices[triangle * 3 + c]].pos;
+				for (int row = 0; row < 3; row++)
+					corners[c][row] = transform.matrix[row][0] * p[0] + transform.matrix[row][1] * p[1] + transform.matrix[row][2] * p[2] + transform.matrix[row][3];
+			}
+
+			EmissiveTriangle& emitter = emitters[index];
+			glm::vec3 edges[2] = { corners[1] - corners[0], corners[2] - corners[0] };
+			for (int row = 0; row < 3; row++) {
+				emitter.position[row] = corners[0][row];
+				emitter.edges[0][row] = edges[0][row];
+				emitter.edges[1][row] = edges[1][row];
+			}
+			emitter.materialId = instance.getMaterialId();
+
+			const float* emission = materials[emitter.materialId].emission;
+			float luminance = 0.2126f * emission[0] + 0.7152f * emission[1] + 0.0722f * emission[2];
+			power[index] = luminance * 0.5f * glm::length(glm::cross(edges[0], edges[1]));
+		}
+	};
+
+	uint32_t threadCount = static_cast<uint32_t>(std::clamp<uint64_t>(emitterCount / EMITTER_MIN_BATCH, 1, std::max(std::thread::hardware_concurrency(), 1U)));
+	uint64_t batch = (emitterCount + threadCount - 1) / threadCount;
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; i++)
+		workers.emplace_back(gather, i * batch, std::min(emitterCount, (i + 1) * batch));
+	gather(0, std::min(emitterCount, batch));
+	for (auto& worker : workers)
+		worker.join();
+
+	std::vector<LightAliasEntry> aliasTable = buildAliasTable(power);
+
+	//a two sided lambertian emitter sends 2 pi L A, a point light 4 pi I
+	double emitterPower = 0.0, pointPower = 0.0;
+	for (float p : power) emitterPower += 2.0 * glm::pi<double>() * p;
+	for (const Light& light : lights) pointPower += 4.0 * glm::pi<double>() * lightPower(light);
+	emitterProbability = emitterPower > 0.0 ? static_cast<float>(emitterPower / (emitterPower + pointPower)) : 0.f;
+
+	DEBUG("[INFO] SCENE: " << emitterCount << " emissive triangles in " << emissive.size() << " instance(s), sampled with probability " << emitterProbability);
+
+	emitterBuffer = std::make_unique<Core::Buffer>(
+		device, std::max<uint64_t>(emitterCount, 1) * sizeof(EmissiveTriangle), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+	);
+	emitterAliasBuffer = std::make_unique<Core::Buffer>(
+		device, std::max<uint64_t>(emitterCount, 1) * sizeof(LightAliasEntry), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+	);
+
+	stageInformation(emitters.data(), emitterCount * sizeof(EmissiveTriangle), emitterBuffer->getBuffer());
+	stageInformation(aliasTable.data(), emitterCount * sizeof(LightAliasEntry), emitterAliasBuffer->getBuffer());
 }
 
 void RayTracing::Scene::createSky() {
@@ -355,18 +744,13 @@ void RayTracing::Scene::createSky() {
 }
 
 void RayTracing::Scene::createSceneInformation() {
+	//sized like the instance buffers of the top level acceleration structure, so instances can be added in place
 	std::vector<InstanceInfo> instanceInfo;
-	instanceInfo.resize(instances.size());
+	instanceInfo.resize(tlasInstanceCapacity);
 
-	for (uint32_t i = 0; i < instances.size(); i++) {
-		uint32_t meshId = instances[i].getMeshId();
-		
-		instanceInfo[i] = {
-			.vertexAddress = meshes[meshId].vertexBuffer->getAddress(),
-			.indexAddress = meshes[meshId].indexBuffer->getAddress(),
-			.materialId = instances[i].getMaterialId()
-		};
-	}
+	for (uint32_t i = 0; i < instances.size(); i++)
+		instanceInfo[i] = getInstanceInfo(i);
+	dirtyInstanceInfos.clear();
 
 	instanceBuffer = std::make_unique<Core::Buffer>(
 		device, sizeof(InstanceInfo) * instanceInfo.size(), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
@@ -385,6 +769,13 @@ void RayTracing::Scene::createSceneInfoBuffer() {
 		.lBuf = lightBuffer->getAddress(),
 		.lStride = sizeof(Light),
 		.lCount = lights.size(),
+		.laBuf = lightAliasBuffer->getAddress(),
+		.lbvhBuf = lightAccelerationStructures->getAddress(),
+
+		.eBuf = emitterBuffer->getAddress(),
+		.eaBuf = emitterAliasBuffer->getAddress(),
+		.eCount = emitterCount,
+		.eProbability = emitterProbability,
 
 		.vStride = sizeof(Vertex),
 
@@ -395,64 +786,58 @@ void RayTracing::Scene::createSceneInfoBuffer() {
 		.skyStride = sizeof(SkyInfo)
 	};
 
-	sceneInfoBuffer = std::make_unique<Core::Buffer>(
-		device, sizeof(SceneBufferInfo), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
-	);
+	//the pipeline keeps a descriptor to this buffer, so it is only created once and rewritten afterwards
+	if (!sceneInfoBuffer) {
+		sceneInfoBuffer = std::make_unique<Core::Buffer>(
+			device, sizeof(SceneBufferInfo), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+		);
+	}
 
 	stageInformation(&info, sizeof(SceneBufferInfo), sceneInfoBuffer->getBuffer());
 }
 
-void RayTracing::Scene::stageInformation(void* data, uint64_t size, VkBuffer dstBuffer) {
-	Core::Buffer stagingBuffer{
-		device,
-		size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	};
+RayTracing::InstanceInfo RayTracing::Scene::getInstanceInfo(uint32_t instanceId) {
+	uint32_t meshId = instances[instanceId].getMeshId();
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer(data);
-
-	device.copyBuffer(stagingBuffer.getBuffer(), dstBuffer, size);
+	return InstanceInfo{
+		.vertexAddress = meshes[meshId].vertexBuffer->getAddress(),
+		.indexAddress = meshes[meshId].indexBuffer->getAddress(),
+		.materialId = instances[instanceId].getMaterialId(),
+		.emitterOffset = instanceId < emitterOffsets.size() ? emitterOffsets[instanceId] : NO_EMITTER
+	};
 }
 
-RayTracing::Mesh::Mesh(Core::Device& device, std::vector<Vertex> vertices, std::vector<uint32_t> indices) : vertices(vertices), indices(indices) {
-	
-	{
-		vertexBuffer = std::make_unique<Core::Buffer>(
-			device, 
-			sizeof(Vertex) * vertices.size(), 
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
-		);
-		Core::Buffer stagingBuffer{ device, 
-			sizeof(Vertex) * vertices.size(), 
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
-
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+void RayTracing::Scene::stageInformation(void* data, uint64_t size, VkBuffer dstBuffer) {
+	uploadManager.uploadBuffer(dstBuffer, data, size);
+}
 
-		device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), sizeof(Vertex) * vertices.size());
-	}
-	{
-		indexBuffer = std::make_unique<Core::Buffer>(
-			device,
-			sizeof(uint32_t) * indices.size(),
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
-		);
-		Core::Buffer stagingBuffer{
-			device,
-			sizeof(uint32_t) * indices.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
+RayTracing::Mesh::Mesh(Core::Device& device, Core::UploadManager& uploadManager, std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices)
+	: vertexStorage(std::move(vertices)), indexStorage(std::move(indices)) {
+	this->vertices = vertexStorage;
+	this->indices = indexStorage;
+	upload(device, uploadManager);
+}
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
+//uploads straight from the mapping, which the mesh keeps open for the emitters gathered from its triangles
+RayTracing::Mesh::Mesh(Core::Device& device, Core::UploadManager& uploadManager, std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::shared_ptr<const Core::MappedFile> mapping)
+	: vertices(vertices), indices(indices), mapping(std::move(mapping)) {
+	upload(device, uploadManager);
+}
 
-		device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), sizeof(uint32_t) * indices.size());
-	}
+void RayTracing::Mesh::upload(Core::Device& device, Core::UploadManager& uploadManager) {
+	vertexBuffer = std::make_unique<Core::Buffer>(
+		device, 
+		sizeof(Vertex) * vertices.size(), 
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+	);
+	uploadManager.uploadBuffer(vertexBuffer->getBuffer(), vertices.data(), sizeof(Vertex) * vertices.size());
 
-}
+	indexBuffer = std::make_unique<Core::Buffer>(
+		device,
+		sizeof(uint32_t) * indices.size(),
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+	);
+	uploadManager.uploadBuffer(indexBuffer->getBuffer(), indices.data(), sizeof(uint32_t) * indices.size());
+}
\ No newline at end of file
@@ -5,23 +5,21 @@
 
 #include "../vulkan_core/Device.h"
 #include "../vulkan_core/Buffer.h"
+#include "../vulkan_core/SwapChain.h"
+#include "../vulkan_core/UploadManager.h"
 #include "../tinyobj/tiny_obj_loader.h"
+#include "../MappedFile.h"
 #include <unordered_map>
+#include <chrono>
+#include <span>
 #include <glm/glm.hpp>
 
-#define vkCmdBuildAccelerationStructuresKHR reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkCmdBuildAccelerationStructuresKHR"))
-#define vkCreateAccelerationStructureKHR reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkCreateAccelerationStructureKHR"))
-#define vkGetAccelerationStructureBuildSizesKHR reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkGetAccelerationStructureBuildSizesKHR"))
-#define vkDestroyAccelerationStructureKHR reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkDestroyAccelerationStructureKHR"))
-#define vkGetAccelerationStructureDeviceAddressKHR reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(device.getDevice(), "vkGetAccelerationStructureDeviceAddressKHR"))
 
 #define ROUGHNESS_ZERO 0.0001f
-
-template <typename T, typename... Rest>
-void hashCombine(std::size_t& seed, const T& v, const Rest&... rest) {
-	seed ^= std::hash<T>{}(v)+0x9e3779b9 + (seed << 6) + (seed >> 2);
-	(hashCombine(seed, rest), ...);
-};
+#define TLAS_MAX_REFITS 64U //refits of the top level acceleration structure before it is rebuilt to restore trace performance
+#define BLAS_SCRATCH_BUDGET (64ULL * 1024ULL * 1024ULL) //upper bound of the scratch arena shared by all bottom level builds
+#define NO_EMITTER UINT32_MAX //emitter offset of instances without emission
+#define EMITTER_MIN_BATCH 65536U //smallest number of emissive triangles gathered by one thread
 
 namespace RayTracing {
 
@@ -37,14 +35,24 @@ namespace RayTracing {
 		}
 	};
 
+	/*
+	 * The host geometry is a view of either the mesh's own arrays or a memory mapped .bmesh cache, which stays mapped
+	 * while the mesh exists. Moving a mesh keeps the view valid, the arrays move their storage along.
+	 */
 	struct Mesh {
-		Mesh(Core::Device& device, std::vector<Vertex> vertices, std::vector<uint32_t> indices);
+		Mesh(Core::Device& device, Core::UploadManager& uploadManager, std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices);
+		Mesh(Core::Device& device, Core::UploadManager& uploadManager, std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::shared_ptr<const Core::MappedFile> mapping);
 
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
+		std::span<const Vertex> vertices;
+		std::span<const uint32_t> indices;
+		std::vector<Vertex> vertexStorage; //empty for cached meshes
+		std::vector<uint32_t> indexStorage;
+		std::shared_ptr<const Core::MappedFile> mapping; //null for meshes that own their geometry
 
 		std::unique_ptr<Core::Buffer> vertexBuffer;
 		std::unique_ptr<Core::Buffer> indexBuffer;
+	private:
+		void upload(Core::Device& device, Core::UploadManager& uploadManager);
 	};
 
 	struct Material {
@@ -59,6 +67,7 @@ namespace RayTracing {
 		float sheenTint;
 		float clearCoat;
 		float clearCoatGloss;
+		float emission[3]; //emissive color times strength, the radiance leaving the surface
 	};
 
 	enum LightType : uint8_t {
@@ -74,10 +83,19 @@ namespace RayTracing {
 		LightType type;
 	};
 
+	/*
+	 * World space triangle of an emissive instance, gathered by Scene::build for light sampling
+	 */
+	struct EmissiveTriangle {
+		float position[3]; //first corner
+		float edges[2][3]; //second and third corner relative to the first
+		uint32_t materialId;
+	};
+
 	struct AccelerationStructure {
 		VkAccelerationStructureKHR handle;
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		Core::Allocation allocation;
 		VkDeviceAddress address;
 	};
 
@@ -85,6 +103,7 @@ namespace RayTracing {
 		uint64_t vertexAddress; //address of vertex buffer
 		uint64_t indexAddress; //address of index buffer
 		uint32_t materialId; //id of material
+		uint32_t emitterOffset; //first emissive triangle of the instance, NO_EMITTER without emission
 	};
 
 	struct SkyInfo {
@@ -110,6 +129,14 @@ namespace RayTracing {
 		uint64_t lBuf; //address of light buffer
 		uint64_t lStride; //byte stride of light
 		uint64_t lCount; //count of lights
+		uint64_t laBuf; //address of light alias table, one LightAliasEntry per light
+		uint64_t lbvhBuf; //address of light BVH nodes, root first
+
+		uint64_t eBuf; //address of emissive triangles
+		uint64_t eaBuf; //address of emissive triangle alias table
+		uint64_t eCount; //count of emissive triangles
+		float eProbability; //chance to sample an emissive triangle instead of a point light
+		float ePadding;
 
 		uint64_t vStride; //byte stride of vertices
 
@@ -120,13 +147,28 @@ namespace RayTracing {
 		uint64_t skyStride;
 	};
 
+	/*
+	 * Host times of the build phases in milliseconds, uploads are still in flight when a phase ends
+	 */
+	struct SceneBuildTimings {
+		float bottomAS = 0.f;
+		float topAS = 0.f;
+		float materials = 0.f;
+		float lights = 0.f;
+		float lightBVH = 0.f;
+		float emitters = 0.f;
+		float sky = 0.f;
+		float sceneInformation = 0.f;
+		float upload = 0.f; //waiting for the remaining uploads at the end of the build
+	};
+
 	struct LightBVHNode {
 		float bBoxMin[3];
 		float bBoxMax[3];
 		float totalFlux;
 		float coneAxis[3];
-		float coneAngle;
-		int childIndex;
+		float coneAngle; //theta_o around coneAxis
+		int childIndex; //first of two adjacent children, a leaf stores -(emitter + 1)
 	};
 
 	class Scene {
@@ -135,7 +177,10 @@ namespace RayTracing {
 		~Scene();
 
 		void loadModel(std::string path);
+		uint32_t createMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+		static void parseModel(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
 		void createInstance(uint32_t meshId, uint32_t materialId, glm::vec3 position = glm::vec3(), glm::vec3 rotation = glm::vec3(), glm::vec3 scale = glm::vec3(1, 1, 1));
+		void updateInstance(uint32_t instanceId, glm::vec3 position, glm::vec3 rotation = glm::vec3(), glm::vec3 scale = glm::vec3(1, 1, 1));
 		void createMaterial(glm::vec3 color, float metallic = 0.f, float roughness = 1.f, glm::vec3 emissiveColor = glm::vec3(), float emissionStrength = 0.f);
 		void createLight(glm::vec3 position, glm::vec3 color, float intensity);
 		void build();
@@ -146,9 +191,16 @@ namespace RayTracing {
 		void destroyMaterial(uint32_t materialId);
 
 		void prepareRendering();
+		bool updateTopAS(VkCommandBuffer cmd, uint32_t frameIndex);
+		void enableCompaction(bool enable) { compactBLAS = enable; }
 
 		inline AccelerationStructure getTlas() { return tlasAccel; }
 		inline std::unique_ptr<Core::Buffer>& getSceneInfoBuffer() { return sceneInfoBuffer; }
+		inline const SceneBuildTimings& getBuildTimings() { return buildTimings; }
+		inline uint32_t getInstanceCount() { return static_cast<uint32_t>(instances.size()); }
+		inline uint32_t getLightCount() { return static_cast<uint32_t>(lights.size()); }
+		inline uint64_t getEmitterCount() { return emitterCount; }
+		inline uint64_t getRevision() { return revision; }
 
 		Scene(const Scene&) = delete;
 		Scene operator=(Scene&) = delete;
@@ -158,37 +210,60 @@ namespace RayTracing {
 		void primitiveToGeometry(const Mesh& mesh, VkAccelerationStructureGeometryKHR& geometry, VkAccelerationStructureBuildRangeInfoKHR& rangeInfo);
 		void createBottomAS();
 		void createTopAS();
-		void createAccelerationStructure(VkAccelerationStructureTypeKHR asType,
-			AccelerationStructure& accelStructure,
-			VkAccelerationStructureGeometryKHR& asGeometry,
-			VkAccelerationStructureBuildRangeInfoKHR& asBuildRangeInfo,
-			VkBuildAccelerationStructureFlagsKHR flags);
+		void createTopASStorage(uint32_t capacity);
+		void recordTopASBuild(VkCommandBuffer cmd, uint32_t frameIndex, VkBuildAccelerationStructureModeKHR mode);
+		void writeInstance(uint32_t instanceId, uint32_t frameIndex);
+		void createAccelerationStructureBuffer(VkAccelerationStructureTypeKHR asType, AccelerationStructure& accelStructure, VkDeviceSize size);
+		void compactBottomAS(VkQueryPool queryPool, const std::vector<VkDeviceSize>& buildSizes);
+		void destroyAccelerationStructure(AccelerationStructure& accelStructure);
 
 		void createMaterials();
 		void createLights();
+		void createEmitters();
 		void createSky();
 		void createSceneInformation();
 		void createSceneInfoBuffer();
+		InstanceInfo getInstanceInfo(uint32_t instanceId);
 
 		void stageInformation(void* data, uint64_t size, VkBuffer dstBuffer);
 	private:
 		Core::Device& device;
+		Core::UploadManager uploadManager;
 
 		std::vector<Mesh> meshes;
 		std::vector<MeshInstance> instances;
 		std::vector<Material> materials;
 		std::vector<Light> lights;
 		std::vector<AccelerationStructure> blasAccel;
-		AccelerationStructure tlasAccel;
+		AccelerationStructure tlasAccel{};
+		bool compactBLAS = true;
+		SceneBuildTimings buildTimings;
+		uint64_t revision = 0; //bumped by every change of instances, materials or lights, accumulated images are stale after it
+
+		std::vector<std::unique_ptr<Core::Buffer>> tlasInstanceBuffers; //persistently mapped, one per frame in flight
+		std::unique_ptr<Core::Buffer> tlasScratchBuffer;
+		VkDeviceAddress tlasScratchAddress;
+		std::vector<uint32_t> instanceDirtyFrames; //bit n is set while the instance still has to be written for frame n
+		std::vector<uint32_t> dirtyInstanceInfos;
+		uint32_t tlasInstanceCapacity = 0;
+		uint32_t tlasInstanceCount = 0;
+		uint32_t tlasRefitCount = 0;
 
 		std::unique_ptr<Core::Buffer> materialBuffer;
 		std::unique_ptr<Core::Buffer> lightBuffer;
+		std::unique_ptr<Core::Buffer> lightAliasBuffer;
 		std::unique_ptr<Core::Buffer> vertexBuffer;
 		std::unique_ptr<Core::Buffer> indexBuffer;
 		std::unique_ptr<Core::Buffer> instanceBuffer;
 		std::unique_ptr<Core::Buffer> skyBuffer;
 		std::unique_ptr<Core::Buffer> sceneInfoBuffer;
 		std::unique_ptr<Core::Buffer> lightAccelerationStructures;
+
+		std::vector<uint32_t> emitterOffsets; //per instance, emitters keep the world space of the last build
+		uint64_t emitterCount = 0;
+		float emitterProbability = 0.f;
+		std::unique_ptr<Core::Buffer> emitterBuffer;
+		std::unique_ptr<Core::Buffer> emitterAliasBuffer;
 	};
 
 }
\ No newline at end of file
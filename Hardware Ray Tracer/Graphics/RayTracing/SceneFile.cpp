@@ -0,0 +1,84 @@
+#include "SceneFile.h"
+
+#include <fstream>
+#include <sstream>
+
+void RayTracing::SceneFile::load(const std::string& path, Scene& scene) {
+	std::ifstream file(path);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open scene " + path);
+
+	uint32_t meshCount = 0, materialCount = 0, lightCount = 0, instanceCount = 0;
+	std::string line;
+	uint32_t lineNumber = 0;
+
+	while (std::getline(file, line)) {
+		lineNumber++;
+
+		std::istringstream stream(line.substr(0, line.find('#')));
+		std::string command;
+		if (!(stream >> command))
+			continue;
+
+		auto error = [&](const std::string& message) {
+			return std::runtime_error(path + ":" + std::to_string(lineNumber) + ": " + message);
+		};
+		auto readVector = [&](glm::vec3& v) { return static_cast<bool>(stream >> v.x >> v.y >> v.z); };
+
+		if (command == "model") {
+			std::string modelPath;
+			if (!std::getline(stream >> std::ws, modelPath) || modelPath.empty())
+				throw error("model needs a path");
+
+			scene.loadModel(modelPath.substr(0, modelPath.find_last_not_of(" \t\r") + 1));
+			meshCount++;
+		}
+		else if (command == "material") {
+			glm::vec3 color, emissiveColor(0.f);
+			float metallic = 0.f, roughness = 1.f, emissionStrength = 0.f;
+			if (!readVector(color))
+				throw error("material needs a color");
+			if (stream >> metallic >> roughness && readVector(emissiveColor) && !(stream >> emissionStrength))
+				throw error("emissive material needs a strength");
+
+			scene.createMaterial(color, metallic, roughness, emissiveColor, emissionStrength);
+			materialCount++;
+		}
+		else if (command == "light") {
+			glm::vec3 position, color;
+			float intensity;
+			if (!readVector(position) || !readVector(color) || !(stream >> intensity))
+				throw error("light needs a position, a color and an intensity");
+
+			scene.createLight(position, color, intensity);
+			lightCount++;
+		}
+		else if (command == "instance") {
+			uint32_t mesh, material;
+			glm::vec3 position(0.f), rotation(0.f), scale(1.f);
+			if (!(stream >> mesh >> material))
+				throw error("instance needs a mesh and a material id");
+			if (mesh >= meshCount || material >= materialCount)
+				throw error("instance references a mesh or material that is not defined above it");
+
+			std::vector<float> transform;
+			for (float value; stream >> value;)
+				transform.push_back(value);
+			if (transform.size() % 3 != 0 || transform.size() > 9)
+				throw error("instance transform needs a position, rotation and scale with three components each");
+
+			glm::vec3* targets[3] = { &position, &rotation, &scale };
+			for (size_t i = 0; i < transform.size(); i++)
+				(*targets[i / 3])[static_cast<int>(i % 3)] = transform[i];
+
+			scene.createInstance(mesh, material, position, rotation, scale);
+			instanceCount++;
+		}
+		else throw error("unknown command \"" + command + "\"");
+	}
+
+	if (instanceCount == 0)
+		throw std::runtime_error("scene " + path + " has no instances");
+
+	DEBUG("[INFO] Scene File: " << path << " with " << meshCount << " model(s), " << materialCount << " material(s), " << lightCount << " light(s), " << instanceCount << " instance(s)");
+}
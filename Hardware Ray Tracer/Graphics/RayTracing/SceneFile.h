@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Scene.h"
+
+namespace RayTracing {
+	/*
+	 * Plain text scene description, one command per line and # starts a comment:
+	 *   model <path>                                           loads a mesh, meshes are numbered in load order
+	 *   material <r g b> [metallic] [roughness] [er eg eb strength]    the emissive color turns every instance into a light
+	 *   light <px py pz> <r g b> <intensity>
+	 *   instance <mesh> <material> [px py pz] [rx ry rz] [sx sy sz]
+	 * The commands feed the Scene directly, build() is left to the caller.
+	 */
+	class SceneFile {
+	public:
+		static void load(const std::string& path, Scene& scene);
+	};
+}
@@ -0,0 +1,256 @@
+#include "SceneGenerator.h"
+
+#include <cmath>
+#include <sstream>
+#include <glm/gtc/constants.hpp>
+
+#define TERRAIN_OCTAVES 5U
+#define TERRAIN_HEIGHT 0.3f //height of the terrain relative to its 2x2 extent
+
+namespace {
+	//splitmix64, small and identical on every compiler
+	struct Random {
+		uint64_t state;
+
+		uint64_t next() {
+			uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+		float uniform(float min = 0.f, float max = 1.f) {
+			return min + (max - min) * static_cast<float>(next() >> 40) * (1.f / 16777216.f);
+		}
+
+		glm::vec3 uniform(glm::vec3 min, glm::vec3 max) {
+			float x = uniform(min.x, max.x);
+			float y = uniform(min.y, max.y);
+			float z = uniform(min.z, max.z);
+			return glm::vec3(x, y, z);
+		}
+	};
+
+	float latticeValue(int32_t x, int32_t z, uint64_t seed) {
+		Random random{ seed ^ (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) ^ static_cast<uint32_t>(z) };
+		return random.uniform(-1.f, 1.f);
+	}
+
+	//fractal value noise in [-1, 1]
+	float terrainHeight(float x, float z, uint64_t seed) {
+		float height = 0.f, amplitude = 0.5f, frequency = 2.f;
+
+		for (uint32_t octave = 0; octave < TERRAIN_OCTAVES; octave++) {
+			float fx = x * frequency, fz = z * frequency;
+			int32_t ix = static_cast<int32_t>(std::floor(fx)), iz = static_cast<int32_t>(std::floor(fz));
+			float tx = fx - ix, tz = fz - iz;
+			tx = tx * tx * (3.f - 2.f * tx);
+			tz = tz * tz * (3.f - 2.f * tz);
+
+			uint64_t octaveSeed = seed + octave * 0x632BE59BD9B4E019ULL;
+			float a = latticeValue(ix, iz, octaveSeed), b = latticeValue(ix + 1, iz, octaveSeed);
+			float c = latticeValue(ix, iz + 1, octaveSeed), d = latticeValue(ix + 1, iz + 1, octaveSeed);
+
+			height += amplitude * glm::mix(glm::mix(a, b, tx), glm::mix(c, d, tx), tz);
+			amplitude *= 0.5f;
+			frequency *= 2.f;
+		}
+
+		return height;
+	}
+
+	RayTracing::Vertex makeVertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv) {
+		return RayTracing::Vertex{
+			{ position.x, position.y, position.z },
+			{ normal.x, normal.y, normal.z },
+			{ uv.x, uv.y }
+		};
+	}
+}
+
+void RayTracing::SceneGenerator::generate(const GeneratorSettings& settings, Scene& scene) {
+	if (settings.shapes.empty() || settings.instanceCount == 0 || settings.materialCount == 0)
+		throw std::runtime_error("the scene generator needs at least one shape, instance and material!");
+
+	auto start = std::chrono::high_resolution_clock::now();
+	Random random{ settings.seed };
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	uint64_t meshTriangles = 0;
+
+	for (GeneratedShape shape : settings.shapes) {
+		vertices.clear();
+		indices.clear();
+
+		switch (shape) {
+		case GeneratedShape::Sphere: sphere(settings.triangleCount, vertices, indices); break;
+		case GeneratedShape::Grid: grid(settings.triangleCount, vertices, indices); break;
+		case GeneratedShape::Terrain: terrain(settings.triangleCount, random.next(), vertices, indices); break;
+		}
+
+		scene.createMesh(vertices, indices);
+		meshTriangles += indices.size() / 3;
+	}
+	vertices = {};
+	indices = {};
+
+	for (uint32_t i = 0; i < settings.materialCount; i++) {
+		glm::vec3 color = random.uniform(glm::vec3(0.1f), glm::vec3(1.f));
+		float metallic = random.uniform() < 0.25f ? 1.f : 0.f;
+		float roughness = random.uniform(0.05f, 1.f);
+		float emission = i < settings.emissiveMaterialCount ? random.uniform(1.f, 8.f) : 0.f;
+		scene.createMaterial(color, metallic, roughness, color, emission);
+	}
+
+	//keep the instance density roughly constant, unit sized instances fill a cube growing with the cube root of their count
+	float extent = std::max(2.f, 2.f * std::cbrt(static_cast<float>(settings.instanceCount)));
+	uint32_t meshCount = static_cast<uint32_t>(settings.shapes.size());
+	uint64_t triangleCount = 0;
+
+	for (uint32_t i = 0; i < settings.instanceCount; i++) {
+		uint32_t mesh = static_cast<uint32_t>(random.next() % meshCount);
+		uint32_t material = static_cast<uint32_t>(random.next() % settings.materialCount);
+		glm::vec3 position = random.uniform(glm::vec3(-extent), glm::vec3(extent));
+		glm::vec3 rotation = random.uniform(glm::vec3(0.f), glm::vec3(glm::two_pi<float>()));
+		glm::vec3 scale = glm::vec3(random.uniform(0.5f, 1.5f));
+
+		scene.createInstance(mesh, material, position, rotation, scale);
+		triangleCount += meshTriangles / meshCount; //exact when every shape has the same count, close enough otherwise
+	}
+
+	for (uint32_t i = 0; i < settings.lightCount; i++) {
+		glm::vec3 position = random.uniform(glm::vec3(-1.2f * extent), glm::vec3(1.2f * extent));
+		glm::vec3 color = random.uniform(glm::vec3(0.2f), glm::vec3(1.f));
+		scene.createLight(position, color, random.uniform(1.f, 4.f));
+	}
+
+	float duration = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+	DEBUG("[INFO] Scene Generator: " << describe(settings) << " -> " << meshTriangles << " mesh triangles, ~" << triangleCount << " instanced triangles in " << duration << " ms");
+}
+
+std::string RayTracing::SceneGenerator::describe(const GeneratorSettings& settings) {
+	static const char* names[] = { "sphere", "grid", "terrain" };
+
+	std::ostringstream description;
+	description << "generated ";
+	for (size_t i = 0; i < settings.shapes.size(); i++)
+		description << (i > 0 ? "+" : "") << names[static_cast<uint8_t>(settings.shapes[i])];
+	description << ", " << settings.triangleCount << " triangles x " << settings.instanceCount << " instances, "
+		<< settings.materialCount << " materials (" << std::min(settings.emissiveMaterialCount, settings.materialCount) << " emissive), " << settings.lightCount << " lights, seed " << settings.seed;
+	return description.str();
+}
+
+/*
+ * Comma separated list of sphere, grid and terrain
+ */
+std::vector<RayTracing::GeneratedShape> RayTracing::SceneGenerator::parseShapes(const std::string& names) {
+	std::vector<GeneratedShape> shapes;
+	std::istringstream stream(names);
+
+	for (std::string name; std::getline(stream, name, ',');) {
+		if (name == "sphere") shapes.push_back(GeneratedShape::Sphere);
+		else if (name == "grid") shapes.push_back(GeneratedShape::Grid);
+		else if (name == "terrain") shapes.push_back(GeneratedShape::Terrain);
+		else throw std::runtime_error("unknown generated shape \"" + name + "\"");
+	}
+
+	return shapes;
+}
+
+/*
+ * UV sphere of radius one with twice as many segments as rings, the pole rows are single triangles,
+ * so it has 2 * segments * (rings - 1) triangles
+ */
+void RayTracing::SceneGenerator::sphere(uint64_t triangleCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	uint32_t rings = std::max(2U, static_cast<uint32_t>(std::lround((1.0 + std::sqrt(1.0 + static_cast<double>(triangleCount))) / 2.0)));
+	uint32_t segments = 2 * rings;
+
+	vertices.reserve(static_cast<size_t>(rings + 1) * (segments + 1));
+	indices.reserve(static_cast<size_t>(6) * segments * (rings - 1));
+
+	for (uint32_t ring = 0; ring <= rings; ring++) {
+		float theta = glm::pi<float>() * ring / rings;
+		for (uint32_t segment = 0; segment <= segments; segment++) {
+			float phi = glm::two_pi<float>() * segment / segments;
+			glm::vec3 normal(std::sin(theta) * std::cos(phi), -std::cos(theta), std::sin(theta) * std::sin(phi));
+			vertices.push_back(makeVertex(normal, normal, glm::vec2(static_cast<float>(segment) / segments, static_cast<float>(ring) / rings)));
+		}
+	}
+
+	uint32_t stride = segments + 1;
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			uint32_t a = ring * stride + segment, b = a + 1;
+			uint32_t c = a + stride, d = c + 1;
+
+			if (ring != 0)
+				indices.insert(indices.end(), { a, c, b });
+			if (ring != rings - 1)
+				indices.insert(indices.end(), { b, c, d });
+		}
+	}
+}
+
+/*
+ * Flat 2x2 grid in the xz plane with two triangles per cell
+ */
+void RayTracing::SceneGenerator::grid(uint64_t triangleCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	uint32_t resolution = std::max(1U, static_cast<uint32_t>(std::lround(std::sqrt(static_cast<double>(triangleCount) / 2.0))));
+
+	vertices.reserve(static_cast<size_t>(resolution + 1) * (resolution + 1));
+	for (uint32_t z = 0; z <= resolution; z++) {
+		for (uint32_t x = 0; x <= resolution; x++) {
+			glm::vec2 uv(static_cast<float>(x) / resolution, static_cast<float>(z) / resolution);
+			vertices.push_back(makeVertex(glm::vec3(uv.x * 2.f - 1.f, 0.f, uv.y * 2.f - 1.f), glm::vec3(0.f, -1.f, 0.f), uv));
+		}
+	}
+
+	gridIndices(resolution, indices);
+}
+
+/*
+ * Grid displaced by seeded fractal value noise, the normals are taken from the height field's central differences
+ */
+void RayTracing::SceneGenerator::terrain(uint64_t triangleCount, uint64_t seed, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	uint32_t resolution = std::max(1U, static_cast<uint32_t>(std::lround(std::sqrt(static_cast<double>(triangleCount) / 2.0))));
+	uint32_t stride = resolution + 1;
+
+	std::vector<float> heights(static_cast<size_t>(stride) * stride);
+	for (uint32_t z = 0; z <= resolution; z++)
+		for (uint32_t x = 0; x <= resolution; x++)
+			heights[static_cast<size_t>(z) * stride + x] = TERRAIN_HEIGHT * terrainHeight(static_cast<float>(x) / resolution, static_cast<float>(z) / resolution, seed);
+
+	float cellSize = 2.f / resolution;
+	vertices.reserve(heights.size());
+	for (uint32_t z = 0; z <= resolution; z++) {
+		for (uint32_t x = 0; x <= resolution; x++) {
+			auto height = [&](uint32_t hx, uint32_t hz) { return heights[static_cast<size_t>(hz) * stride + hx]; };
+
+			uint32_t x0 = x > 0 ? x - 1 : x, x1 = std::min(x + 1, resolution);
+			uint32_t z0 = z > 0 ? z - 1 : z, z1 = std::min(z + 1, resolution);
+			float dx = (height(x1, z) - height(x0, z)) / ((x1 - x0) * cellSize);
+			float dz = (height(x, z1) - height(x, z0)) / ((z1 - z0) * cellSize);
+
+			glm::vec2 uv(static_cast<float>(x) / resolution, static_cast<float>(z) / resolution);
+			glm::vec3 position(uv.x * 2.f - 1.f, -height(x, z), uv.y * 2.f - 1.f);
+			glm::vec3 normal = glm::normalize(glm::vec3(-dx, -1.f, -dz));
+			vertices.push_back(makeVertex(position, normal, uv));
+		}
+	}
+
+	gridIndices(resolution, indices);
+}
+
+void RayTracing::SceneGenerator::gridIndices(uint32_t resolution, std::vector<uint32_t>& indices) {
+	uint32_t stride = resolution + 1;
+	indices.reserve(static_cast<size_t>(6) * resolution * resolution);
+
+	for (uint32_t z = 0; z < resolution; z++) {
+		for (uint32_t x = 0; x < resolution; x++) {
+			uint32_t a = z * stride + x, b = a + 1;
+			uint32_t c = a + stride, d = c + 1;
+			indices.insert(indices.end(), { a, b, c, b, d, c });
+		}
+	}
+}
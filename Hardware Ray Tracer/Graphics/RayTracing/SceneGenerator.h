@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Scene.h"
+
+#define GENERATOR_DEFAULT_SEED 0x5EED5EEDULL
+
+namespace RayTracing {
+	enum class GeneratedShape : uint8_t {
+		Sphere,
+		Grid,
+		Terrain
+	};
+
+	struct GeneratorSettings {
+		std::vector<GeneratedShape> shapes = { GeneratedShape::Sphere }; //one mesh per shape
+		uint64_t triangleCount = 1024; //per mesh, the generated count is the closest one the tessellation allows
+		uint32_t instanceCount = 1;
+		uint32_t materialCount = 8;
+		uint32_t lightCount = 4;
+		uint32_t emissiveMaterialCount = 0; //the first materials glow, for area light scaling tests
+		uint64_t seed = GENERATOR_DEFAULT_SEED;
+	};
+
+	/*
+	 * Procedural content for scaling tests. Meshes are tessellated to a requested triangle count and scattered as
+	 * instances with random transforms, materials and lights. Everything is drawn from one seeded generator that
+	 * does not depend on the standard library's distributions, so a seed gives the same scene on every platform.
+	 * Geometry uses the imported models' convention of -y being up.
+	 */
+	class SceneGenerator {
+	public:
+		static void generate(const GeneratorSettings& settings, Scene& scene);
+		static std::string describe(const GeneratorSettings& settings);
+		static std::vector<GeneratedShape> parseShapes(const std::string& names);
+
+		static void sphere(uint64_t triangleCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+		static void grid(uint64_t triangleCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+		static void terrain(uint64_t triangleCount, uint64_t seed, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	private:
+		static void gridIndices(uint32_t resolution, std::vector<uint32_t>& indices);
+	};
+}
@@ -0,0 +1,96 @@
+#include "SobolSampler.h"
+
+#include <bit>
+#include <stdexcept>
+
+namespace {
+	//primitive polynomials and initial direction numbers of Joe and Kuo (new-joe-kuo-6.21201), from the second dimension on
+	struct SobolParameters {
+		uint32_t degree;
+		uint32_t coefficients;
+		uint32_t initial[5];
+	};
+
+	const SobolParameters SOBOL_PARAMETERS[] = {
+		{ 1, 0, { 1 } },
+		{ 2, 1, { 1, 3 } },
+		{ 3, 1, { 1, 3, 1 } },
+		{ 3, 2, { 1, 1, 1 } },
+		{ 4, 1, { 1, 1, 3, 3 } },
+		{ 4, 4, { 1, 3, 5, 13 } },
+		{ 5, 2, { 1, 1, 5, 5, 17 } }
+	};
+
+	uint32_t reverseBits(uint32_t x) {
+		x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+		x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+		x = ((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);
+		x = ((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+	uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+		x += seed;
+		x ^= x * 0x6c50b47cU;
+		x ^= x * 0xb82f1e52U;
+		x ^= x * 0xc7afe638U;
+		x ^= x * 0x8d22f6e6U;
+		return x;
+	}
+
+	uint32_t hashCombine(uint32_t seed, uint32_t value) {
+		return seed ^ (value + (seed << 6) + (seed >> 2));
+	}
+}
+
+/*
+ * SOBOL_BITS direction numbers per dimension, the first dimension is the van der Corput sequence
+ */
+std::vector<uint32_t> RayTracing::createSobolMatrices(uint32_t dimensions) {
+	if (dimensions > 1 + std::size(SOBOL_PARAMETERS))
+		throw std::runtime_error("too many Sobol dimensions!");
+
+	std::vector<uint32_t> matrices(static_cast<size_t>(dimensions) * SOBOL_BITS);
+	for (uint32_t bit = 0; bit < SOBOL_BITS && dimensions > 0; bit++)
+		matrices[bit] = 1U << (31 - bit);
+
+	for (uint32_t dimension = 1; dimension < dimensions; dimension++) {
+		const SobolParameters& parameters = SOBOL_PARAMETERS[dimension - 1];
+		uint32_t* directions = &matrices[static_cast<size_t>(dimension) * SOBOL_BITS];
+		uint32_t degree = parameters.degree;
+
+		for (uint32_t bit = 0; bit < degree; bit++)
+			directions[bit] = parameters.initial[bit] << (31 - bit);
+
+		for (uint32_t bit = degree; bit < SOBOL_BITS; bit++) {
+			directions[bit] = directions[bit - degree] ^ (directions[bit - degree] >> degree);
+			for (uint32_t k = 1; k < degree; k++)
+				if ((parameters.coefficients >> (degree - 1 - k)) & 1U)
+					directions[bit] ^= directions[bit - k];
+		}
+	}
+	return matrices;
+}
+
+//base 2 Owen scrambling, every bit is flipped by a hash of the bits above it
+uint32_t RayTracing::nestedUniformScramble(uint32_t x, uint32_t seed) {
+	return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+uint32_t RayTracing::sobol(std::span<const uint32_t> matrices, uint32_t index, uint32_t dimension) {
+	uint32_t x = 0;
+	for (; index != 0; index &= index - 1)
+		x ^= matrices[dimension * SOBOL_BITS + std::countr_zero(index)];
+	return x;
+}
+
+/*
+ * One shuffled and scrambled SOBOL_DIMENSIONS point, seed decorrelates pixels and the draws of a path
+ */
+void RayTracing::sobolSample(std::span<const uint32_t> matrices, uint32_t index, uint32_t seed, float* result) {
+	index = nestedUniformScramble(index, seed);
+	for (uint32_t dimension = 0; dimension < SOBOL_DIMENSIONS; dimension++) {
+		uint32_t x = nestedUniformScramble(sobol(matrices, index, dimension), hashCombine(seed, dimension));
+		result[dimension] = static_cast<float>(x >> 8) * (1.f / 16777216.f);
+	}
+}
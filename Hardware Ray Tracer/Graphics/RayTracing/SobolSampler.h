@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#define SOBOL_DIMENSIONS 4U //dimensions of one padded sample, every draw in the shader is a 4D point with its own scramble
+#define SOBOL_BITS 32U
+
+namespace RayTracing {
+	enum SamplerType : uint32_t {
+		eSamplerPCG, //independent random numbers, the reference for convergence comparisons
+		eSamplerSobol
+	};
+
+	/*
+	 * Owen scrambled Sobol points after Burley, "Practical Hash-based Owen Scrambling" (JCGT 2020). The direction numbers
+	 * are generated here and uploaded once, the scrambling is a hash so there are no per pixel tables. These host versions
+	 * match shaders/sobol.slang bit for bit.
+	 */
+	std::vector<uint32_t> createSobolMatrices(uint32_t dimensions = SOBOL_DIMENSIONS);
+	uint32_t nestedUniformScramble(uint32_t x, uint32_t seed);
+	uint32_t sobol(std::span<const uint32_t> matrices, uint32_t index, uint32_t dimension);
+	void sobolSample(std::span<const uint32_t> matrices, uint32_t index, uint32_t seed, float* result);
+}
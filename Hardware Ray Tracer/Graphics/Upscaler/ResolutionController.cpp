@@ -0,0 +1,94 @@
+#include "ResolutionController.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+//starts at the largest scale, the first measurements bring it down if needed
+Extensions::ResolutionController::ResolutionController(float targetMs, float minScale, float maxScale)
+	: targetMs(targetMs), minScale(minScale), maxScale(std::max(minScale, maxScale)), scale(this->maxScale), previousScale(this->maxScale) {}
+
+/*
+ * Takes the GPU times of a read back frame, nextFrame is the frame about to be recorded. Returns true when the scale
+ * changed, nextFrame is then the first one traced at the new scale.
+ */
+bool Extensions::ResolutionController::update(uint64_t nextFrame, uint64_t frame, double frameMilliseconds, double traceMilliseconds) {
+	if (measured && frame <= lastFrame)
+		return false;
+	measured = true;
+	lastFrame = frame;
+
+	//changes are at least one measured frame apart, so every older frame was traced at the previous scale
+	bool current = frame >= changeFrame;
+	log(ResolutionSample{ frame, frameMilliseconds, traceMilliseconds, current ? scale : previousScale });
+	if (!current)
+		return false;
+
+	if (samples == 0) {
+		smoothedFrame = frameMilliseconds;
+		smoothedTrace = traceMilliseconds;
+	}
+	else {
+		smoothedFrame += RESOLUTION_SMOOTHING * (frameMilliseconds - smoothedFrame);
+		smoothedTrace += RESOLUTION_SMOOTHING * (traceMilliseconds - smoothedTrace);
+	}
+	if (++samples < RESOLUTION_MIN_SAMPLES)
+		return false;
+
+	bool over = smoothedFrame > targetMs;
+	bool under = smoothedFrame < targetMs * RESOLUTION_LOWER_BAND;
+	if (!over && !under)
+		return false;
+
+	double fixed = std::max(smoothedFrame - smoothedTrace, 0.0);
+	double budget = targetMs * RESOLUTION_HEADROOM - fixed;
+	double wanted = budget > 0.0 && smoothedTrace > 0.0 ? scale * std::sqrt(budget / smoothedTrace) : minScale;
+
+	//rounded down so the new scale stays inside the budget, the small bias keeps exact multiples where they are
+	float next = wanted >= maxScale ? maxScale : std::floor(static_cast<float>(wanted) / RESOLUTION_STEP + 1e-3f) * RESOLUTION_STEP;
+	next = std::clamp(next, minScale, maxScale);
+	next = over ? std::min(next, scale) : std::max(next, scale);
+	if (next == scale)
+		return false;
+
+	previousScale = scale;
+	scale = next;
+	changeFrame = nextFrame;
+	samples = 0;
+	changes++;
+	return true;
+}
+
+void Extensions::ResolutionController::log(const ResolutionSample& sample) {
+	measuredFrames++;
+	if (sample.frameMilliseconds > targetMs)
+		framesOver++;
+
+	history.push_back(sample);
+	if (history.size() > RESOLUTION_HISTORY)
+		history.pop_front();
+
+	if (csv.is_open())
+		csv << sample.frame << "," << sample.frameMilliseconds << "," << sample.traceMilliseconds << "," << sample.scale << "\n";
+}
+
+/*
+ * Every frame measured from now on is appended to the file
+ */
+bool Extensions::ResolutionController::openCSV(const std::string& path) {
+	csv.open(path, std::ios::trunc);
+	if (!csv.is_open()) return false;
+
+	csv << std::setprecision(6) << "frame,frame_ms,trace_ms,scale\n";
+	return true;
+}
+
+/*
+ * One line, e.g. "target 16.60 ms, scale 0.73 (0.50 - 1.00), 4 changes, 2.1% of 900 frames over"
+ */
+std::string Extensions::ResolutionController::summary() const {
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(2) << "target " << targetMs << " ms, scale " << scale << " (" << minScale << " - " << maxScale << "), "
+		<< changes << " changes, " << std::setprecision(1) << (measuredFrames > 0 ? 100.0 * framesOver / measuredFrames : 0.0) << "% of " << measuredFrames << " frames over";
+	return line.str();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <fstream>
+
+#define RESOLUTION_DEFAULT_TARGET_MS 16.6f //GPU frame time of 60 fps
+#define RESOLUTION_SMOOTHING 0.5 //weight of the newest frame in the smoothed GPU times
+#define RESOLUTION_MIN_SAMPLES 3U //frames measured at a scale before it may change again
+#define RESOLUTION_LOWER_BAND 0.75 //the scale only grows below this fraction of the target, above the target it shrinks
+#define RESOLUTION_HEADROOM 0.85 //fraction of the target a new scale aims for, inside the band so it is kept
+#define RESOLUTION_STEP 0.025f //scales are multiples of this, small changes are not worth a new history
+#define RESOLUTION_HISTORY 1024U //measurements kept in the log, older ones are dropped
+
+namespace Extensions {
+	/*
+	 * One read back frame and the scale it was traced at
+	 */
+	struct ResolutionSample {
+		uint64_t frame;
+		double frameMilliseconds; //whole GPU frame
+		double traceMilliseconds; //the part that scales with the traced pixels
+		float scale;
+	};
+
+	/*
+	 * Picks the render scale from GPU timestamps so the frame time stays below targetMs. The trace time is taken
+	 * to grow with the traced pixels and the rest of the frame to stay fixed, a change aims for RESOLUTION_HEADROOM
+	 * of the target from there. Nothing changes while the smoothed frame time is between RESOLUTION_LOWER_BAND of
+	 * the target and the target, and frames still traced at the previous scale are only logged.
+	 */
+	class ResolutionController {
+	public:
+		ResolutionController(float targetMs, float minScale, float maxScale);
+
+		bool update(uint64_t nextFrame, uint64_t frame, double frameMilliseconds, double traceMilliseconds);
+		bool openCSV(const std::string& path);
+		std::string summary() const;
+
+		inline float getScale() const { return scale; }
+		inline float getTargetMs() const { return targetMs; }
+		inline uint32_t getChangeCount() const { return changes; }
+		inline const std::deque<ResolutionSample>& getHistory() const { return history; }
+	private:
+		void log(const ResolutionSample& sample);
+	private:
+		float targetMs;
+		float minScale;
+		float maxScale;
+
+		float scale;
+		float previousScale;
+		uint64_t changeFrame = 0; //first frame traced at scale
+		uint64_t lastFrame = 0;
+		bool measured = false;
+
+		double smoothedFrame = 0.0;
+		double smoothedTrace = 0.0;
+		uint32_t samples = 0; //measured at scale
+
+		uint32_t changes = 0;
+		uint64_t measuredFrames = 0;
+		uint64_t framesOver = 0; //above targetMs
+		std::deque<ResolutionSample> history;
+		std::ofstream csv;
+	};
+}
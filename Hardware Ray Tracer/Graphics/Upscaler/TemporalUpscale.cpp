@@ -0,0 +1,176 @@
+#include "TemporalUpscale.h"
+
+#include <algorithm>
+#include <cmath>
+
+//constants of shaders/upscale.slang that are not tuning parameters
+#define UPSCALE_KERNEL_SHARPNESS 6.f //exponent of the Gaussian over squared input pixel distances
+#define UPSCALE_EPSILON 1e-6f
+
+namespace {
+	float maxComponent(glm::vec3 color) {
+		return std::max(color.r, std::max(color.g, color.b));
+	}
+
+	//reversible tonemap, keeps single bright samples from dominating the filters
+	glm::vec3 tonemap(glm::vec3 color) {
+		return color / (1.f + maxComponent(color));
+	}
+
+	glm::vec3 inverseTonemap(glm::vec3 color) {
+		return color / std::max(1.f - maxComponent(color), UPSCALE_EPSILON);
+	}
+
+	glm::vec3 toYCoCg(glm::vec3 c) {
+		return glm::vec3(0.25f * c.r + 0.5f * c.g + 0.25f * c.b, 0.5f * c.r - 0.5f * c.b, -0.25f * c.r + 0.5f * c.g - 0.25f * c.b);
+	}
+
+	glm::vec3 fromYCoCg(glm::vec3 c) {
+		return glm::vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+	}
+
+	//moves the history towards the neighbourhood mean until it is inside the box (Salvi 2016)
+	glm::vec3 clipToBox(glm::vec3 history, glm::vec3 mean, glm::vec3 extent) {
+		glm::vec3 offset = history - mean;
+		glm::vec3 units = glm::abs(offset / glm::max(extent, glm::vec3(UPSCALE_EPSILON)));
+		float largest = maxComponent(units);
+		return largest > 1.f ? mean + offset / largest : history;
+	}
+
+	glm::vec4 catmullRom(float f) {
+		return glm::vec4(
+			f * (-0.5f + f * (1.f - 0.5f * f)),
+			1.f + f * f * (-2.5f + 1.5f * f),
+			f * (0.5f + f * (2.f - 1.5f * f)),
+			f * f * (-0.5f + 0.5f * f)
+		);
+	}
+}
+
+float Extensions::halton(uint32_t index, uint32_t base) {
+	float result = 0.f;
+	float fraction = 1.f;
+	while (index > 0) {
+		fraction /= static_cast<float>(base);
+		result += fraction * static_cast<float>(index % base);
+		index /= base;
+	}
+	return result;
+}
+
+//more pixels per input pixel need more offsets before every one of them has been close to a sample
+uint32_t Extensions::jitterPhases(float scale) {
+	return static_cast<uint32_t>(std::ceil(UPSCALE_JITTER_PHASES / (scale * scale)));
+}
+
+/*
+ * Halton (2, 3) offset of the frame's samples from the input pixel centers, in [-0.5, 0.5). The sequence starts
+ * at index 1, the first point of Halton is the pixel corner.
+ */
+glm::vec2 Extensions::upscaleJitter(uint64_t frame, float scale) {
+	uint32_t index = static_cast<uint32_t>(frame % jitterPhases(scale)) + 1;
+	return glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+}
+
+glm::uvec2 Extensions::scaledExtent(glm::uvec2 outputSize, float scale) {
+	return glm::max(glm::uvec2(glm::round(glm::vec2(outputSize) * scale)), glm::uvec2(1));
+}
+
+/*
+ * Catmull-Rom over 4x4 texels, the history is resampled every frame and a bilinear filter would blur it more each time
+ */
+glm::vec4 Extensions::TemporalUpscaleReference::sampleHistory(glm::vec2 position) const {
+	glm::vec2 texel = position - 0.5f;
+	glm::ivec2 base = glm::ivec2(glm::floor(texel));
+	glm::vec2 f = texel - glm::vec2(base);
+	glm::vec4 wx = catmullRom(f.x);
+	glm::vec4 wy = catmullRom(f.y);
+
+	glm::vec4 result(0.f);
+	for (int y = 0; y < 4; y++) {
+		for (int x = 0; x < 4; x++) {
+			glm::ivec2 q = glm::clamp(base + glm::ivec2(x - 1, y - 1), glm::ivec2(0), glm::ivec2(outputSize) - 1);
+			result += history[source][q.y * outputSize.x + q.x] * wx[x] * wy[y];
+		}
+	}
+	return glm::max(result, glm::vec4(0.f));
+}
+
+void Extensions::TemporalUpscaleReference::upscale(const UpscaleFrame& frame, UpscaleConstants constants, glm::uvec2 outputSize, std::vector<glm::vec4>& output) {
+	if (this->outputSize != outputSize) {
+		this->outputSize = outputSize;
+		for (std::vector<glm::vec4>& image : history)
+			image.assign(static_cast<size_t>(outputSize.x) * outputSize.y, glm::vec4(0.f));
+		historyValid = false;
+	}
+
+	constants.renderSize = glm::uvec2(frame.width, frame.height);
+	constants.outputSize = outputSize;
+	if (!historyValid)
+		constants.flags |= eUpscaleReset;
+
+	glm::ivec2 renderSize(constants.renderSize);
+	glm::vec2 scale = glm::vec2(constants.renderSize) / glm::vec2(outputSize);
+	uint32_t target = source ^ 1U;
+	output.resize(static_cast<size_t>(outputSize.x) * outputSize.y);
+
+	for (uint32_t y = 0; y < outputSize.y; y++) {
+		for (uint32_t x = 0; x < outputSize.x; x++) {
+			//the output pixel center in input pixels, the input pixel i holds the sample at i + 0.5 + jitter
+			glm::vec2 center = (glm::vec2(x, y) + 0.5f) * scale;
+			glm::ivec2 nearest = glm::ivec2(glm::floor(center - constants.jitter));
+
+			glm::vec3 color(0.f), mean(0.f), square(0.f);
+			float weightSum = 0.f, confidence = 0.f, frontDepth = 1e32f;
+			glm::ivec2 front = glm::clamp(nearest, glm::ivec2(0), renderSize - 1);
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					glm::ivec2 q = glm::clamp(nearest + glm::ivec2(dx, dy), glm::ivec2(0), renderSize - 1);
+					size_t index = static_cast<size_t>(q.y) * frame.width + q.x;
+					glm::vec3 sample = tonemap(glm::max(glm::vec3(frame.color[index]), glm::vec3(0.f)));
+					glm::vec2 offset = glm::vec2(q) + 0.5f + constants.jitter - center;
+					float weight = std::exp(-UPSCALE_KERNEL_SHARPNESS * glm::dot(offset, offset));
+
+					color += sample * weight;
+					weightSum += weight;
+					confidence = std::max(confidence, weight);
+
+					glm::vec3 ycocg = toYCoCg(sample);
+					mean += ycocg;
+					square += ycocg * ycocg;
+
+					//motion of the closest surface, edges of moving objects keep their history
+					float depth = frame.depth[index];
+					if (depth > 0.f && depth < frontDepth) {
+						frontDepth = depth;
+						front = q;
+					}
+				}
+			}
+			color = weightSum > UPSCALE_EPSILON ? color / weightSum : tonemap(glm::max(glm::vec3(frame.color[static_cast<size_t>(front.y) * frame.width + front.x]), glm::vec3(0.f)));
+			mean /= 9.f;
+			glm::vec3 deviation = glm::sqrt(glm::max(square / 9.f - mean * mean, glm::vec3(0.f)));
+
+			glm::vec2 motion = frame.motion[static_cast<size_t>(front.y) * frame.width + front.x];
+			glm::vec2 previous = glm::vec2(x, y) + 0.5f + motion / scale;
+			bool onScreen = glm::all(glm::greaterThanEqual(previous, glm::vec2(0.f))) && glm::all(glm::lessThan(previous, glm::vec2(outputSize)));
+
+			glm::vec3 result = color;
+			float weight = confidence;
+			if ((constants.flags & eUpscaleReset) == 0 && onScreen) {
+				glm::vec4 past = sampleHistory(previous);
+				glm::vec3 rectified = fromYCoCg(clipToBox(toYCoCg(glm::vec3(past)), mean, deviation * constants.clipGamma));
+				float pastWeight = std::min(past.a, constants.historyMax);
+
+				result = glm::mix(rectified, color, confidence / std::max(pastWeight + confidence, UPSCALE_EPSILON));
+				weight = std::min(pastWeight + confidence, constants.historyMax);
+			}
+
+			history[target][y * outputSize.x + x] = glm::vec4(result, weight);
+			output[y * outputSize.x + x] = glm::vec4(inverseTonemap(result), 1.f);
+		}
+	}
+
+	source = target;
+	historyValid = true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define UPSCALE_SHADER_PATH "shaders/upscale.slang.spv"
+#define UPSCALE_GROUP_SIZE 8U //numthreads of upscaleMain in shaders/upscale.slang
+#define UPSCALE_MIN_SCALE 0.5f //render resolution per output resolution on each axis
+#define UPSCALE_MAX_SCALE 1.f
+#define UPSCALE_JITTER_PHASES 8.f //Halton offsets per input pixel at full scale, grows with the pixels per input pixel
+#define UPSCALE_HISTORY_MAX 8.f //cap of the accumulated sample weight, the slowest blend is one sample in this many
+#define UPSCALE_CLIP_GAMMA 1.25f //history clipping box in standard deviations of the neighbourhood
+
+namespace Extensions {
+	enum UpscaleFlags : uint32_t {
+		eUpscaleReset = 1 //UPSCALE_RESET
+	};
+
+	/*
+	 * Push constants of shaders/upscale.slang
+	 */
+	struct UpscaleConstants {
+		glm::uvec2 renderSize{ 0 };
+		glm::uvec2 outputSize{ 0 };
+		glm::vec2 jitter{ 0.f }; //input pixels from the pixel center to this frame's sample, upscaleJitter
+		uint32_t flags = 0;
+		float historyMax = UPSCALE_HISTORY_MAX;
+		float clipGamma = UPSCALE_CLIP_GAMMA;
+	};
+
+	/*
+	 * Inputs of one frame in the formats the ray tracing pass writes them, at the render resolution
+	 */
+	struct UpscaleFrame {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<glm::vec4> color; //RGBA32F radiance sampled at the jittered positions
+		std::vector<float> depth; //R32F view space depth, 0 for misses
+		std::vector<glm::vec2> motion; //RG16F input pixels from this frame's position to the previous one
+	};
+
+	float halton(uint32_t index, uint32_t base);
+	uint32_t jitterPhases(float scale);
+	glm::vec2 upscaleJitter(uint64_t frame, float scale);
+	glm::uvec2 scaledExtent(glm::uvec2 outputSize, float scale);
+
+	/*
+	 * CPU version of upscaleMain in shaders/upscale.slang for testing the reconstruction without a GPU. It runs the
+	 * same operations in the same order but keeps the history in 32 bit floats instead of RGBA16F.
+	 */
+	class TemporalUpscaleReference {
+	public:
+		void upscale(const UpscaleFrame& frame, UpscaleConstants constants, glm::uvec2 outputSize, std::vector<glm::vec4>& output);
+		inline void reset() { historyValid = false; }
+	private:
+		glm::vec4 sampleHistory(glm::vec2 position) const;
+	private:
+		glm::uvec2 outputSize{ 0 };
+		std::array<std::vector<glm::vec4>, 2> history; //tonemapped color and accumulated weight, read and written alternately
+		uint32_t source = 0;
+		bool historyValid = false;
+	};
+}
@@ -0,0 +1,123 @@
+#include "Upscaler.h"
+#include "../vulkan_core/Shader.h"
+
+#define UPSCALE_BINDINGS 6U //storage images of shaders/upscale.slang
+
+Extensions::Upscaler::Upscaler(Core::Device& device, VkPipelineCache cache) : device(device) {
+	createDescriptorSets();
+	createPipeline(cache);
+}
+Extensions::Upscaler::~Upscaler() {
+	destroyImages();
+	vkDestroyPipeline(device.getDevice(), pipeline, nullptr);
+	vkDestroyPipelineLayout(device.getDevice(), pipelineLayout, nullptr);
+}
+
+/*
+ * Recreates the history for the new output extent and points the pass at the inputs. The history starts over,
+ * only call this while the descriptor sets are not used by a pending command buffer.
+ */
+void Extensions::Upscaler::setImages(VkExtent2D renderExtent, VkExtent2D outputExtent, const UpscalerInputs& inputs) {
+	destroyImages();
+	this->renderExtent = renderExtent;
+	this->outputExtent = outputExtent;
+
+	for (Core::StorageImage& image : history)
+		image.create(device, VK_FORMAT_R16G16B16A16_SFLOAT, outputExtent);
+	output.create(device, VK_FORMAT_R32G32B32A32_SFLOAT, outputExtent);
+	imagesDefined = false;
+	historyValid = false;
+
+	bool allocate = descriptorSets[0] == VK_NULL_HANDLE;
+	for (uint32_t set = 0; set < descriptorSets.size(); set++) {
+		VkImageView views[UPSCALE_BINDINGS] = { inputs.color, inputs.depth, inputs.motion, history[set].imageView, history[set ^ 1U].imageView, output.imageView };
+		std::array<VkDescriptorImageInfo, UPSCALE_BINDINGS> infos;
+		Core::DescriptorWriter writer(*setLayout, *pool);
+		for (uint32_t binding = 0; binding < UPSCALE_BINDINGS; binding++) {
+			infos[binding] = VkDescriptorImageInfo{ .imageView = views[binding], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+			writer.writeImage(binding, &infos[binding]);
+		}
+
+		if (allocate) {
+			if (!writer.build(descriptorSets[set]))
+				throw std::runtime_error("failed to allocate upscaler descriptor set!");
+		}
+		else writer.overwrite(descriptorSets[set]);
+	}
+}
+
+/*
+ * Records the pass. The inputs have to be written before, the output is visible to compute shaders afterwards.
+ * The constants only need the jitter of the frame, the sizes are filled in here.
+ */
+void Extensions::Upscaler::upscale(VkCommandBuffer buffer, UpscaleConstants constants) {
+	std::vector<VkImageMemoryBarrier> layoutBarriers;
+	if (!imagesDefined) {
+		for (Core::StorageImage* image : { &history[0], &history[1], &output }) {
+			layoutBarriers.push_back(VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.image = image->image,
+				.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+			});
+		}
+		imagesDefined = true;
+	}
+
+	//also orders the history write of the last frame and the resolve reading the output before this write
+	VkMemoryBarrier inputBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &inputBarrier, 0, VK_NULL_HANDLE, static_cast<uint32_t>(layoutBarriers.size()), layoutBarriers.data());
+
+	constants.renderSize = glm::uvec2(renderExtent.width, renderExtent.height);
+	constants.outputSize = glm::uvec2(outputExtent.width, outputExtent.height);
+	if (!historyValid)
+		constants.flags |= eUpscaleReset;
+
+	vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[source], 0, VK_NULL_HANDLE);
+	vkCmdPushConstants(buffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UpscaleConstants), &constants);
+	vkCmdDispatch(buffer, (outputExtent.width + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE, (outputExtent.height + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE, 1);
+
+	source ^= 1U;
+	historyValid = true;
+}
+
+void Extensions::Upscaler::createDescriptorSets() {
+	pool = Core::DescriptorPool::Builder(device)
+		.setMaxSets(static_cast<uint32_t>(descriptorSets.size()))
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, UPSCALE_BINDINGS * static_cast<uint32_t>(descriptorSets.size()))
+		.build();
+
+	Core::DescriptorSetLayout::Builder builder(device);
+	for (uint32_t binding = 0; binding < UPSCALE_BINDINGS; binding++)
+		builder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+	setLayout = builder.build();
+}
+
+void Extensions::Upscaler::createPipeline(VkPipelineCache cache) {
+	VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+	VkPushConstantRange pushConstants{ .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(UpscaleConstants) };
+
+	VkPipelineLayoutCreateInfo layoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstants
+	};
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device.getDevice(), &layoutInfo, nullptr, &pipelineLayout), "failed to create upscaler pipeline layout!");
+
+	pipeline = Core::Shader::createComputePipeline(device, cache, pipelineLayout, UPSCALE_SHADER_PATH, "upscaleMain");
+}
+
+void Extensions::Upscaler::destroyImages() {
+	for (Core::StorageImage* image : { &history[0], &history[1], &output })
+		image->destroy(device);
+}
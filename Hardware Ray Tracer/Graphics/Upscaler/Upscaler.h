@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../vulkan_core/Device.h"
+#include "../vulkan_core/Descriptors.h"
+#include "../vulkan_core/StorageImage.h"
+#include "TemporalUpscale.h"
+#include <array>
+#include <vector>
+
+namespace Extensions {
+	/*
+	 * Views of the render resolution images the upscaler reads, all in the general layout
+	 */
+	struct UpscalerInputs {
+		VkImageView color; //RGBA32F radiance, the accumulation image or the denoiser output
+		VkImageView depth; //R32F
+		VkImageView motion; //RG16F
+	};
+
+	/*
+	 * Vendor neutral temporal upscaler standing in for DLSS Super Resolution. The ray tracing pass samples every pixel
+	 * at the frame's Halton jitter, upscaleMain gathers those samples at the output resolution, reprojects its history
+	 * with the motion vectors and clips it to the variance box of the samples before blending.
+	 * The history is sized to the output and dropped with it. TemporalUpscaleReference runs the same pass on the CPU.
+	 */
+	class Upscaler {
+	public:
+		Upscaler(Core::Device& device, VkPipelineCache cache);
+		~Upscaler();
+
+		Upscaler(const Upscaler&) = delete;
+		Upscaler operator=(const Upscaler&) = delete;
+
+		void setImages(VkExtent2D renderExtent, VkExtent2D outputExtent, const UpscalerInputs& inputs);
+		inline void setRenderExtent(VkExtent2D renderExtent) { this->renderExtent = renderExtent; } //the history is in output pixels and stays valid
+		void upscale(VkCommandBuffer buffer, UpscaleConstants constants);
+		inline void resetHistory() { historyValid = false; }
+
+		inline VkImage getOutput() { return output.image; }
+		inline VkImageView getOutputView() { return output.imageView; }
+	private:
+		void createDescriptorSets();
+		void createPipeline(VkPipelineCache cache);
+		void destroyImages();
+	private:
+		Core::Device& device;
+		VkExtent2D renderExtent{}; //read top left part of the inputs
+		VkExtent2D outputExtent{};
+
+		std::array<Core::StorageImage, 2> history; //RGBA16F, tonemapped color and accumulated weight
+		Core::StorageImage output; //RGBA32F, read by the resolve pass
+		uint32_t source = 0; //history read this frame, the other one is written
+		bool imagesDefined = false;
+		bool historyValid = false;
+
+		std::unique_ptr<Core::DescriptorPool> pool;
+		std::unique_ptr<Core::DescriptorSetLayout> setLayout;
+		std::array<VkDescriptorSet, 2> descriptorSets{}; //one per history read
+
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+	};
+}
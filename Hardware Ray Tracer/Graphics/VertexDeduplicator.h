@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#define VERTEX_DEDUP_MIN_CAPACITY 1024U //smallest slot count of the dedup table, always a power of two
+
+namespace Core {
+	/*
+	 * Merges identical vertices while a mesh is imported. Vertices are compared and hashed over all their
+	 * 32 bit words (position, normal and uv), so split normals and uvs at one position spread over the table
+	 * instead of colliding. The table is a flat array of (hash, index) slots with linear probing, pre-sized
+	 * from the index count so that a typical import never has to rehash and never allocates per vertex.
+	 */
+	template<typename V>
+	class VertexDeduplicator {
+		static_assert(std::is_trivially_copyable_v<V> && sizeof(V) % sizeof(uint32_t) == 0, "vertices have to be plain 32 bit words");
+		static constexpr uint32_t WORD_COUNT = sizeof(V) / sizeof(uint32_t);
+		static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+	public:
+		/*
+		 * indexCount is the summed index count of all shapes, the vertex array is reserved for half of it
+		 */
+		VertexDeduplicator(std::vector<V>& vertices, std::vector<uint32_t>& indices, size_t indexCount) : vertices(vertices), indices(indices) {
+			indices.reserve(indices.size() + indexCount);
+			vertices.reserve(vertices.size() + indexCount / 2);
+
+			size_t capacity = VERTEX_DEDUP_MIN_CAPACITY;
+			while (capacity < indexCount)
+				capacity <<= 1;
+
+			slots.assign(capacity, Slot{ 0, EMPTY_SLOT });
+			mask = capacity - 1;
+		}
+
+		/*
+		 * Appends the index of the vertex, the vertex itself is only appended the first time it is seen
+		 */
+		inline void add(const V& vertex) {
+			uint32_t words[WORD_COUNT];
+			canonicalize(vertex, words);
+			uint32_t h = hash(words);
+
+			size_t slot = h & mask;
+			while (slots[slot].index != EMPTY_SLOT) {
+				if (slots[slot].hash == h && equal(words, vertices[slots[slot].index])) {
+					indices.push_back(slots[slot].index);
+					return;
+				}
+				slot = (slot + 1) & mask;
+			}
+
+			uint32_t index = static_cast<uint32_t>(vertices.size());
+			slots[slot] = Slot{ h, index };
+			vertices.push_back(vertex);
+			indices.push_back(index);
+
+			//keep the load factor at or below one half
+			if (++count * 2 > slots.size())
+				grow();
+		}
+
+		inline size_t getCapacity() const { return slots.size(); }
+	private:
+		struct Slot {
+			uint32_t hash;
+			uint32_t index;
+		};
+
+		/*
+		 * Copies the vertex into 32 bit words and maps -0.0f to 0.0f, so that bitwise equality matches operator==
+		 */
+		static inline void canonicalize(const V& vertex, uint32_t* words) {
+			memcpy(words, &vertex, sizeof(V));
+			for (uint32_t i = 0; i < WORD_COUNT; i++)
+				if (words[i] == 0x80000000U)
+					words[i] = 0;
+		}
+
+		static inline bool equal(const uint32_t* words, const V& vertex) {
+			uint32_t other[WORD_COUNT];
+			canonicalize(vertex, other);
+			return memcmp(words, other, sizeof(V)) == 0;
+		}
+
+		static inline uint32_t rotate(uint32_t x, uint32_t r) {
+			return (x << r) | (x >> (32 - r));
+		}
+
+		/*
+		 * MurmurHash3 (x86, 32 bit) over the vertex words
+		 */
+		static inline uint32_t hash(const uint32_t* words) {
+			uint32_t h = 0x9e3779b9U;
+			for (uint32_t i = 0; i < WORD_COUNT; i++) {
+				uint32_t k = words[i] * 0xcc9e2d51U;
+				k = rotate(k, 15) * 0x1b873593U;
+				h = rotate(h ^ k, 13) * 5U + 0xe6546b64U;
+			}
+
+			h ^= sizeof(V);
+			h ^= h >> 16;
+			h *= 0x85ebca6bU;
+			h ^= h >> 13;
+			h *= 0xc2b2ae35U;
+			h ^= h >> 16;
+			return h;
+		}
+
+		void grow() {
+			std::vector<Slot> old(slots.size() * 2, Slot{ 0, EMPTY_SLOT });
+			old.swap(slots);
+			mask = slots.size() - 1;
+
+			for (const Slot& entry : old) {
+				if (entry.index == EMPTY_SLOT)
+					continue;
+
+				size_t slot = entry.hash & mask;
+				while (slots[slot].index != EMPTY_SLOT)
+					slot = (slot + 1) & mask;
+				slots[slot] = entry;
+			}
+		}
+	private:
+		std::vector<V>& vertices;
+		std::vector<uint32_t>& indices;
+
+		std::vector<Slot> slots;
+		size_t mask;
+		size_t count = 0;
+	};
+}
@@ -0,0 +1,340 @@
+#include "Allocator.h"
+#include <algorithm>
+
+static uint32_t orderOf(VkDeviceSize size) {
+	uint32_t order = 0;
+	while ((ALLOCATOR_MIN_SIZE << order) < size) order++;
+	return order;
+}
+
+Core::Allocator::Allocator(VkDevice device, VkPhysicalDevice physicalDevice) : device(device) {
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+	pools.resize(memoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < pools.size(); i++) {
+		uint32_t memoryTypeIndex = i / 2;
+		VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+		//small heaps (e.g. the 256 MiB BAR heap) should not be filled by a handful of blocks
+		VkDeviceSize blockSize = ALLOCATOR_BLOCK_SIZE;
+		while (blockSize > ALLOCATOR_MIN_SIZE && blockSize > heapSize / 8) blockSize >>= 1;
+
+		pools[i].memoryTypeIndex = memoryTypeIndex;
+		pools[i].blockSize = blockSize;
+	}
+}
+
+Core::Allocator::~Allocator() {
+	for (auto& pool : pools) {
+		for (auto& block : pool.blocks)
+			vkFreeMemory(device, block->memory, nullptr);
+	}
+}
+
+Core::Allocation Core::Allocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, AllocationCategory category) {
+	VkMemoryDedicatedRequirements dedicatedRequirements{ .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+	VkMemoryRequirements2 requirements{ .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, .pNext = &dedicatedRequirements };
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2, .buffer = buffer };
+	vkGetBufferMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	return allocate(requirements.memoryRequirements, properties, true, dedicated, category, buffer, VK_NULL_HANDLE);
+}
+
+Core::Allocation Core::Allocator::allocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties) {
+	VkMemoryDedicatedRequirements dedicatedRequirements{ .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+	VkMemoryRequirements2 requirements{ .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, .pNext = &dedicatedRequirements };
+	VkImageMemoryRequirementsInfo2 requirementsInfo{ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2, .image = image };
+	vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	return allocate(requirements.memoryRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR, dedicated, eImage, VK_NULL_HANDLE, image);
+}
+
+void Core::Allocator::free(Allocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	allocationCount--;
+	categoryBytes[allocation.category] -= allocation.size;
+
+	if (allocation.block == nullptr) {
+		vkFreeMemory(device, allocation.memory, nullptr);
+		dedicatedCount--;
+		dedicatedBytes -= allocation.size;
+	}
+	else {
+		MemoryBlock* block = allocation.block;
+		freeFromBlock(*block, allocation.offset);
+
+		//keep one empty block per pool around, so a freed and recreated resource does not hit the driver again
+		Pool& pool = pools[block->poolIndex];
+		if (block->usedBytes == 0 && pool.blocks.size() > 1) {
+			vkFreeMemory(device, block->memory, nullptr);
+			pool.blocks.erase(std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const std::unique_ptr<MemoryBlock>& b) { return b.get() == block; }));
+		}
+	}
+
+	allocation = Allocation{};
+}
+
+VkResult Core::Allocator::flush(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset) {
+	if (allocation.memory == VK_NULL_HANDLE) return VK_SUCCESS;
+
+	VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+	return vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+VkResult Core::Allocator::invalidate(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset) {
+	if (allocation.memory == VK_NULL_HANDLE) return VK_SUCCESS;
+
+	VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+	return vkInvalidateMappedMemoryRanges(device, 1, &range);
+}
+
+Core::AllocatorStats Core::Allocator::getStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	AllocatorStats stats{
+		.blockCount = 0,
+		.dedicatedCount = dedicatedCount,
+		.allocationCount = allocationCount,
+		.reservedBytes = dedicatedBytes,
+		.usedBytes = dedicatedBytes
+	};
+	std::copy(std::begin(categoryBytes), std::end(categoryBytes), std::begin(stats.categoryBytes));
+
+	VkDeviceSize freeBytes = 0;
+	VkDeviceSize largestFree = 0;
+
+	for (auto& pool : pools) {
+		for (auto& block : pool.blocks) {
+			stats.blockCount++;
+			stats.reservedBytes += block->size;
+			stats.usedBytes += block->usedBytes;
+			freeBytes += block->size - block->usedBytes;
+
+			for (uint32_t order = static_cast<uint32_t>(block->freeLists.size()); order > 0; order--) {
+				if (!block->freeLists[order - 1].empty()) {
+					largestFree = std::max(largestFree, ALLOCATOR_MIN_SIZE << (order - 1));
+					break;
+				}
+			}
+		}
+	}
+
+	stats.fragmentation = freeBytes > 0 ? 1.f - static_cast<float>(largestFree) / static_cast<float>(freeBytes) : 0.f;
+	return stats;
+}
+
+void Core::Allocator::printStats() {
+	static const char* categoryNames[eCategoryCount] = { "Generic", "Staging", "Geometry", "Uniform", "Storage", "Acceleration Structure", "Scratch", "Image" };
+
+	AllocatorStats stats = getStats();
+
+	std::cout << "[MEMORY] " << stats.blockCount << " block(s), " << stats.dedicatedCount << " dedicated, " << stats.allocationCount << " allocation(s), "
+		<< stats.usedBytes / 1024 << " of " << stats.reservedBytes / 1024 << " KiB used, fragmentation " << stats.fragmentation * 100.f << "%" << std::endl;
+
+	for (uint32_t i = 0; i < eCategoryCount; i++) {
+		if (stats.categoryBytes[i] > 0)
+			std::cout << "[MEMORY]     " << categoryNames[i] << ": " << stats.categoryBytes[i] / 1024 << " KiB" << std::endl;
+	}
+}
+
+Core::AllocationCategory Core::Allocator::categorize(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+	if (usage & VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR)
+		return (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) ? eScratch : eAccelerationStructure;
+	if (usage & VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR)
+		return eGeometry;
+	if ((usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		return eStaging;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		return eUniform;
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		return eStorage;
+
+	return eGeneric;
+}
+
+Core::Allocation Core::Allocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated, AllocationCategory category, VkBuffer buffer, VkImage image) {
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t poolIndex = memoryTypeIndex * 2 + (linear ? 0 : 1);
+	Pool& pool = pools[poolIndex];
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (dedicated || requirements.size > pool.blockSize / 2)
+		return allocateDedicated(requirements, memoryTypeIndex, category, buffer, image);
+
+	//flushes of non coherent memory have to cover whole atoms, which must not overlap with a neighbour
+	VkDeviceSize alignment = requirements.alignment;
+	if (!(memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+		alignment = std::max(alignment, nonCoherentAtomSize);
+
+	Allocation allocation{ .category = category };
+
+	bool allocated = false;
+	for (auto& block : pool.blocks) {
+		if (allocateFromBlock(*block, requirements.size, alignment, allocation)) {
+			allocated = true;
+			break;
+		}
+	}
+
+	if (!allocated && !allocateFromBlock(*createBlock(pool, poolIndex), requirements.size, alignment, allocation))
+		throw std::runtime_error("failed to sub-allocate memory!");
+
+	allocationCount++;
+	categoryBytes[category] += allocation.size;
+
+	return allocation;
+}
+
+Core::Allocation Core::Allocator::allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, AllocationCategory category, VkBuffer buffer, VkImage image) {
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+		.image = image,
+		.buffer = buffer
+	};
+
+	VkMemoryAllocateFlagsInfo flagsInfo{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+		.pNext = &dedicatedInfo,
+		.flags = static_cast<VkMemoryAllocateFlags>(buffer != VK_NULL_HANDLE ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT : 0)
+	};
+
+	VkMemoryAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = &flagsInfo,
+		.allocationSize = requirements.size,
+		.memoryTypeIndex = memoryTypeIndex
+	};
+
+	Allocation allocation{ .size = requirements.size, .category = category };
+	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &allocation.memory), "failed to allocate dedicated memory!");
+
+	if (isHostVisible(memoryTypeIndex))
+		VK_CHECK_RESULT(vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped), "failed to map dedicated memory!");
+
+	dedicatedCount++;
+	dedicatedBytes += allocation.size;
+	allocationCount++;
+	categoryBytes[category] += allocation.size;
+
+	return allocation;
+}
+
+Core::MemoryBlock* Core::Allocator::createBlock(Pool& pool, uint32_t poolIndex) {
+	//every block may back buffers, which need their device address
+	VkMemoryAllocateFlagsInfo flagsInfo{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+		.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+	};
+
+	VkMemoryAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = &flagsInfo,
+		.allocationSize = pool.blockSize,
+		.memoryTypeIndex = pool.memoryTypeIndex
+	};
+
+	auto block = std::make_unique<MemoryBlock>();
+	block->size = pool.blockSize;
+	block->poolIndex = poolIndex;
+
+	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &block->memory), "failed to allocate memory block!");
+
+	if (isHostVisible(pool.memoryTypeIndex))
+		VK_CHECK_RESULT(vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped), "failed to map memory block!");
+
+	uint32_t maxOrder = orderOf(pool.blockSize);
+	block->freeLists.resize(maxOrder + 1);
+	block->freeLists[maxOrder].insert(0);
+
+	pool.blocks.push_back(std::move(block));
+	return pool.blocks.back().get();
+}
+
+bool Core::Allocator::allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation) {
+	//buddies are aligned to their own size, so a buddy at least as big as the alignment is always aligned
+	uint32_t order = orderOf(std::max(size, alignment));
+
+	uint32_t current = order;
+	while (current < block.freeLists.size() && block.freeLists[current].empty()) current++;
+	if (current >= block.freeLists.size()) return false;
+
+	VkDeviceSize offset = *block.freeLists[current].begin();
+	block.freeLists[current].erase(block.freeLists[current].begin());
+
+	//split down to the requested order, the upper halves stay free
+	while (current > order) {
+		current--;
+		block.freeLists[current].insert(offset + (ALLOCATOR_MIN_SIZE << current));
+	}
+
+	block.orders[offset] = order;
+	block.usedBytes += ALLOCATOR_MIN_SIZE << order;
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = ALLOCATOR_MIN_SIZE << order;
+	allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+	allocation.block = &block;
+
+	return true;
+}
+
+void Core::Allocator::freeFromBlock(MemoryBlock& block, VkDeviceSize offset) {
+	auto it = block.orders.find(offset);
+	uint32_t order = it->second;
+	block.orders.erase(it);
+	block.usedBytes -= ALLOCATOR_MIN_SIZE << order;
+
+	//merge with the buddy as long as it is free as well
+	while (order + 1 < block.freeLists.size()) {
+		VkDeviceSize buddy = offset ^ (ALLOCATOR_MIN_SIZE << order);
+		auto buddyIt = block.freeLists[order].find(buddy);
+		if (buddyIt == block.freeLists[order].end()) break;
+
+		block.freeLists[order].erase(buddyIt);
+		offset = std::min(offset, buddy);
+		order++;
+	}
+
+	block.freeLists[order].insert(offset);
+}
+
+VkMappedMemoryRange Core::Allocator::mappedRange(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset) {
+	VkDeviceSize memorySize = allocation.block ? allocation.block->size : allocation.size;
+
+	VkDeviceSize begin = allocation.offset + offset;
+	VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+
+	begin = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+	end = std::min((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, memorySize);
+
+	return VkMappedMemoryRange{
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.memory = allocation.memory,
+		.offset = begin,
+		.size = end - begin
+	};
+}
+
+uint32_t Core::Allocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool Core::Allocator::isHostVisible(uint32_t memoryTypeIndex) {
+	return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../Definitions.h"
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+#define ALLOCATOR_BLOCK_SIZE (64ULL * 1024ULL * 1024ULL) //size of a pooled memory block, bigger resources than half of it are allocated dedicated
+#define ALLOCATOR_MIN_SIZE 256ULL //smallest buddy, every sub-allocation is rounded up to at least this size
+
+namespace Core {
+	enum AllocationCategory : uint8_t {
+		eGeneric = 0,
+		eStaging,
+		eGeometry,
+		eUniform,
+		eStorage,
+		eAccelerationStructure,
+		eScratch,
+		eImage,
+		eCategoryCount
+	};
+
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+		uint32_t poolIndex = 0;
+
+		std::vector<std::set<VkDeviceSize>> freeLists; //free offsets per order, order 0 has ALLOCATOR_MIN_SIZE bytes
+		std::unordered_map<VkDeviceSize, uint32_t> orders; //order of every allocated offset
+		VkDeviceSize usedBytes = 0;
+	};
+
+	struct Allocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr; //already points at offset, only set for host visible memory
+		MemoryBlock* block = nullptr; //nullptr for dedicated allocations
+		AllocationCategory category = eGeneric;
+	};
+
+	struct AllocatorStats {
+		uint32_t blockCount;
+		uint32_t dedicatedCount;
+		uint32_t allocationCount;
+		VkDeviceSize reservedBytes; //memory allocated from the driver
+		VkDeviceSize usedBytes; //memory handed out to resources, including the buddy padding
+		float fragmentation; //1 - largest free range / free memory, over all blocks
+		VkDeviceSize categoryBytes[eCategoryCount];
+	};
+
+	/*
+	 * Sub-allocates buffers and images from large memory blocks with a buddy allocator.
+	 * Every memory type has one pool for linear (buffers) and one for optimal (images) resources,
+	 * so neighbouring allocations never have to respect bufferImageGranularity.
+	 * Host visible blocks are mapped once for their whole lifetime.
+	 */
+	class Allocator {
+	public:
+		Allocator(VkDevice device, VkPhysicalDevice physicalDevice);
+		~Allocator();
+
+		Allocator(const Allocator&) = delete;
+		Allocator operator=(const Allocator&) = delete;
+
+		Allocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, AllocationCategory category);
+		Allocation allocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties);
+		void free(Allocation& allocation);
+
+		VkResult flush(const Allocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult invalidate(const Allocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+		AllocatorStats getStats();
+		void printStats();
+
+		static AllocationCategory categorize(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+	private:
+		struct Pool {
+			uint32_t memoryTypeIndex;
+			VkDeviceSize blockSize;
+			std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		};
+
+		Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated, AllocationCategory category, VkBuffer buffer, VkImage image);
+		Allocation allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, AllocationCategory category, VkBuffer buffer, VkImage image);
+		MemoryBlock* createBlock(Pool& pool, uint32_t poolIndex);
+		bool allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+		void freeFromBlock(MemoryBlock& block, VkDeviceSize offset);
+
+		VkMappedMemoryRange mappedRange(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset);
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		bool isHostVisible(uint32_t memoryTypeIndex);
+	private:
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize nonCoherentAtomSize;
+
+		std::vector<Pool> pools; //two per memory type, linear pools on even indices
+		std::mutex mutex;
+
+		uint32_t dedicatedCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		VkDeviceSize categoryBytes[eCategoryCount]{};
+	};
+}
@@ -21,17 +21,17 @@ Core::Buffer::Buffer(
     memoryPropertyFlags{ memoryPropertyFlags } {
     alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
     bufferSize = getAlignment(bufferSize, minOffsetAlignment);
-    device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, &buffer, &memory);
+    device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, &buffer, &allocation);
 }
 
 Core::Buffer::~Buffer() {
     unmap();
-    vkDestroyBuffer(lveDevice.getDevice(), buffer, nullptr);
-    vkFreeMemory(lveDevice.getDevice(), memory, nullptr);
+    lveDevice.destroyBuffer(buffer, allocation);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+ * Host visible memory blocks stay mapped, so this only points into the existing mapping.
  *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
@@ -40,20 +40,20 @@ Core::Buffer::~Buffer() {
  * @return VkResult of the buffer mapping call
  */
 VkResult Core::Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-    assert(buffer && memory && "Called map on buffer before create");
-    return vkMapMemory(lveDevice.getDevice(), memory, offset, size, 0, &mapped);
+    assert(buffer && allocation.memory && "Called map on buffer before create");
+    if (allocation.mapped == nullptr) return VK_ERROR_MEMORY_MAP_FAILED;
+
+    mapped = static_cast<char*>(allocation.mapped) + offset;
+    return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The memory block itself stays mapped until it is freed
  */
 void Core::Buffer::unmap() {
-    if (mapped) {
-        vkUnmapMemory(lveDevice.getDevice(), memory);
-        mapped = nullptr;
-    }
+    mapped = nullptr;
 }
 
 /**
@@ -90,12 +90,7 @@ void Core::Buffer::writeToBuffer(void* data, VkDeviceSize size, VkDeviceSize off
  * @return VkResult of the flush call
  */
 VkResult Core::Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
-    return vkFlushMappedMemoryRanges(lveDevice.getDevice(), 1, &mappedRange);
+    return lveDevice.getAllocator().flush(allocation, size, offset);
 }
 
 /**
@@ -110,12 +105,7 @@ VkResult Core::Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult Core::Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
-    return vkInvalidateMappedMemoryRanges(lveDevice.getDevice(), 1, &mappedRange);
+    return lveDevice.getAllocator().invalidate(allocation, size, offset);
 }
 
 /**
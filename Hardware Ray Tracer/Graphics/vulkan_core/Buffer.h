@@ -41,7 +41,7 @@ namespace Core {
         Device& lveDevice;
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        Allocation allocation;
 
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
@@ -1,6 +1,9 @@
 #include "Device.h"
 #include <set>
 #include <unordered_set>
+#include <limits>
+#include <type_traits>
+#include <cstring>
 
 #pragma region callback functions
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -42,24 +45,34 @@ void DestroyDebugUtilsMessengerEXT(
 }
 #pragma endregion
 
+/*
+ * A null window creates a headless device, it has no surface and does not enable the swapchain extension
+ */
 Core::Device::Device(Window* window) : window(window) {
+	if (isHeadless())
+		std::erase_if(deviceExtensions, [](const char* extension) { return strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; });
+
 	createInstance();
 	setupDebugMessenger();
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	loadDispatchTable();
+	allocator = std::make_unique<Allocator>(device_, physicalDevice);
 	createCommandPool();
 	creatRayTracingProperties();
 }
 
 Core::Device::~Device() {
 	vkDestroyCommandPool(device_, commandPool, nullptr);
+	allocator.reset();
 	vkDestroyDevice(device_, nullptr);
 	if (enableValidationLayers) {
 		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(instance, surface_, nullptr);
+	if (surface_ != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(instance, surface_, nullptr);
 	vkDestroyInstance(instance, nullptr);
 }
 
@@ -123,11 +136,41 @@ void Core::Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkM
 	vkBindBufferMemory(device_, *buffer, *bufferMemory, 0);
 }
 
+/*
+ * Creates a buffer whose memory is sub-allocated from the pooled allocator instead of its own vkAllocateMemory
+ */
+void Core::Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, Allocation* allocation) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	//buffers are filled on the transfer queue and read on the graphics queue, so skip the ownership transfers
+	uint32_t queueFamilies[] = { graphicsFamily_, transferFamily_ };
+	if (hasTransferQueue()) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = 2;
+		bufferInfo.pQueueFamilyIndices = queueFamilies;
+	}
+
+	VK_CHECK_RESULT(vkCreateBuffer(device_, &bufferInfo, nullptr, buffer), "failed to create buffer!");
+
+	*allocation = allocator->allocateBuffer(*buffer, properties, Allocator::categorize(usage, properties));
+
+	VK_CHECK_RESULT(vkBindBufferMemory(device_, *buffer, allocation->memory, allocation->offset), "failed to bind buffer memory!");
+}
+
+void Core::Device::destroyBuffer(VkBuffer buffer, Allocation& allocation) {
+	vkDestroyBuffer(device_, buffer, nullptr);
+	allocator->free(allocation);
+}
+
 VkDeviceAddress Core::Device::getBufferDeviceAddress(VkBuffer buffer) {
 	VkBufferDeviceAddressInfoKHR bufferDeviceAI{};
 	bufferDeviceAI.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
 	bufferDeviceAI.buffer = buffer;
-	return vkGetBufferDeviceAddressKHR(device_, &bufferDeviceAI);
+	return dispatchTable.vkGetBufferDeviceAddressKHR(device_, &bufferDeviceAI);
 }
 
 VkCommandBuffer Core::Device::beginSingleTimeCommands() {
@@ -162,6 +205,32 @@ void Core::Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
 	vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
+/*
+ * Submits several recorded command buffers at once and waits on a single fence,
+ * instead of a full queue idle per buffer
+ */
+void Core::Device::endSingleTimeCommands(const std::vector<VkCommandBuffer>& commandBuffers) {
+	if (commandBuffers.empty()) return;
+
+	for (VkCommandBuffer commandBuffer : commandBuffers)
+		vkEndCommandBuffer(commandBuffer);
+
+	VkFenceCreateInfo fenceInfo{ .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+	VkFence fence;
+	VK_CHECK_RESULT(vkCreateFence(device_, &fenceInfo, nullptr, &fence), "failed to create fence!");
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+	submitInfo.pCommandBuffers = commandBuffers.data();
+
+	VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence), "failed to submit command buffers!");
+	vkWaitForFences(device_, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+	vkDestroyFence(device_, fence, nullptr);
+	vkFreeCommandBuffers(device_, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+}
+
 void Core::Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
@@ -222,6 +291,19 @@ void Core::Device::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMem
 	}
 }
 
+void Core::Device::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation) {
+	VK_CHECK_RESULT(vkCreateImage(device_, &imageInfo, nullptr, &image), "failed to create image!");
+
+	allocation = allocator->allocateImage(image, imageInfo.tiling, properties);
+
+	VK_CHECK_RESULT(vkBindImageMemory(device_, image, allocation.memory, allocation.offset), "failed to bind image memory!");
+}
+
+void Core::Device::destroyImage(VkImage image, Allocation& allocation) {
+	vkDestroyImage(device_, image, nullptr);
+	allocator->free(allocation);
+}
+
 void Core::Device::createInstance() {
 	if (enableValidationLayers && !checkValidationLayerSupport()) {
 		throw std::runtime_error("validation layers requested, but not available!");
@@ -273,6 +355,7 @@ void Core::Device::setupDebugMessenger() {
 }
 
 void Core::Device::createSurface() {
+	if (isHeadless()) return;
 	window->createWindowSurface(instance, &surface_);
 }
 
@@ -323,6 +406,8 @@ void Core::Device::createLogicalDevice() {
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+	if (indices.transferFamilyHasValue)
+		uniqueQueueFamilies.insert(indices.transferFamily);
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -356,6 +441,10 @@ void Core::Device::createLogicalDevice() {
 	synchronizationFeature.synchronization2 = VK_TRUE;
 	accelStructureFeature.pNext = &synchronizationFeature;
 
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeature{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+	timelineSemaphoreFeature.timelineSemaphore = VK_TRUE;
+	synchronizationFeature.pNext = &timelineSemaphoreFeature;
+
 	VkPhysicalDeviceFeatures2 deviceFeatures2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
 	deviceFeatures2.features = deviceFeatures;
 	deviceFeatures2.pNext = &bufferDeviceAddressFeature;
@@ -387,6 +476,34 @@ void Core::Device::createLogicalDevice() {
 
 	vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
 	vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+	//without a dedicated transfer family, uploads simply go through the graphics queue
+	graphicsFamily_ = indices.graphicsFamily;
+	transferFamily_ = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+	vkGetDeviceQueue(device_, transferFamily_, 0, &transferQueue_);
+}
+
+/*
+ * Resolves every extension function once, the loader lookup used to happen on each call
+ */
+void Core::Device::loadDispatchTable() {
+	auto load = [this](auto& function, const char* name) {
+		function = reinterpret_cast<std::remove_reference_t<decltype(function)>>(vkGetDeviceProcAddr(device_, name));
+		if (function == nullptr)
+			throw std::runtime_error(std::string("failed to load device function ") + name + "!");
+	};
+
+	load(dispatchTable.vkGetBufferDeviceAddressKHR, "vkGetBufferDeviceAddressKHR");
+	load(dispatchTable.vkCreateAccelerationStructureKHR, "vkCreateAccelerationStructureKHR");
+	load(dispatchTable.vkDestroyAccelerationStructureKHR, "vkDestroyAccelerationStructureKHR");
+	load(dispatchTable.vkGetAccelerationStructureBuildSizesKHR, "vkGetAccelerationStructureBuildSizesKHR");
+	load(dispatchTable.vkGetAccelerationStructureDeviceAddressKHR, "vkGetAccelerationStructureDeviceAddressKHR");
+	load(dispatchTable.vkCmdBuildAccelerationStructuresKHR, "vkCmdBuildAccelerationStructuresKHR");
+	load(dispatchTable.vkCmdWriteAccelerationStructuresPropertiesKHR, "vkCmdWriteAccelerationStructuresPropertiesKHR");
+	load(dispatchTable.vkCmdCopyAccelerationStructureKHR, "vkCmdCopyAccelerationStructureKHR");
+	load(dispatchTable.vkCreateRayTracingPipelinesKHR, "vkCreateRayTracingPipelinesKHR");
+	load(dispatchTable.vkGetRayTracingShaderGroupHandlesKHR, "vkGetRayTracingShaderGroupHandlesKHR");
+	load(dispatchTable.vkCmdTraceRaysKHR, "vkCmdTraceRaysKHR");
 }
 
 void Core::Device::createCommandPool() {
@@ -418,8 +535,8 @@ bool Core::Device::isDeviceSuitable(VkPhysicalDevice device) {
 
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	bool swapChainAdequate = isHeadless();
+	if (extensionsSupported && !isHeadless()) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
@@ -432,11 +549,14 @@ bool Core::Device::isDeviceSuitable(VkPhysicalDevice device) {
 }
 
 std::vector<const char*> Core::Device::getRequiredExtensions() {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
+	if (!isHeadless()) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers) {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -485,8 +605,12 @@ Core::QueueFamilyIndices Core::Device::findQueueFamilies(VkPhysicalDevice device
 			indices.graphicsFamily = i;
 			indices.graphicsFamilyHasValue = true;
 		}
+		//without a surface nothing is presented, the graphics family stands in for the present family
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+		if (isHeadless())
+			presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+		else
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
 		if (queueFamily.queueCount > 0 && presentSupport) {
 			indices.presentFamily = i;
 			indices.presentFamilyHasValue = true;
@@ -498,6 +622,16 @@ Core::QueueFamilyIndices Core::Device::findQueueFamilies(VkPhysicalDevice device
 		i++;
 	}
 
+	for (uint32_t family = 0; family < queueFamilyCount; family++) {
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+
+		if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			indices.transferFamily = family;
+			indices.transferFamilyHasValue = true;
+			break;
+		}
+	}
+
 	return indices;
 }
 
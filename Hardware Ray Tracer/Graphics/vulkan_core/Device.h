@@ -1,13 +1,29 @@
 #pragma once
 #include "../Window.h"
 #include "../Definitions.h"
+#include "Allocator.h"
 #include <string>
 #include <vector>
 #include <iostream>
 
-#define vkGetBufferDeviceAddressKHR reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device_, "vkGetBufferDeviceAddressKHR"))
-
 namespace Core {
+	/*
+	 * Extension entry points of the logical device, loaded once after it is created
+	 */
+	struct DeviceDispatch {
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR = nullptr;
+		PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR = nullptr;
+		PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR = nullptr;
+		PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR = nullptr;
+		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR = nullptr;
+		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR = nullptr;
+		PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR = nullptr;
+		PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR = nullptr;
+		PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR = nullptr;
+		PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR = nullptr;
+		PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR = nullptr;
+	};
+
 	struct SwapChainSupportDetails {
 		VkSurfaceCapabilitiesKHR capabilities;
 		std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +33,10 @@ namespace Core {
 	struct QueueFamilyIndices {
 		uint32_t graphicsFamily;
 		uint32_t presentFamily;
+		uint32_t transferFamily; //family with transfer but without graphics and compute support, usually the DMA engine
 		bool graphicsFamilyHasValue = false;
 		bool presentFamilyHasValue = false;
+		bool transferFamilyHasValue = false;
 		bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 	};
 
@@ -42,11 +60,19 @@ namespace Core {
 		VkCommandPool getCommandPool() { return commandPool; }
 		VkDevice& getDevice() { return device_; }
 		VkInstance* getInstance() { return &instance; }
+		VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
 		VkSurfaceKHR surface() { return surface_; }
+		bool isHeadless() { return window == nullptr; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
+		VkQueue transferQueue() { return transferQueue_; }
+		uint32_t graphicsQueueFamily() { return graphicsFamily_; }
+		uint32_t transferQueueFamily() { return transferFamily_; }
+		bool hasTransferQueue() { return transferFamily_ != graphicsFamily_; }
 		VkPhysicalDeviceRayTracingPipelinePropertiesKHR* getRTProperties() { return &rtProperties; }
 		VkPhysicalDeviceAccelerationStructurePropertiesKHR* getAccelProperties() { return &accelProperties; }
+		Allocator& getAllocator() { return *allocator; }
+		const DeviceDispatch& dispatch() { return dispatchTable; }
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -59,9 +85,17 @@ namespace Core {
 			VkMemoryPropertyFlags properties,
 			VkBuffer* buffer,
 			VkDeviceMemory* bufferMemory);
+		void createBuffer(
+			VkDeviceSize size,
+			VkBufferUsageFlags usage,
+			VkMemoryPropertyFlags properties,
+			VkBuffer* buffer,
+			Allocation* allocation);
+		void destroyBuffer(VkBuffer buffer, Allocation& allocation);
 		VkDeviceAddress getBufferDeviceAddress(VkBuffer buffer);
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+		void endSingleTimeCommands(const std::vector<VkCommandBuffer>& commandBuffers);
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 		void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 		void createImageWithInfo(
@@ -69,12 +103,19 @@ namespace Core {
 			VkMemoryPropertyFlags properties,
 			VkImage& image,
 			VkDeviceMemory& imageMemory);
+		void createImageWithInfo(
+			const VkImageCreateInfo& imageInfo,
+			VkMemoryPropertyFlags properties,
+			VkImage& image,
+			Allocation& allocation);
+		void destroyImage(VkImage image, Allocation& allocation);
 	private:
 		void createInstance();
 		void setupDebugMessenger();
 		void createSurface();
 		void pickPhysicalDevice();
 		void createLogicalDevice();
+		void loadDispatchTable();
 		void createCommandPool();
 		void creatRayTracingProperties();
 
@@ -94,16 +135,21 @@ namespace Core {
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 		Window* window;
 		VkCommandPool commandPool;
+		std::unique_ptr<Allocator> allocator;
+		DeviceDispatch dispatchTable;
 
 		VkDevice device_;
-		VkSurfaceKHR surface_;
+		VkSurfaceKHR surface_ = VK_NULL_HANDLE;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		VkQueue transferQueue_;
+		uint32_t graphicsFamily_;
+		uint32_t transferFamily_;
 		VkPhysicalDeviceRayTracingPipelinePropertiesKHR rtProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR };
 		VkPhysicalDeviceAccelerationStructurePropertiesKHR accelProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR };
 
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
-		const std::vector<const char*> deviceExtensions = { 
+		std::vector<const char*> deviceExtensions = { 
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 			VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
 			VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
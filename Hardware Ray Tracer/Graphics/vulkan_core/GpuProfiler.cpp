@@ -0,0 +1,241 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+//the first two queries of every pool bracket the whole frame, scope n uses 2 + 2n and 3 + 2n
+#define FRAME_QUERY_COUNT 2U
+
+Core::GpuProfiler::GpuProfiler(Device& device, uint32_t framesInFlight) : device(device) {
+	timestampPeriod = device.properties.limits.timestampPeriod;
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, families.data());
+
+	uint32_t validBits = families[device.graphicsQueueFamily()].timestampValidBits;
+	supported = validBits > 0 && timestampPeriod > 0.0;
+	timestampMask = validBits >= 64 ? UINT64_MAX : (1ULL << validBits) - 1;
+
+	if (!supported) {
+		std::cout << "[WARNING] GPU Profiler: the graphics queue does not support timestamps, GPU times are not measured" << std::endl;
+		return;
+	}
+
+	frames.resize(framesInFlight);
+	for (FrameQueries& queries : frames) {
+		VkQueryPoolCreateInfo poolInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = FRAME_QUERY_COUNT + 2 * PROFILER_MAX_SCOPES
+		};
+		VK_CHECK_RESULT(vkCreateQueryPool(device.getDevice(), &poolInfo, nullptr, &queries.pool), "failed to create timestamp query pool!");
+	}
+}
+
+Core::GpuProfiler::~GpuProfiler() {
+	for (FrameQueries& queries : frames)
+		vkDestroyQueryPool(device.getDevice(), queries.pool, nullptr);
+}
+
+/*
+ * Reads back the queries this frame index wrote last time and resets the pool for the new frame.
+ * Call it after the fence of the frame index was waited on.
+ */
+void Core::GpuProfiler::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, uint64_t frame) {
+	if (!supported) return;
+
+	current = &frames[frameIndex];
+	resolve(*current);
+
+	current->frame = frame;
+	current->names.clear();
+	current->ends.clear();
+	openScopes.clear();
+
+	vkCmdResetQueryPool(cmd, current->pool, 0, FRAME_QUERY_COUNT + 2 * PROFILER_MAX_SCOPES);
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current->pool, 0);
+}
+
+void Core::GpuProfiler::endFrame(VkCommandBuffer cmd) {
+	if (!supported || current == nullptr) return;
+
+	while (!openScopes.empty())
+		endScope(cmd);
+
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current->pool, 1);
+	current->pending = true;
+	current = nullptr;
+}
+
+/*
+ * Scopes may nest, scopes beyond PROFILER_MAX_SCOPES in one frame are ignored
+ */
+void Core::GpuProfiler::beginScope(VkCommandBuffer cmd, const std::string& name, VkPipelineStageFlagBits stage) {
+	if (!supported || current == nullptr) return;
+
+	uint32_t scope = static_cast<uint32_t>(current->names.size());
+	if (scope >= PROFILER_MAX_SCOPES) {
+		openScopes.push_back(UINT32_MAX);
+		return;
+	}
+
+	current->names.push_back(name);
+	current->ends.push_back(UINT32_MAX);
+	openScopes.push_back(scope);
+
+	vkCmdWriteTimestamp(cmd, stage, current->pool, FRAME_QUERY_COUNT + 2 * scope);
+}
+
+void Core::GpuProfiler::endScope(VkCommandBuffer cmd, VkPipelineStageFlagBits stage) {
+	if (!supported || current == nullptr || openScopes.empty()) return;
+
+	uint32_t scope = openScopes.back();
+	openScopes.pop_back();
+	if (scope == UINT32_MAX) return;
+
+	current->ends[scope] = FRAME_QUERY_COUNT + 2 * scope + 1;
+	vkCmdWriteTimestamp(cmd, stage, current->pool, current->ends[scope]);
+}
+
+/*
+ * Reads back every pending frame, only call this once the device is idle
+ */
+void Core::GpuProfiler::resolveAll() {
+	std::vector<FrameQueries*> pending;
+	for (FrameQueries& queries : frames)
+		if (queries.pending)
+			pending.push_back(&queries);
+
+	std::sort(pending.begin(), pending.end(), [](FrameQueries* a, FrameQueries* b) { return a->frame < b->frame; });
+	for (FrameQueries* queries : pending)
+		resolve(*queries);
+}
+
+/*
+ * Returns the frames read back since the last call, oldest first
+ */
+std::vector<Core::GpuProfiler::FrameTiming> Core::GpuProfiler::takeResults() {
+	std::vector<FrameTiming> taken(std::make_move_iterator(results.begin()), std::make_move_iterator(results.end()));
+	results.clear();
+	return taken;
+}
+
+void Core::GpuProfiler::resolve(FrameQueries& queries) {
+	if (!queries.pending) return;
+	queries.pending = false;
+
+	uint32_t queryCount = FRAME_QUERY_COUNT + 2 * static_cast<uint32_t>(queries.names.size());
+	std::vector<uint64_t> timestamps(queryCount);
+
+	//scopes are written in order, so every query up to the last end is written except for unterminated scopes
+	VkResult result = vkGetQueryPoolResults(device.getDevice(), queries.pool, 0, queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS) return;
+
+	auto toMilliseconds = [&](uint64_t begin, uint64_t end) {
+		return static_cast<double>((end - begin) & timestampMask) * timestampPeriod / 1e6;
+	};
+
+	FrameTiming timing{
+		.frame = queries.frame,
+		.milliseconds = toMilliseconds(timestamps[0], timestamps[1])
+	};
+
+	for (uint32_t scope = 0; scope < queries.names.size(); scope++)
+		if (queries.ends[scope] != UINT32_MAX)
+			timing.scopes.push_back(ScopeTiming{ queries.names[scope], toMilliseconds(timestamps[FRAME_QUERY_COUNT + 2 * scope], timestamps[queries.ends[scope]]) });
+
+	record(timing);
+	lastFrame = timing;
+
+	results.push_back(std::move(timing));
+	if (results.size() > PROFILER_MAX_RESULTS)
+		results.pop_front();
+}
+
+void Core::GpuProfiler::record(const FrameTiming& timing) {
+	frameAverage.add(timing.milliseconds);
+
+	size_t bucket = static_cast<size_t>(std::max(timing.milliseconds, 0.0) / PROFILER_HISTOGRAM_BUCKET_MS);
+	histogram[std::min<size_t>(bucket, PROFILER_HISTOGRAM_BUCKETS - 1)]++;
+
+	for (const ScopeTiming& scope : timing.scopes) {
+		auto it = std::find_if(scopeAverages.begin(), scopeAverages.end(), [&](const auto& average) { return average.first == scope.name; });
+		if (it == scopeAverages.end())
+			it = scopeAverages.insert(scopeAverages.end(), { scope.name, RollingAverage{} });
+		it->second.add(scope.milliseconds);
+	}
+
+	if (csv.is_open()) {
+		csv << timing.frame << ",frame," << timing.milliseconds << "\n";
+		for (const ScopeTiming& scope : timing.scopes)
+			csv << timing.frame << "," << scope.name << "," << scope.milliseconds << "\n";
+	}
+}
+
+/*
+ * Every frame read back from now on is appended to the file
+ */
+bool Core::GpuProfiler::openCSV(const std::string& path) {
+	csv.open(path, std::ios::trunc);
+	if (!csv.is_open()) return false;
+
+	csv << std::setprecision(6) << "frame,scope,milliseconds\n";
+	return true;
+}
+
+double Core::GpuProfiler::getAverage(const std::string& scope) const {
+	for (const auto& [name, average] : scopeAverages)
+		if (name == scope)
+			return average.get();
+	return 0.0;
+}
+
+/*
+ * One line of rolling averages, e.g. "GPU 4.21 ms (AS Update 0.02, Trace Rays 4.05, Image Copy 0.11)"
+ */
+std::string Core::GpuProfiler::summary() const {
+	if (!supported) return "GPU time not supported";
+
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(2) << "GPU " << frameAverage.get() << " ms (";
+	for (size_t i = 0; i < scopeAverages.size(); i++)
+		line << (i > 0 ? ", " : "") << scopeAverages[i].first << " " << scopeAverages[i].second.get();
+	line << ")";
+	return line.str();
+}
+
+void Core::GpuProfiler::printHistogram() const {
+	uint64_t total = 0, peak = 0;
+	for (uint64_t count : histogram) {
+		total += count;
+		peak = std::max(peak, count);
+	}
+	if (total == 0) return;
+
+	std::cout << "[PROFILE] GPU frame time histogram over " << total << " frame(s):" << std::endl;
+	for (uint32_t bucket = 0; bucket < PROFILER_HISTOGRAM_BUCKETS; bucket++) {
+		if (histogram[bucket] == 0) continue;
+
+		std::ostringstream range;
+		range << std::fixed << std::setprecision(1) << std::setw(5) << bucket * PROFILER_HISTOGRAM_BUCKET_MS;
+		if (bucket + 1 < PROFILER_HISTOGRAM_BUCKETS)
+			range << " - " << std::setw(5) << (bucket + 1) * PROFILER_HISTOGRAM_BUCKET_MS << " ms";
+		else
+			range << " +       ms";
+
+		std::cout << "[PROFILE] " << range.str() << " " << std::string(static_cast<size_t>(40 * histogram[bucket] / peak), '#') << " " << histogram[bucket] << std::endl;
+	}
+}
+
+void Core::GpuProfiler::RollingAverage::add(double sample) {
+	if (count == PROFILER_AVERAGE_FRAMES)
+		sum -= samples[next];
+	else
+		count++;
+
+	samples[next] = sample;
+	sum += sample;
+	next = (next + 1) % PROFILER_AVERAGE_FRAMES;
+}
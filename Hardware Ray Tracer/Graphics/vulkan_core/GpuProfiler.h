@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Device.h"
+#include "SwapChain.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <fstream>
+
+#define PROFILER_MAX_SCOPES 32U //named scopes per frame, every scope uses two timestamp queries
+#define PROFILER_MAX_RESULTS 1024U //read back frames kept until takeResults(), older ones are dropped
+#define PROFILER_AVERAGE_FRAMES 64U //window of the rolling averages
+#define PROFILER_HISTOGRAM_BUCKETS 40U //GPU frame time histogram, the last bucket collects everything above
+#define PROFILER_HISTOGRAM_BUCKET_MS 0.5 //width of one histogram bucket
+
+namespace Core {
+	/*
+	 * Measures GPU time of named scopes with timestamp queries. Every frame in flight owns a query pool,
+	 * which is read back when the frame index comes around again. At that point the frame's fence has
+	 * been waited on, so the results are available and reading them never stalls the queue.
+	 * Read back frames update rolling averages per scope and a GPU frame time histogram, and are
+	 * optionally appended to a CSV file with one frame,scope,milliseconds row per measurement.
+	 */
+	class GpuProfiler {
+	public:
+		struct ScopeTiming {
+			std::string name;
+			double milliseconds;
+		};
+
+		struct FrameTiming {
+			uint64_t frame; //frame number passed to beginFrame
+			double milliseconds; //from beginFrame to endFrame
+			std::vector<ScopeTiming> scopes;
+		};
+
+		GpuProfiler(Device& device, uint32_t framesInFlight = SwapChain::MAX_FRAMES_IN_FLIGHT);
+		~GpuProfiler();
+
+		GpuProfiler(const GpuProfiler&) = delete;
+		GpuProfiler operator=(const GpuProfiler&) = delete;
+
+		void beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, uint64_t frame);
+		void endFrame(VkCommandBuffer cmd);
+		void beginScope(VkCommandBuffer cmd, const std::string& name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		void endScope(VkCommandBuffer cmd, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		void resolveAll();
+
+		std::vector<FrameTiming> takeResults();
+		bool openCSV(const std::string& path);
+
+		double getAverage(const std::string& scope) const;
+		inline double getAverageFrameTime() const { return frameAverage.get(); }
+		inline const FrameTiming& getLastFrame() const { return lastFrame; } //newest frame read back, kept by takeResults()
+		std::string summary() const;
+		void printHistogram() const;
+
+		inline const std::array<uint64_t, PROFILER_HISTOGRAM_BUCKETS>& getHistogram() const { return histogram; }
+		inline bool isSupported() { return supported; }
+	private:
+		class RollingAverage {
+		public:
+			void add(double sample);
+			inline double get() const { return count > 0 ? sum / count : 0.0; }
+		private:
+			std::array<double, PROFILER_AVERAGE_FRAMES> samples{};
+			uint32_t count = 0;
+			uint32_t next = 0;
+			double sum = 0.0;
+		};
+
+		struct FrameQueries {
+			VkQueryPool pool = VK_NULL_HANDLE;
+			uint64_t frame = 0;
+			bool pending = false; //written by a submitted frame and not yet read back
+			std::vector<std::string> names;
+			std::vector<uint32_t> ends; //query index of the end of every scope, the begin is at 2 * scope
+		};
+
+		void resolve(FrameQueries& queries);
+		void record(const FrameTiming& timing);
+	private:
+		Device& device;
+		bool supported = false;
+		double timestampPeriod; //nanoseconds per tick
+		uint64_t timestampMask;
+
+		std::vector<FrameQueries> frames;
+		FrameQueries* current = nullptr;
+		std::vector<uint32_t> openScopes;
+		std::deque<FrameTiming> results;
+
+		FrameTiming lastFrame{};
+		RollingAverage frameAverage;
+		std::vector<std::pair<std::string, RollingAverage>> scopeAverages; //in the order the scopes first appeared
+		std::array<uint64_t, PROFILER_HISTOGRAM_BUCKETS> histogram{};
+		std::ofstream csv;
+	};
+}
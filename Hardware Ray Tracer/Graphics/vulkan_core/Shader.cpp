@@ -0,0 +1,162 @@
+#include "Shader.h"
+#include <cstring>
+#include <fstream>
+
+#define SPIRV_MAGIC 0x07230203U
+#define SPIRV_HEADER_WORDS 5U
+
+namespace {
+	//opcodes and decorations of the SPIR-V specification the interface is read from
+	enum SpirvOp : uint32_t {
+		eOpMemberName = 6,
+		eOpEntryPoint = 15,
+		eOpTypePointer = 32,
+		eOpVariable = 59,
+		eOpDecorate = 71,
+		eOpMemberDecorate = 72
+	};
+
+	enum SpirvDecoration : uint32_t {
+		eSpecId = 1,
+		eBinding = 33,
+		eDescriptorSet = 34,
+		eOffset = 35
+	};
+
+	std::string spirvString(const uint32_t* words, size_t count) {
+		const char* text = reinterpret_cast<const char*>(words);
+		return std::string(text, strnlen(text, count * sizeof(uint32_t)));
+	}
+}
+
+std::vector<char> Core::Shader::readFile(const std::string& path) {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) throw std::runtime_error("failed to open: " + path);
+
+	std::vector<char> code(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(code.data(), code.size());
+	return code;
+}
+
+VkShaderModule Core::Shader::createModule(Device& device, const std::vector<char>& code) {
+	VkShaderModuleCreateInfo info{
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = code.size(),
+		.pCode = reinterpret_cast<const uint32_t*>(code.data())
+	};
+
+	VkShaderModule module;
+	VK_CHECK_RESULT(vkCreateShaderModule(device.getDevice(), &info, nullptr, &module), "failed to create shader module!");
+	return module;
+}
+
+/*
+ * Compute pipeline from the entry point of a SPIR-V file, the module is only kept while the pipeline is created.
+ * A module without the entry point is one the build step has not recompiled yet.
+ */
+VkPipeline Core::Shader::createComputePipeline(Device& device, VkPipelineCache cache, VkPipelineLayout layout, const std::string& path, const char* entryPoint) {
+	std::vector<char> code = readFile(path);
+	ShaderInterface(code, path).requireEntryPoint(entryPoint);
+	VkShaderModule module = createModule(device, code);
+
+	VkComputePipelineCreateInfo pipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = module,
+			.pName = entryPoint
+		},
+		.layout = layout
+	};
+	VkPipeline pipeline;
+	VkResult result = vkCreateComputePipelines(device.getDevice(), cache, 1, &pipelineInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(device.getDevice(), module, nullptr);
+	VK_CHECK_RESULT(result, "failed to create compute pipeline: " + path);
+	return pipeline;
+}
+
+/*
+ * Walks the instructions once, then follows every variable with a set and binding through its pointer type to the
+ * block it points to. Member names come from the debug information slangc keeps by default.
+ */
+Core::ShaderInterface::ShaderInterface(const std::vector<char>& code, const std::string& path) : path(path) {
+	std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+	std::memcpy(words.data(), code.data(), words.size() * sizeof(uint32_t));
+	if (words.size() < SPIRV_HEADER_WORDS || words[0] != SPIRV_MAGIC)
+		throw std::runtime_error("not a SPIR-V module: " + path);
+
+	std::map<uint32_t, uint32_t> sets, bindingOf, pointees, variableTypes;
+	std::map<std::pair<uint32_t, uint32_t>, std::string> memberNames; //struct type, member index
+	std::map<std::pair<uint32_t, uint32_t>, uint32_t> memberOffsets;
+	for (size_t i = SPIRV_HEADER_WORDS; i < words.size();) {
+		uint32_t count = words[i] >> 16;
+		if (count == 0 || i + count > words.size())
+			throw std::runtime_error("truncated SPIR-V module: " + path);
+		const uint32_t* operands = &words[i + 1];
+
+		switch (words[i] & 0xFFFF) {
+		case eOpMemberName:
+			memberNames[{ operands[0], operands[1] }] = spirvString(operands + 2, count - 3);
+			break;
+		case eOpEntryPoint:
+			entryPoints.insert(spirvString(operands + 2, count - 3));
+			break;
+		case eOpTypePointer:
+			pointees[operands[0]] = operands[2];
+			break;
+		case eOpVariable:
+			variableTypes[operands[1]] = operands[0];
+			break;
+		case eOpDecorate:
+			if (count < 4) break;
+			if (operands[1] == eDescriptorSet) sets[operands[0]] = operands[2];
+			else if (operands[1] == eBinding) bindingOf[operands[0]] = operands[2];
+			else if (operands[1] == eSpecId) specConstants.insert(operands[2]);
+			break;
+		case eOpMemberDecorate:
+			if (count >= 5 && operands[2] == eOffset)
+				memberOffsets[{ operands[0], operands[1] }] = operands[3];
+			break;
+		}
+		i += count;
+	}
+
+	for (auto [variable, binding] : bindingOf) {
+		std::pair<uint32_t, uint32_t> location{ sets.contains(variable) ? sets[variable] : 0U, binding };
+		bindings.insert(location);
+
+		uint32_t block = pointees[variableTypes[variable]];
+		for (auto& [member, offset] : memberOffsets)
+			if (member.first == block && memberNames.contains(member))
+				members[location][memberNames[member]] = offset;
+	}
+}
+
+Core::ShaderInterface& Core::ShaderInterface::requireEntryPoint(const std::string& name) {
+	if (!entryPoints.contains(name)) stale("entry point " + name);
+	return *this;
+}
+
+Core::ShaderInterface& Core::ShaderInterface::requireBinding(uint32_t set, uint32_t binding) {
+	if (!bindings.contains({ set, binding })) stale("binding " + std::to_string(binding) + " in set " + std::to_string(set));
+	return *this;
+}
+
+Core::ShaderInterface& Core::ShaderInterface::requireSpecConstant(uint32_t id) {
+	if (!specConstants.contains(id)) stale("specialization constant " + std::to_string(id));
+	return *this;
+}
+
+//the offset has to match as well, the host writes the struct byte for byte
+Core::ShaderInterface& Core::ShaderInterface::requireMember(uint32_t set, uint32_t binding, const std::string& name, size_t offset) {
+	auto block = members.find({ set, binding });
+	if (block == members.end() || !block->second.contains(name) || block->second.at(name) != offset)
+		stale(name + " at offset " + std::to_string(offset) + " in binding " + std::to_string(binding));
+	return *this;
+}
+
+void Core::ShaderInterface::stale(const std::string& missing) {
+	throw std::runtime_error(path + " has no " + missing + ", it was compiled from older shaders, rebuild it with slangc");
+}
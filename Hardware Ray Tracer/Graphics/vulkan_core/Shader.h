@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Device.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Core {
+	/*
+	 * SPIR-V loading shared by the ray tracing pipeline and the compute passes. Failures throw like the rest of the
+	 * setup code.
+	 */
+	class Shader {
+	public:
+		static std::vector<char> readFile(const std::string& path);
+		static VkShaderModule createModule(Device& device, const std::vector<char>& code);
+		static VkPipeline createComputePipeline(Device& device, VkPipelineCache cache, VkPipelineLayout layout, const std::string& path, const char* entryPoint);
+	};
+
+	/*
+	 * Entry points, descriptor bindings, specialization constants and block members a SPIR-V module declares, read from
+	 * its decorations and debug names. The require calls throw for a module compiled from older shader sources, which
+	 * would otherwise miss descriptor writes or read the uniform through a shifted layout.
+	 */
+	class ShaderInterface {
+	public:
+		ShaderInterface(const std::vector<char>& code, const std::string& path);
+
+		ShaderInterface& requireEntryPoint(const std::string& name);
+		ShaderInterface& requireBinding(uint32_t set, uint32_t binding);
+		ShaderInterface& requireSpecConstant(uint32_t id);
+		ShaderInterface& requireMember(uint32_t set, uint32_t binding, const std::string& name, size_t offset);
+
+	private:
+		[[noreturn]] void stale(const std::string& missing);
+
+		std::string path;
+		std::set<std::string> entryPoints;
+		std::set<std::pair<uint32_t, uint32_t>> bindings; //descriptor set, binding
+		std::set<uint32_t> specConstants;
+		std::map<std::pair<uint32_t, uint32_t>, std::map<std::string, uint32_t>> members; //member offsets of the block at a binding
+	};
+}
@@ -0,0 +1,35 @@
+#include "StorageImage.h"
+
+void Core::StorageImage::create(Device& device, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage) {
+	VkImageCreateInfo imageInfo{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent = {.width = extent.width, .height = extent.height, .depth = 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = usage,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+	device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
+
+	VkImageViewCreateInfo viewInfo{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = image,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = format,
+		.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 },
+	};
+	VK_CHECK_RESULT(vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &imageView), "failed to create storage image view!");
+}
+
+//safe to call on images that were never created or are already destroyed
+void Core::StorageImage::destroy(Device& device) {
+	if (image == VK_NULL_HANDLE)
+		return;
+	vkDestroyImageView(device.getDevice(), imageView, nullptr);
+	device.destroyImage(image, imageAllocation);
+	*this = StorageImage{};
+}
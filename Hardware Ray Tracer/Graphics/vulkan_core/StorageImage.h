@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Device.h"
+
+namespace Core {
+	/*
+	 * Single mip 2D image with a view, used by the compute and ray tracing passes. The shaders access it in the
+	 * general layout, the owner records the transition out of UNDEFINED and calls destroy().
+	 */
+	struct StorageImage {
+		VkImage image = VK_NULL_HANDLE;
+		Allocation imageAllocation;
+		VkImageView imageView = VK_NULL_HANDLE;
+
+		void create(Device& device, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT);
+		void destroy(Device& device);
+
+		inline VkDescriptorImageInfo descriptorInfo() const { return VkDescriptorImageInfo{ .imageView = imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL }; }
+	};
+}
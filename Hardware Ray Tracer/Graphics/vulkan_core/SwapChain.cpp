@@ -24,8 +24,7 @@ Core::SwapChain::~SwapChain() {
 
 	for (int i = 0; i < depthImages.size(); i++) {
 		vkDestroyImageView(device.getDevice(), depthImageViews[i], nullptr);
-		vkDestroyImage(device.getDevice(), depthImages[i], nullptr);
-		vkFreeMemory(device.getDevice(), depthImageMemorys[i], nullptr);
+		device.destroyImage(depthImages[i], depthImageAllocations[i]);
 	}
 
 	for (auto framebuffer : swapChainFramebuffers) {
@@ -314,7 +313,7 @@ void Core::SwapChain::createDepthResources() {
 	VkExtent2D swapChainExtent = getSwapChainExtent();
 
 	depthImages.resize(imageCount());
-	depthImageMemorys.resize(imageCount());
+	depthImageAllocations.resize(imageCount());
 	depthImageViews.resize(imageCount());
 
 	for (int i = 0; i < depthImages.size(); i++) {
@@ -338,7 +337,7 @@ void Core::SwapChain::createDepthResources() {
 			imageInfo,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			depthImages[i],
-			depthImageMemorys[i]);
+			depthImageAllocations[i]);
 
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
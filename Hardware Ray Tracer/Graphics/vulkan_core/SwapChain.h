@@ -65,7 +65,7 @@ namespace Core {
 		VkRenderPass renderPass;
 
 		std::vector<VkImage> depthImages;
-		std::vector<VkDeviceMemory> depthImageMemorys;
+		std::vector<Allocation> depthImageAllocations;
 		std::vector<VkImageView> depthImageViews;
 		std::vector<VkImage> swapChainImages;
 		std::vector<VkImageView> swapChainImageViews;
@@ -0,0 +1,206 @@
+#include "UploadManager.h"
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+Core::UploadManager::UploadManager(Device& device, VkDeviceSize ringSize) : device(device), ringSize(ringSize) {
+	ringBuffer = std::make_unique<Buffer>(
+		device,
+		ringSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	);
+	ringBuffer->map();
+
+	VkCommandPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = device.transferQueueFamily()
+	};
+	VK_CHECK_RESULT(vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &commandPool), "failed to create upload command pool!");
+
+	VkSemaphoreTypeCreateInfo typeInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+	VkSemaphoreCreateInfo semaphoreInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &typeInfo };
+	VK_CHECK_RESULT(vkCreateSemaphore(device.getDevice(), &semaphoreInfo, nullptr, &timeline), "failed to create upload timeline semaphore!");
+}
+
+Core::UploadManager::~UploadManager() {
+	waitIdle();
+
+	vkDestroySemaphore(device.getDevice(), timeline, nullptr);
+	vkDestroyCommandPool(device.getDevice(), commandPool, nullptr);
+}
+
+/*
+ * Copies data into the staging ring and records a copy into dstBuffer. Nothing is submitted until flush(),
+ * except when the ring runs full. Uploads bigger than half the ring are split into several copies.
+ */
+void Core::UploadManager::uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+	const char* src = static_cast<const char*>(data);
+	VkDeviceSize maxChunk = ringSize / 2;
+
+	while (size > 0) {
+		VkDeviceSize chunk = std::min(size, maxChunk);
+		VkDeviceSize offset = reserve(chunk);
+
+		memcpy(static_cast<char*>(ringBuffer->getMappedMemory()) + offset, src, chunk);
+
+		//neighbouring uploads into the same buffer become one region
+		auto& regions = pendingCopies[dstBuffer];
+		if (!regions.empty() && regions.back().srcOffset + regions.back().size == offset && regions.back().dstOffset + regions.back().size == dstOffset)
+			regions.back().size += chunk;
+		else
+			regions.push_back(VkBufferCopy{ offset, dstOffset, chunk });
+
+		src += chunk;
+		dstOffset += chunk;
+		size -= chunk;
+	}
+}
+
+/*
+ * Submits all pending copies in one command buffer and returns the timeline value that signals their completion
+ */
+uint64_t Core::UploadManager::flush() {
+	if (pendingCopies.empty()) return timelineValue;
+
+	VkCommandBuffer commandBuffer = acquireCommandBuffer();
+
+	VkCommandBufferBeginInfo beginInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo), "failed to begin upload command buffer!");
+
+	for (auto& [dstBuffer, regions] : pendingCopies)
+		vkCmdCopyBuffer(commandBuffer, ringBuffer->getBuffer(), dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+
+	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer), "failed to record upload command buffer!");
+
+	timelineValue++;
+
+	VkCommandBufferSubmitInfo commandBufferInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+		.commandBuffer = commandBuffer
+	};
+
+	VkSemaphoreSubmitInfo signalInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+		.semaphore = timeline,
+		.value = timelineValue,
+		.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+	};
+
+	VkSubmitInfo2 submitInfo{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+		.commandBufferInfoCount = 1,
+		.pCommandBufferInfos = &commandBufferInfo,
+		.signalSemaphoreInfoCount = 1,
+		.pSignalSemaphoreInfos = &signalInfo
+	};
+
+	VK_CHECK_RESULT(vkQueueSubmit2(device.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE), "failed to submit uploads!");
+
+	submissions.push_back(Submission{ timelineValue, commandBuffer, pendingBytes });
+	pendingBytes = 0;
+	pendingCopies.clear();
+	submitCount++;
+
+	retire(false);
+	return timelineValue;
+}
+
+void Core::UploadManager::wait(uint64_t value) {
+	VkSemaphoreWaitInfo waitInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &timeline,
+		.pValues = &value
+	};
+
+	VK_CHECK_RESULT(vkWaitSemaphores(device.getDevice(), &waitInfo, std::numeric_limits<uint64_t>::max()), "failed to wait for uploads!");
+}
+
+/*
+ * Submits everything pending and blocks until all uploads have landed
+ */
+void Core::UploadManager::waitIdle() {
+	wait(flush());
+	retire(false);
+}
+
+VkDeviceSize Core::UploadManager::reserve(VkDeviceSize size) {
+	auto alignUp = [](VkDeviceSize value, VkDeviceSize alignment) noexcept { return ((value + alignment - 1) & ~(alignment - 1)); };
+
+	while (true) {
+		//an empty ring can start over at the front
+		if (usedBytes == 0) head = 0;
+
+		VkDeviceSize offset = alignUp(head, UPLOAD_ALIGNMENT);
+		VkDeviceSize needed = offset - head + size;
+
+		//the rest of the ring is too small, it is skipped and counted as used until this upload retires
+		if (offset + size > ringSize) {
+			offset = 0;
+			needed = ringSize - head + size;
+		}
+
+		if (usedBytes + needed <= ringSize) {
+			usedBytes += needed;
+			pendingBytes += needed;
+			head = offset + size;
+			return offset;
+		}
+
+		//the ring is full, so submit what is pending and wait for the oldest upload
+		flush();
+		retire(true);
+	}
+}
+
+/*
+ * Gives the ring space and command buffers of finished submissions back. With block set,
+ * waits for the oldest submission first.
+ */
+void Core::UploadManager::retire(bool block) {
+	uint64_t completed = 0;
+	VK_CHECK_RESULT(vkGetSemaphoreCounterValue(device.getDevice(), timeline, &completed), "failed to query upload timeline semaphore!");
+
+	while (!submissions.empty()) {
+		Submission& submission = submissions.front();
+
+		if (completed < submission.value) {
+			if (!block) break;
+
+			wait(submission.value);
+			completed = submission.value;
+		}
+
+		usedBytes -= submission.ringBytes;
+		freeCommandBuffers.push_back(submission.commandBuffer);
+		submissions.pop_front();
+	}
+}
+
+VkCommandBuffer Core::UploadManager::acquireCommandBuffer() {
+	if (!freeCommandBuffers.empty()) {
+		VkCommandBuffer commandBuffer = freeCommandBuffers.back();
+		freeCommandBuffers.pop_back();
+		return commandBuffer;
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = commandPool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	VkCommandBuffer commandBuffer;
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer), "failed to allocate upload command buffer!");
+	return commandBuffer;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Device.h"
+#include "Buffer.h"
+#include <deque>
+#include <unordered_map>
+
+#define UPLOAD_RING_SIZE (64ULL * 1024ULL * 1024ULL) //size of the persistently mapped staging ring
+#define UPLOAD_ALIGNMENT 16ULL //alignment of every upload inside the staging ring
+
+namespace Core {
+	/*
+	 * Streams data into device local buffers through one persistently mapped staging ring.
+	 * Uploads are only recorded until flush() is called, which submits all pending copies in a single
+	 * command buffer on the transfer queue and signals a timeline semaphore. Ring space is reclaimed by
+	 * waiting on that semaphore, so the queue is never idled.
+	 */
+	class UploadManager {
+	public:
+		UploadManager(Device& device, VkDeviceSize ringSize = UPLOAD_RING_SIZE);
+		~UploadManager();
+
+		UploadManager(const UploadManager&) = delete;
+		UploadManager operator=(const UploadManager&) = delete;
+
+		void uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		uint64_t flush();
+		void wait(uint64_t value);
+		void waitIdle();
+
+		inline uint32_t getSubmitCount() { return submitCount; }
+	private:
+		struct Submission {
+			uint64_t value;
+			VkCommandBuffer commandBuffer;
+			VkDeviceSize ringBytes;
+		};
+
+		VkDeviceSize reserve(VkDeviceSize size);
+		void retire(bool block);
+		VkCommandBuffer acquireCommandBuffer();
+	private:
+		Device& device;
+
+		std::unique_ptr<Buffer> ringBuffer;
+		VkDeviceSize ringSize;
+		VkDeviceSize head = 0;
+		VkDeviceSize usedBytes = 0; //bytes of pending and in flight uploads, they always end at head
+		VkDeviceSize pendingBytes = 0;
+
+		VkCommandPool commandPool;
+		std::vector<VkCommandBuffer> freeCommandBuffers;
+		VkSemaphore timeline;
+		uint64_t timelineValue = 0;
+		uint32_t submitCount = 0;
+
+		std::unordered_map<VkBuffer, std::vector<VkBufferCopy>> pendingCopies; //copies grouped by destination
+		std::deque<Submission> submissions;
+	};
+}
@@ -1,9 +1,63 @@
 #include "Graphics/RayTracing/RTApp.h"
+#include "Graphics/Benchmarks/Benchmarks.h"
 
-int main() {
+int main(int argc, char** argv) {
 
 	try {
-		RayTracing::RTApp app;
+		if (argc >= 2 && std::string(argv[1]) == "--bench-blas") {
+			Benchmarks::blasBuild();
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 3 && std::string(argv[1]) == "--bench-mesh-cache") {
+			Benchmarks::meshCache(argv[2]);
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 3 && std::string(argv[1]) == "--bench-obj") {
+			Benchmarks::objImport(argv[2]);
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-dedup") {
+			Benchmarks::vertexDedup();
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-lights") {
+			Benchmarks::lightSampling(argc >= 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 100000U);
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-sampler") {
+			Benchmarks::sampler();
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-denoiser") {
+			Benchmarks::denoiser();
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 2 && std::string(argv[1]) == "--check-denoiser")
+			return Benchmarks::denoiserCheck() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-upscaler") {
+			Benchmarks::upscaler();
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-resolution") {
+			Benchmarks::dynamicResolution();
+			return EXIT_SUCCESS;
+		}
+
+		RayTracing::RTApp app(RayTracing::RenderSettings::fromArguments(argc, argv));
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-dispatch") {
+			app.benchmarkDispatch();
+			return EXIT_SUCCESS;
+		}
 
 		app.run();
 	} catch (const std::runtime_error& e) {
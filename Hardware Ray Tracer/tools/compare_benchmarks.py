@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Compares two benchmark reports written by --benchmark (.json or summary .csv).
+
+Every metric present in both reports is compared on one statistic (p50 by default).
+Times in ms regress when they grow, Mrays/s regress when they shrink. The exit code
+is 1 when any metric regressed by more than the threshold, so the script can gate CI.
+
+    python tools/compare_benchmarks.py baseline.json candidate.json --stat p95 --threshold 3
+"""
+
+import argparse
+import csv
+import json
+import sys
+
+STATISTICS = ("mean", "min", "max", "p50", "p95", "p99")
+HIGHER_IS_BETTER = ("Mrays/s",)
+
+
+def load(path):
+    if path.lower().endswith(".csv"):
+        with open(path, newline="") as file:
+            return {row["metric"]: {"unit": row["unit"], **{s: float(row[s]) for s in STATISTICS}} for row in csv.DictReader(file)}
+
+    with open(path) as file:
+        return json.load(file)["metrics"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two render benchmark reports.")
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--stat", choices=STATISTICS, default="p50", help="statistic to compare (default p50)")
+    parser.add_argument("--threshold", type=float, default=5.0, help="allowed change in percent before a metric counts as regressed (default 5)")
+    parser.add_argument("--include-build", action="store_true", help="also gate on the one-shot scene build times")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    candidate = load(args.candidate)
+
+    rows = []
+    regressions = []
+    for name, base in baseline.items():
+        if name not in candidate:
+            continue
+
+        old = base[args.stat]
+        new = candidate[name][args.stat]
+        unit = base["unit"]
+        change = (new - old) / old * 100.0 if old != 0 else 0.0
+        worse = -change if unit in HIGHER_IS_BETTER else change
+
+        gated = args.include_build or not name.startswith("build.")
+        status = "REGRESSED" if gated and worse > args.threshold else ("improved" if worse < -args.threshold else "")
+        if status == "REGRESSED":
+            regressions.append(name)
+
+        rows.append((name, unit, old, new, change, status))
+
+    width = max((len(row[0]) for row in rows), default=6)
+    print(f"{'metric':<{width}}  {'unit':<8} {'baseline':>12} {'candidate':>12} {'change':>9}")
+    for name, unit, old, new, change, status in rows:
+        print(f"{name:<{width}}  {unit:<8} {old:>12.4f} {new:>12.4f} {change:>+8.2f}%  {status}")
+
+    for name in sorted(set(baseline) ^ set(candidate)):
+        print(f"{name:<{width}}  only in {'baseline' if name in baseline else 'candidate'}")
+
+    if regressions:
+        print(f"\n{len(regressions)} metric(s) regressed by more than {args.threshold}% ({args.stat}): {', '.join(regressions)}")
+        return 1
+
+    print(f"\nno regression above {args.threshold}% ({args.stat})")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Compares headless EXR renders against a converged reference.
+
+Only reads the uncompressed float scanline EXRs written by --output *.exr. Prints the RMSE
+and the relative MSE (squared error over reference squared plus epsilon, as in most denoising
+and sampling papers) of the RGB channels, so renders made with the same --time-budget can be
+ranked by how far they converged.
+
+    python tools/compare_images.py reference.exr fixed_depth.exr roulette.exr
+"""
+
+import argparse
+import array
+import math
+import struct
+import sys
+
+EXR_MAGIC = 20000630
+RELATIVE_EPSILON = 1e-2
+
+
+def read_string(data, offset):
+    end = data.index(b"\0", offset)
+    return data[offset:end].decode(), end + 1
+
+
+def load(path):
+    """Returns (width, height, pixels) with pixels as a flat list of RGB floats."""
+    with open(path, "rb") as file:
+        data = file.read()
+
+    magic, version = struct.unpack_from("<II", data, 0)
+    if magic != EXR_MAGIC or version & 0xFF != 2:
+        raise ValueError(f"{path}: not a scanline EXR")
+
+    offset, window, channels, compression = 8, None, [], None
+    while data[offset] != 0:
+        name, offset = read_string(data, offset)
+        kind, offset = read_string(data, offset)
+        (size,) = struct.unpack_from("<i", data, offset)
+        value = data[offset + 4:offset + 4 + size]
+        offset += 4 + size
+
+        if name == "dataWindow":
+            window = struct.unpack("<4i", value)
+        elif name == "compression":
+            compression = value[0]
+        elif name == "channels":
+            position = 0
+            while value[position] != 0:
+                channel, position = read_string(value, position)
+                (pixel_type,) = struct.unpack_from("<i", value, position)
+                channels.append((channel, pixel_type))
+                position += 16
+    offset += 1
+
+    if window is None or compression != 0 or any(pixel_type != 2 for _, pixel_type in channels):
+        raise ValueError(f"{path}: only uncompressed 32 bit float EXRs are supported")
+
+    width, height = window[2] - window[0] + 1, window[3] - window[1] + 1
+    names = [name for name, _ in channels]
+    offset += height * 8  # line offset table, the lines follow in order
+
+    pixels = array.array("f", bytes(width * height * 3 * 4))
+    for _ in range(height):
+        y, size = struct.unpack_from("<iI", data, offset)
+        line = array.array("f", data[offset + 8:offset + 8 + size])
+        if sys.byteorder != "little":
+            line.byteswap()
+        offset += 8 + size
+
+        row = (y - window[1]) * width * 3
+        for component, name in enumerate("RGB"):
+            if name not in names:
+                continue
+            plane = names.index(name) * width
+            pixels[row + component:row + width * 3:3] = line[plane:plane + width]
+    return width, height, pixels
+
+
+def compare(reference, candidate):
+    squared, relative = 0.0, 0.0
+    for expected, value in zip(reference, candidate):
+        error = (value - expected) ** 2
+        squared += error
+        relative += error / (expected * expected + RELATIVE_EPSILON)
+    return math.sqrt(squared / len(reference)), relative / len(reference)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare EXR renders against a reference.")
+    parser.add_argument("reference")
+    parser.add_argument("candidates", nargs="+")
+    args = parser.parse_args()
+
+    width, height, reference = load(args.reference)
+    print(f"{'image':<40} {'RMSE':>12} {'relMSE':>12}")
+    for path in args.candidates:
+        candidate_width, candidate_height, candidate = load(path)
+        if (candidate_width, candidate_height) != (width, height):
+            print(f"{path}: {candidate_width}x{candidate_height} does not match the reference {width}x{height}", file=sys.stderr)
+            return 1
+
+        rmse, relmse = compare(reference, candidate)
+        print(f"{path:<40} {rmse:>12.6f} {relmse:>12.6f}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())